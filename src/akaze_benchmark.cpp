@@ -0,0 +1,645 @@
+//=============================================================================
+//
+// akaze_benchmark.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file akaze_benchmark.cpp
+ * @brief Main program for evaluating the repeatability, matching score and
+ * inliers ratio of A-KAZE features together with the computation times on
+ * an image sequence with ground truth homographies
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "./lib/AKAZE.h"
+
+// OpenCV
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+using namespace std;
+
+/* ************************************************************************* */
+// Evaluation options
+const float MIN_H_ERROR = 2.50f;            ///< Maximum error in pixels to accept an inlier
+const float DRATIO = 0.80f;                 ///< NNDR Matching value
+const float OVERLAP_ERROR = 0.40f;          ///< Maximum overlap error to accept a correspondence
+const float PIXEL_ERROR = 5.0f;             ///< Maximum location error in pixels to accept a correspondence
+
+/* ************************************************************************* */
+/**
+ * @brief This function parses the command line arguments for setting A-KAZE parameters
+ * and the benchmark thresholds
+ * @param options Structure that contains A-KAZE settings
+ * @param dataset_path Path for the folder with the image sequence
+ * @param nruns Number of times each image is processed for timing
+ * @param min_repeatability Minimum mean repeatability (%) to pass the benchmark
+ * @param min_matching_score Minimum mean matching score (%) to pass the benchmark
+ */
+int parse_input_options(AKAZEOptions& options, std::string& dataset_path, int& nruns,
+                        float& min_repeatability, float& min_matching_score,
+                        int argc, char *argv[]);
+
+/// This function keeps the nearest neighbor matches that agree in both directions.
+/// Queries without neighbors, e.g. with an empty train set, are skipped
+void cross_check_matches(const std::vector<std::vector<cv::DMatch> >& dmatches12,
+                         const std::vector<std::vector<cv::DMatch> >& dmatches21,
+                         std::vector<cv::DMatch>& dmatches);
+
+/* ************************************************************************* */
+int main(int argc, char *argv[]) {
+
+  // Variables
+  AKAZEOptions options;
+  string dataset_path;
+  vector<string> images, homographies;
+  int nruns = 1;
+  float min_repeatability = 0.0, min_matching_score = 0.0;
+
+  // Parse the input command line options
+  if (parse_input_options(options, dataset_path, nruns, min_repeatability,
+                          min_matching_score, argc, argv))
+    return -1;
+
+  if (read_image_sequence(dataset_path, images, homographies) < 2) {
+    cerr << "Error: cannot find an image sequence with ground truth homographies in:" << endl;
+    cerr << dataset_path << endl;
+    return -1;
+  }
+
+  if (options.verbosity) {
+    cout << "Check AKAZE options:" << endl;
+    cout << options << endl;
+  }
+
+  // Extract the features of every image of the sequence
+  size_t nimages = images.size();
+  vector<cv::Size> sizes(nimages);
+  vector<vector<cv::KeyPoint> > kpts(nimages);
+  vector<cv::Mat> desc(nimages);
+  AKAZETiming tmean;
+
+  for (size_t i = 0; i < nimages; i++) {
+
+    // For omin > 0 the image is decoded directly at the resolution of the initial octave.
+    // The keypoints and the homographies are in pixels of the original image, whose size
+    // is kept for the visibility test
+    cv::Mat img = read_image(images[i], options.omin, &sizes[i]);
+    if (img.data == NULL) {
+      cerr << "Error: cannot load image from file:" << endl << images[i] << endl;
+      return -1;
+    }
+
+    cv::Mat img_32;
+    img.convertTo(img_32, CV_32F, 1.0/255.0, 0);
+
+    options.img_width = img.cols;
+    options.img_height = img.rows;
+    libAKAZE::AKAZE evolution(options);
+
+    for (int r = 0; r < nruns; r++) {
+      evolution.Create_Nonlinear_Scale_Space(img_32);
+      evolution.Feature_Detection(kpts[i]);
+      vector<cv::Mat> descs;
+      evolution.Compute_Descriptors(kpts[i], descs);
+      desc[i] = descs[0];
+
+      AKAZETiming t = evolution.Get_Computation_Times();
+      tmean.kcontrast += t.kcontrast;
+      tmean.scale += t.scale;
+      tmean.derivatives += t.derivatives;
+      tmean.detector += t.detector;
+      tmean.extrema += t.extrema;
+      tmean.subpixel += t.subpixel;
+      tmean.descriptor += t.descriptor;
+    }
+  }
+
+  double nframes = (double)(nimages*nruns);
+  tmean.kcontrast /= nframes;
+  tmean.scale /= nframes;
+  tmean.derivatives /= nframes;
+  tmean.detector /= nframes;
+  tmean.extrema /= nframes;
+  tmean.subpixel /= nframes;
+  tmean.descriptor /= nframes;
+
+  // Evaluate the reference image against the rest of the sequence
+  cv::Ptr<cv::DescriptorMatcher> matcher_nndr;
+  int norm_type = 0;
+
+  if (options.descriptor < MLDB_UPRIGHT) {
+    matcher_nndr = cv::DescriptorMatcher::create("BruteForce");
+    norm_type = cv::NORM_L2;
+  }
+  else {
+    matcher_nndr = cv::DescriptorMatcher::create("BruteForce-Hamming");
+    norm_type = cv::NORM_HAMMING;
+  }
+
+  // One-to-one descriptor matches for the matching score
+  cv::BFMatcher matcher_nn(norm_type);
+
+  // The int8 descriptors have their own matcher
+  const bool int8 = (options.descriptor < MLDB_UPRIGHT && options.descriptor_int8 == true && options.pca_basis.empty());
+
+  float mean_rep = 0.0, mean_score = 0.0, mean_ratio = 0.0;
+
+  cout << left;
+  cout << setw(8) << "Pair" << setw(8) << "Kpts1" << setw(8) << "Kpts2"
+       << setw(8) << "Corr" << setw(12) << "Rep (%)" << setw(12) << "Score (%)"
+       << setw(10) << "Matches" << setw(10) << "Inliers" << setw(12) << "Ratio (%)" << endl;
+
+  for (size_t i = 1; i < nimages; i++) {
+
+    cv::Mat H;
+    if (read_homography(homographies[i-1], H) == false) {
+      cerr << "Error: cannot load homography from file:" << endl << homographies[i-1] << endl;
+      return -1;
+    }
+
+    // Repeatability
+    vector<cv::DMatch> corresp;
+    int nvisible = 0;
+    compute_correspondences(kpts[0], kpts[i], H, sizes[0], sizes[i],
+                            OVERLAP_ERROR, PIXEL_ERROR, corresp, nvisible);
+    float rep = (nvisible > 0 ? 100.0*corresp.size()/(float)nvisible : 0.0);
+
+    // Matching score with one-to-one descriptor matches
+    // The nearest neighbors in both directions must agree
+    vector<cv::DMatch> dmatches;
+    vector<vector<cv::DMatch> > dmatches12, dmatches21;
+    if (!desc[0].empty() && !desc[i].empty() && int8 == true) {
+      match_int8_descriptors(desc[0], desc[i], dmatches12);
+      match_int8_descriptors(desc[i], desc[0], dmatches21);
+    }
+    else if (!desc[0].empty() && !desc[i].empty()) {
+      matcher_nn.knnMatch(desc[0], desc[i], dmatches12, 1);
+      matcher_nn.knnMatch(desc[i], desc[0], dmatches21, 1);
+    }
+    cross_check_matches(dmatches12, dmatches21, dmatches);
+    int ncorrect = compute_correct_matches(corresp, dmatches);
+    float score = (nvisible > 0 ? 100.0*ncorrect/(float)nvisible : 0.0);
+
+    // Inliers ratio with the NNDR matching strategy
+    vector<vector<cv::DMatch> > dmatches_nndr;
+    vector<cv::Point2f> matches, inliers;
+    if (desc[0].rows > 0 && desc[i].rows > 1) {
+      if (int8 == true)
+        match_int8_descriptors(desc[0], desc[i], dmatches_nndr);
+      else
+        matcher_nndr->knnMatch(desc[0], desc[i], dmatches_nndr, 2);
+    }
+    matches2points_nndr(kpts[0], kpts[i], dmatches_nndr, matches, DRATIO);
+    compute_inliers_homography(matches, inliers, H, MIN_H_ERROR);
+
+    int nmatches = matches.size()/2;
+    int ninliers = inliers.size()/2;
+    float ratio = (nmatches > 0 ? 100.0*ninliers/(float)nmatches : 0.0);
+
+    mean_rep += rep;
+    mean_score += score;
+    mean_ratio += ratio;
+
+    cout << setw(8) << ("1-" + to_string(i+1)) << setw(8) << kpts[0].size()
+         << setw(8) << kpts[i].size() << setw(8) << corresp.size()
+         << setw(12) << rep << setw(12) << score << setw(10) << nmatches
+         << setw(10) << ninliers << setw(12) << ratio << endl;
+  }
+
+  mean_rep /= (nimages-1);
+  mean_score /= (nimages-1);
+  mean_ratio /= (nimages-1);
+
+  cout << endl;
+  cout << "Mean Repeatability (%): " << mean_rep << endl;
+  cout << "Mean Matching Score (%): " << mean_score << endl;
+  cout << "Mean Inliers Ratio (%): " << mean_ratio << endl << endl;
+
+  cout << "Mean computation times per frame (ms):" << endl;
+  cout << "(*) Time Scale Space: " << tmean.scale << endl;
+  cout << "   - Time Contrast Factor: " << tmean.kcontrast << endl;
+  cout << "(*) Time Detector: " << tmean.detector << endl;
+  cout << "   - Time Derivatives: " << tmean.derivatives << endl;
+  cout << "   - Time Extrema: " << tmean.extrema << endl;
+  cout << "   - Time Subpixel: " << tmean.subpixel << endl;
+  cout << "(*) Time Descriptor: " << tmean.descriptor << endl;
+  cout << "(*) Time Total: " << tmean.scale + tmean.detector + tmean.descriptor << endl;
+
+  // Check the quality thresholds
+  if (mean_rep < min_repeatability || mean_score < min_matching_score) {
+    cerr << "Error: quality below the required thresholds!!" << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* ************************************************************************* */
+void cross_check_matches(const std::vector<std::vector<cv::DMatch> >& dmatches12,
+                         const std::vector<std::vector<cv::DMatch> >& dmatches21,
+                         std::vector<cv::DMatch>& dmatches) {
+
+  dmatches.clear();
+  for (size_t j = 0; j < dmatches12.size(); j++) {
+    if (dmatches12[j].empty())
+      continue;
+
+    const int idx = dmatches12[j][0].trainIdx;
+    if (idx < 0 || idx >= (int)dmatches21.size() || dmatches21[idx].empty())
+      continue;
+
+    if (dmatches21[idx][0].trainIdx == (int)j)
+      dmatches.push_back(dmatches12[j][0]);
+  }
+}
+
+/* ************************************************************************* */
+int parse_input_options(AKAZEOptions& options, std::string& dataset_path, int& nruns,
+                        float& min_repeatability, float& min_matching_score,
+                        int argc, char *argv[]) {
+
+  // If there is only one argument return
+  if (argc == 1) {
+    show_input_options_help(3);
+    return -1;
+  }
+  // Set the options from the command line
+  else if (argc >= 2) {
+
+    // Load the default options
+    options = AKAZEOptions();
+
+    if (!strcmp(argv[1],"--help")) {
+      show_input_options_help(3);
+      return -1;
+    }
+
+    dataset_path = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+      if (!strcmp(argv[i],"--options")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else if (!read_akaze_options(argv[i], options)) {
+          cerr << "Error: cannot load the options from file:" << endl << argv[i] << endl;
+          return -1;
+        }
+      }
+      else if (!strcmp(argv[i],"--soffset")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.soffset = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--omin")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.omin = atoi(argv[i]);
+          if (options.omin < 0 || options.omin > 2) {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--omax")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.omax = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--dthreshold")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.dthreshold = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sderivatives")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sderivatives = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--nsublevels")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.nsublevels = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--diffusivity")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.diffusivity = DIFFUSIVITY_TYPE(atoi(argv[i]));
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor = DESCRIPTOR_TYPE(atoi(argv[i]));
+
+          if (options.descriptor < 0 || options.descriptor > MLDB) {
+            options.descriptor = MLDB;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_channels")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_channels = atoi(argv[i]);
+
+          if (options.descriptor_channels <= 0 || options.descriptor_channels > 3) {
+            options.descriptor_channels = 3;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_size")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_size = atoi(argv[i]);
+
+          if (options.descriptor_size < 0) {
+            options.descriptor_size = 0;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--nruns")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          nruns = atoi(argv[i]);
+
+          if (nruns < 1) {
+            nruns = 1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--min_repeatability")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          min_repeatability = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--min_matching_score")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          min_matching_score = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pin_threads")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pin_threads = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--first_touch")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.first_touch = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pipeline")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pipeline = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--wavefront")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.wavefront = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_derivatives")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_derivatives = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_detector")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_detector = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_plane")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_plane = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--mldb_angle_bins")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.mldb_angle_bins = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--extra_descriptors")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.extra_descriptors = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_bits")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_bits = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_padding")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_padding = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_int8")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_int8 = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pca_basis")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pca_basis = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--orientation_ratio")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.orientation_ratio = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--huge_pages")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.huge_pages = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--storage")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int storage = atoi(argv[i]);
+          if (storage == 0)
+            options.storage = STORAGE_FP32;
+          else if (storage == 1)
+            options.storage = STORAGE_FP16;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--engine")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int engine = atoi(argv[i]);
+          if (engine == 0)
+            options.engine = ENGINE_FLOAT;
+          else if (engine == 1)
+            options.engine = ENGINE_FIXED;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--verbose")) {
+        options.verbosity = true;
+      }
+    }
+  }
+
+  return 0;
+}
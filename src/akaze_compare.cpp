@@ -122,10 +122,6 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
-  // Convert the images to float
-  img1.convertTo(img1_32,CV_32F,1.0/255.0,0);
-  img2.convertTo(img2_32,CV_32F,1.0/255.0,0);
-
   // Color images for results visualization
   cv::Mat img1_rgb_orb = cv::Mat(cv::Size(img1.cols, img1.rows), CV_8UC3);
   cv::Mat img2_rgb_orb = cv::Mat(cv::Size(img2.cols, img1.rows), CV_8UC3);
@@ -262,12 +258,24 @@ int main(int argc, char *argv[]) {
   /* ************************************************************************* */
   // A-KAZE Features
   //*******************
-  options.img_width = img1.cols;
-  options.img_height = img1.rows;
+  // The evolution starts at octave omin, so the images are decoded at 1/2^omin of their size.
+  // The keypoints are still in pixels of the original images
+  cv::Mat img1_akaze = img1, img2_akaze = img2;
+  if (options.omin > 0) {
+    img1_akaze = read_image(img_path1, options.omin);
+    img2_akaze = read_image(img_path2, options.omin);
+  }
+
+  // Convert the images to float
+  img1_akaze.convertTo(img1_32,CV_32F,1.0/255.0,0);
+  img2_akaze.convertTo(img2_32,CV_32F,1.0/255.0,0);
+
+  options.img_width = img1_akaze.cols;
+  options.img_height = img1_akaze.rows;
   libAKAZE::AKAZE evolution1(options);
 
-  options.img_width = img2.cols;
-  options.img_height = img2.rows;
+  options.img_width = img2_akaze.cols;
+  options.img_height = img2_akaze.rows;
   libAKAZE::AKAZE evolution2(options);
 
   t1 = cv::getTickCount();
@@ -280,7 +288,9 @@ int main(int argc, char *argv[]) {
   evolution2.Feature_Detection(kpts2_akaze);
   evolution2.Compute_Descriptors(kpts2_akaze, desc2_akaze);
 
-  if (options.descriptor < MLDB_UPRIGHT)
+  if (options.descriptor < MLDB_UPRIGHT && options.descriptor_int8 == true && options.pca_basis.empty())
+    match_int8_descriptors(desc1_akaze, desc2_akaze, dmatches_akaze);
+  else if (options.descriptor < MLDB_UPRIGHT)
     matcher_l2->knnMatch(desc1_akaze, desc2_akaze, dmatches_akaze, 2);
 
   // Binary descriptor, use Hamming distance
@@ -356,7 +366,18 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path1, std::stri
       homography_path = argv[3];
 
     for (int i = 3; i < argc; i++) {
-      if (!strcmp(argv[i],"--soffset")) {
+      if (!strcmp(argv[i],"--options")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else if (!read_akaze_options(argv[i], options)) {
+          cerr << "Error: cannot load the options from file:" << endl << argv[i] << endl;
+          return -1;
+        }
+      }
+      else if (!strcmp(argv[i],"--soffset")) {
         i = i+1;
         if (i >= argc) {
           cerr << "Error introducing input options!!" << endl;
@@ -366,6 +387,20 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path1, std::stri
           options.soffset = atof(argv[i]);
         }
       }
+      else if (!strcmp(argv[i],"--omin")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.omin = atoi(argv[i]);
+          if (options.omin < 0 || options.omin > 2) {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
       else if (!strcmp(argv[i],"--omax")) {
         i = i+1;
         if (i >= argc) {
@@ -468,6 +503,192 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path1, std::stri
           options.show_results = (bool)atoi(argv[i]);
         }
       }
+      else if (!strcmp(argv[i],"--pin_threads")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pin_threads = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--first_touch")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.first_touch = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pipeline")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pipeline = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--wavefront")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.wavefront = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_derivatives")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_derivatives = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_detector")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_detector = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_plane")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_plane = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--mldb_angle_bins")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.mldb_angle_bins = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--extra_descriptors")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.extra_descriptors = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_bits")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_bits = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_padding")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_padding = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_int8")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_int8 = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pca_basis")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pca_basis = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--orientation_ratio")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.orientation_ratio = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--huge_pages")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.huge_pages = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--storage")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int storage = atoi(argv[i]);
+          if (storage == 0)
+            options.storage = STORAGE_FP32;
+          else if (storage == 1)
+            options.storage = STORAGE_FP16;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--engine")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int engine = atoi(argv[i]);
+          if (engine == 0)
+            options.engine = ENGINE_FLOAT;
+          else if (engine == 1)
+            options.engine = ENGINE_FIXED;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
       else if (!strcmp(argv[i],"--verbose")) {
         options.verbosity = true;
       }
@@ -0,0 +1,1730 @@
+//=============================================================================
+//
+// akaze_conformance.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file akaze_conformance.cpp
+ * @brief Program that checks the kernels of the library supported by the CPU
+ * against the scalar reference kernels on random images of random sizes
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "./lib/AKAZE.h"
+
+// OpenCV
+#include <opencv2/imgproc.hpp>
+
+// System
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+using namespace libAKAZE;
+
+/* ************************************************************************* */
+/// Tolerances of the conformance test
+struct ConformanceTolerances {
+
+  ConformanceTolerances() {
+    max_ulp = 4;
+    max_abs = 1e-5;
+    max_kpts_diff = 1.0;
+    max_bitflip = 1.0;
+    max_fixed_bitflip = 5.0;
+  }
+
+  long long max_ulp;        ///< Maximum distance in ULPs between two values
+  double max_abs;           ///< Maximum absolute error. Values within max_ulp OR max_abs pass
+  double max_kpts_diff;     ///< Maximum percentage of keypoints not found by both backends
+  double max_bitflip;       ///< Maximum percentage of different descriptor bits
+  double max_fixed_bitflip; ///< Maximum percentage of different M-LDB bits between the fixed point and float engines
+};
+
+/// Errors of one stage of the computation
+struct StageError {
+
+  StageError(const std::string& stage_name = "") {
+    name = stage_name;
+    nvalues = 0;
+    nfailures = 0;
+    max_abs = 0.0;
+    max_ulp = 0;
+  }
+
+  std::string name;         ///< Name of the stage
+  size_t nvalues;           ///< Number of compared values
+  size_t nfailures;         ///< Number of values out of the tolerances
+  double max_abs;           ///< Maximum absolute error
+  long long max_ulp;        ///< Maximum distance in ULPs
+};
+
+/// Errors of the test kernels against the reference kernels, one kernel at a time and
+/// in the whole evolution
+struct KernelErrors {
+
+  KernelErrors() {
+    diffusivity[0] = StageError("pm_g1");
+    diffusivity[1] = StageError("pm_g2");
+    diffusivity[2] = StageError("weickert_diffusivity");
+    diffusivity[3] = StageError("charbonnier_diffusivity");
+    scharr = StageError("compute_scharr_derivatives");
+    nld = StageError("nld_step_scalar");
+    flux = StageError("nld_flux_rows");
+    guarded = StageError("nld_step_guarded");
+    hessian = StageError("compute_determinant_hessian");
+    mldb = StageError("mldb_fill_values");
+    gather = StageError("mldb_gather_values");
+    msurf = StageError("msurf_descriptor");
+    half = StageError("convert_to/from_half");
+    plane = StageError("pack_descriptor_plane");
+    fixed_filter = StageError("fixed_sep_filter");
+    fixed_diffusivity = StageError("fixed_diffusivity");
+    fixed_nld = StageError("nld_step_fixed");
+    fixed_guarded = StageError("nld_step_fixed_guarded");
+    fixed_hessian = StageError("fixed_determinant_hessian");
+    lt = StageError("evolution Lt");
+    ldet = StageError("evolution Ldet");
+    mldb_bits = 0;
+    mldb_flips = 0;
+    nkpts = 0;
+    nkpts_diff = 0;
+    desc_bits = 0;
+    desc_flips = 0;
+  }
+
+  StageError diffusivity[4], scharr, nld, flux, guarded, hessian;
+  StageError mldb, gather, msurf, half, plane;
+  StageError fixed_filter, fixed_diffusivity, fixed_nld, fixed_guarded, fixed_hessian;
+  StageError lt, ldet;
+
+  size_t mldb_bits;         ///< Number of compared M-LDB comparison bits
+  size_t mldb_flips;        ///< Number of different M-LDB comparison bits
+  size_t nkpts;             ///< Number of keypoints of both evolutions
+  size_t nkpts_diff;        ///< Number of keypoints found by only one of the evolutions
+  size_t desc_bits;         ///< Number of compared descriptor bits of the common keypoints
+  size_t desc_flips;        ///< Number of different descriptor bits of the common keypoints
+};
+
+/// Random image of a check, with the kernels and the tolerances
+struct CheckContext {
+
+  CheckContext(const AKAZEKernels& ref_kernels, const AKAZEKernels& test_kernels,
+               const ConformanceTolerances& tolerances, cv::RNG& random)
+    : ref(ref_kernels), test(test_kernels), tol(tolerances), rng(random) {
+  }
+
+  const AKAZEKernels& ref;          ///< Reference kernels
+  const AKAZEKernels& test;         ///< Kernels to check
+  const ConformanceTolerances& tol; ///< Tolerances of the test
+  cv::RNG& rng;                     ///< Random number generator of the test
+  cv::Mat img;                      ///< Random image
+};
+
+struct FeatureCheck;
+
+/// Check of a feature of the library on the image of the context. It adds its compared
+/// values and differences to the check, and returns false if it cannot be run
+typedef bool (*feature_check_function)(const CheckContext& ctx, FeatureCheck& check);
+
+/// Differences of the results of a feature of the library against the same results
+/// computed without it
+struct FeatureCheck {
+
+  FeatureCheck(const std::string& check_name, feature_check_function check_function,
+               double max_percentage) {
+    name = check_name;
+    function = check_function;
+    max_diff = max_percentage;
+    nvalues = 0;
+    ndiff = 0;
+    error = StageError(check_name);
+  }
+
+  std::string name;                 ///< Name of the check
+  feature_check_function function;  ///< Function of the check
+  double max_diff;                  ///< Maximum percentage of differences
+  size_t nvalues;                   ///< Number of compared keypoints, descriptors or bits
+  size_t ndiff;                     ///< Number of differences
+  StageError error;                 ///< Errors of the float values compared by the check, if any
+};
+
+/* ************************************************************************* */
+/**
+ * @brief This function parses the command line arguments of the conformance test
+ * @param tol Tolerances of the test
+ * @param nimages Number of random images
+ * @param min_size Minimum width and height of the images
+ * @param max_size Maximum width and height of the images
+ * @param seed Seed of the random number generator
+ * @param verbose Set to true for showing the errors of every image
+ * @param kernels_name Name of the kernels to check. All the kernels supported by the CPU if empty
+ */
+int parse_input_options(ConformanceTolerances& tol, int& nimages, int& min_size,
+                        int& max_size, int& seed, bool& verbose, std::string& kernels_name,
+                        int argc, char *argv[]);
+
+/// This function checks the test kernels against the reference kernels and the features
+/// of the library with the test kernels, and shows the errors of every stage and check.
+/// Returns true if the test kernels are within the tolerances
+bool check_kernels(const AKAZEKernels& ref, const AKAZEKernels& test,
+                   const ConformanceTolerances& tol, int nimages, int min_size,
+                   int max_size, int seed, bool verbose);
+
+/// This function checks the kernels one by one on the image of the context
+void check_kernel_stages(const CheckContext& ctx, KernelErrors& errors);
+
+/// This function checks the whole evolutions with the reference and the test kernels, and
+/// the M-LDB and M-SURF kernels on the levels of the reference evolution
+void check_evolutions(const CheckContext& ctx, KernelErrors& errors);
+
+/// This function creates an AKAZE instance with the options for the image and the kernels,
+/// creates its nonlinear scale space and detects its keypoints if kpts is not NULL.
+/// Returns false if the nonlinear scale space cannot be created
+bool create_engine(AKAZEOptions options, const AKAZEKernels& kernels, const cv::Mat& img,
+                   cv::Ptr<AKAZE>& evolution, std::vector<cv::KeyPoint>* kpts = NULL);
+
+/// Returns the number of keypoints of a found at less than half a pixel from a keypoint
+/// of b in the same level
+size_t matched_keypoints(const std::vector<cv::KeyPoint>& a, const std::vector<cv::KeyPoint>& b);
+
+/// The fixed point engine must find the keypoints of the float engine. Only reported
+bool check_fixed_engine_keypoints(const CheckContext& ctx, FeatureCheck& check);
+
+/// The M-LDB descriptors of the fixed point engine at the keypoints of the float engine
+/// must have the bits of the float engine
+bool check_fixed_engine_descriptors(const CheckContext& ctx, FeatureCheck& check);
+
+/// The wavefront scale space runs the same arithmetic on bands of rows
+bool check_wavefront(const CheckContext& ctx, FeatureCheck& check);
+
+/// The pipelined scale space must find the same keypoints, in the same order
+bool check_pipeline(const CheckContext& ctx, FeatureCheck& check);
+
+/// The detected keypoints described as external keypoints must give the same descriptors
+bool check_external_keypoints(const CheckContext& ctx, FeatureCheck& check);
+
+/// The dense upright M-LDB descriptors against the descriptors of the grid sites
+bool check_dense_mldb(const CheckContext& ctx, FeatureCheck& check);
+
+/// The dense upright M-SURF descriptors against the descriptors of the grid sites
+bool check_dense_msurf(const CheckContext& ctx, FeatureCheck& check);
+
+/// M-LDB with M-SURF in one pass against one descriptor per instance
+bool check_descriptor_set(const CheckContext& ctx, FeatureCheck& check);
+
+/// The padded descriptors must be aligned, with the same bytes and zeros after them
+bool check_descriptor_padding(const CheckContext& ctx, FeatureCheck& check);
+
+/// The int8 M-SURF descriptors against the float descriptors and the reference dot products
+bool check_int8_descriptors(const CheckContext& ctx, FeatureCheck& check);
+
+/// The M-SURF descriptors projected as they are computed against the reference projection
+bool check_pca_projection(const CheckContext& ctx, FeatureCheck& check);
+
+/// The secondary orientations must keep the descriptors of the main orientations
+bool check_secondary_orientations(const CheckContext& ctx, FeatureCheck& check);
+
+/// The descriptor with a bit selection table against the bits of the full length descriptor
+bool check_bit_selection_table(const CheckContext& ctx, FeatureCheck& check);
+
+/// The sparse derivatives must give the same descriptors
+bool check_sparse_derivatives(const CheckContext& ctx, FeatureCheck& check);
+
+/// The sparse detector must find the keypoints of the whole levels
+bool check_sparse_detector(const CheckContext& ctx, FeatureCheck& check);
+
+/// The interleaved descriptor plane must give the descriptors of the float planes
+bool check_descriptor_plane(const CheckContext& ctx, FeatureCheck& check);
+
+/// This function shows the command line options of the conformance test
+void show_conformance_help();
+
+/// This function creates a random image with blobs, corners and noise
+void create_random_image(cv::RNG& rng, int min_size, int max_size, cv::Mat& img);
+
+/// Returns the distance in units in the last place between two floats
+long long ulp_distance(float a, float b);
+
+/// This function compares two float images and updates the errors of the stage
+void compare_images(const cv::Mat& ref, const cv::Mat& test,
+                    const ConformanceTolerances& tol, StageError& error);
+
+/// This function compares two fixed point (CV_16S) images and updates the errors of the
+/// stage, in units of the last fractional bit
+void compare_fixed_images(const cv::Mat& ref, const cv::Mat& test, StageError& error);
+
+/// Returns the path of a file with the given name in the temporary folder of the system
+std::string temporary_path(const std::string& name);
+
+/// Returns the float image of a half precision (CV_16U) plane
+cv::Mat decode_half(const AKAZEKernels& kernels, const cv::Mat& half);
+
+/// Returns the number of different bits between two binary descriptors
+int hamming_distance(const unsigned char* a, const unsigned char* b, int nbytes);
+
+/* ************************************************************************* */
+int main(int argc, char *argv[]) {
+
+  ConformanceTolerances tol;
+  int nimages = 20, min_size = 64, max_size = 640, seed = 0;
+  bool verbose = false;
+  string kernels_name;
+
+  if (parse_input_options(tol, nimages, min_size, max_size, seed, verbose,
+                          kernels_name, argc, argv))
+    return -1;
+
+  // Kernels to check
+  vector<const AKAZEKernels*> kernels;
+  if (kernels_name.empty()) {
+    available_kernels(kernels);
+  }
+  else {
+    const AKAZEKernels* test = find_kernels(kernels_name);
+    if (test == NULL) {
+      cerr << "Error: the " << kernels_name << " kernels are not available in this CPU!!" << endl;
+      return 1;
+    }
+    kernels.push_back(test);
+  }
+
+  bool passed = true;
+  for (size_t i = 0; i < kernels.size(); i++) {
+    if (check_kernels(reference_kernels(), *kernels[i], tol, nimages, min_size,
+                      max_size, seed, verbose) == false)
+      passed = false;
+  }
+
+  return (passed ? 0 : 1);
+}
+
+/* ************************************************************************* */
+bool check_kernels(const AKAZEKernels& ref, const AKAZEKernels& test,
+                   const ConformanceTolerances& tol, int nimages, int min_size,
+                   int max_size, int seed, bool verbose) {
+
+  cout << "Checking the " << test.name << " kernels against the " << ref.name
+       << " kernels on " << nimages << " random images" << endl;
+
+  cv::RNG rng(seed);
+  CheckContext ctx(ref, test, tol, rng);
+  KernelErrors errors;
+
+  // Features of the library with the test kernels, in the order they run on every image.
+  // The checks of float values have no percentage of differences
+  FeatureCheck checks[] = {
+    FeatureCheck("Fixed point engine keypoints not found", check_fixed_engine_keypoints, 100.0),
+    FeatureCheck("Fixed point engine M-LDB bit error rate", check_fixed_engine_descriptors, tol.max_fixed_bitflip),
+    FeatureCheck("wavefront Lt", check_wavefront, 0.0),
+    FeatureCheck("Pipelined keypoints differences", check_pipeline, 0.0),
+    FeatureCheck("External keypoints descriptor differences", check_external_keypoints, 0.0),
+    FeatureCheck("Dense upright M-LDB bit flips", check_dense_mldb, tol.max_bitflip),
+    FeatureCheck("dense upright M-SURF", check_dense_msurf, 0.0),
+    FeatureCheck("Descriptor set differences", check_descriptor_set, 0.0),
+    FeatureCheck("Padded descriptor differences", check_descriptor_padding, 0.0),
+    FeatureCheck("Int8 descriptor differences", check_int8_descriptors, 0.0),
+    FeatureCheck("pca_projection", check_pca_projection, 0.0),
+    FeatureCheck("Secondary orientations keypoints differences", check_secondary_orientations, 0.0),
+    FeatureCheck("Bit selection table bit flips", check_bit_selection_table, tol.max_bitflip),
+    FeatureCheck("Sparse derivatives descriptor differences", check_sparse_derivatives, 0.0),
+    FeatureCheck("Sparse detector keypoints differences", check_sparse_detector, tol.max_kpts_diff),
+    FeatureCheck("Descriptor plane descriptor differences", check_descriptor_plane, 0.0)
+  };
+  const size_t nchecks = sizeof(checks)/sizeof(checks[0]);
+
+  for (int n = 0; n < nimages; n++) {
+
+    create_random_image(rng, min_size, max_size, ctx.img);
+
+    check_kernel_stages(ctx, errors);
+    check_evolutions(ctx, errors);
+
+    for (size_t i = 0; i < nchecks; i++) {
+      if (checks[i].function(ctx, checks[i]) == false) {
+        cerr << "Error: cannot run the check: " << checks[i].name << endl;
+        return false;
+      }
+    }
+
+    if (verbose) {
+      cout << "Image " << n << " (" << ctx.img.cols << "x" << ctx.img.rows << "): "
+           << "keypoints differences " << errors.nkpts_diff << "/" << errors.nkpts
+           << ", descriptor bit flips " << errors.desc_flips << "/" << errors.desc_bits << endl;
+      for (size_t i = 0; i < nchecks; i++) {
+        if (checks[i].error.nvalues == 0)
+          cout << "  " << checks[i].name << " " << checks[i].ndiff << "/" << checks[i].nvalues << endl;
+      }
+    }
+  }
+
+  // Report
+  vector<StageError> stages;
+  for (int i = 0; i < 4; i++)
+    stages.push_back(errors.diffusivity[i]);
+  stages.push_back(errors.scharr);
+  stages.push_back(errors.nld);
+  stages.push_back(errors.flux);
+  stages.push_back(errors.guarded);
+  stages.push_back(errors.hessian);
+  stages.push_back(errors.mldb);
+  stages.push_back(errors.gather);
+  stages.push_back(errors.msurf);
+  stages.push_back(errors.half);
+  stages.push_back(errors.plane);
+  stages.push_back(errors.fixed_filter);
+  stages.push_back(errors.fixed_diffusivity);
+  stages.push_back(errors.fixed_nld);
+  stages.push_back(errors.fixed_guarded);
+  stages.push_back(errors.fixed_hessian);
+  stages.push_back(errors.lt);
+  stages.push_back(errors.ldet);
+  for (size_t i = 0; i < nchecks; i++) {
+    if (checks[i].error.nvalues > 0)
+      stages.push_back(checks[i].error);
+  }
+
+  bool passed = true;
+
+  cout << endl << left;
+  cout << setw(28) << "Stage" << setw(12) << "Values" << setw(14) << "Max abs"
+       << setw(14) << "Max ULP" << setw(12) << "Failures" << endl;
+
+  for (size_t i = 0; i < stages.size(); i++) {
+    cout << setw(28) << stages[i].name << setw(12) << stages[i].nvalues
+         << setw(14) << stages[i].max_abs << setw(14) << stages[i].max_ulp
+         << setw(12) << stages[i].nfailures << endl;
+    if (stages[i].nfailures > 0)
+      passed = false;
+  }
+
+  double kpts_diff = (errors.nkpts > 0 ? 100.0*errors.nkpts_diff/(double)errors.nkpts : 0.0);
+  double mldb_bitflip = (errors.mldb_bits > 0 ? 100.0*errors.mldb_flips/(double)errors.mldb_bits : 0.0);
+  double desc_bitflip = (errors.desc_bits > 0 ? 100.0*errors.desc_flips/(double)errors.desc_bits : 0.0);
+
+  cout << endl;
+  cout << "Keypoints differences (%): " << kpts_diff
+       << " (" << errors.nkpts_diff << "/" << errors.nkpts << ")" << endl;
+  cout << "M-LDB comparisons bit flips (%): " << mldb_bitflip
+       << " (" << errors.mldb_flips << "/" << errors.mldb_bits << ")" << endl;
+  cout << "Descriptor bit flips (%): " << desc_bitflip
+       << " (" << errors.desc_flips << "/" << errors.desc_bits << ")" << endl;
+
+  if (kpts_diff > tol.max_kpts_diff || mldb_bitflip > tol.max_bitflip || desc_bitflip > tol.max_bitflip)
+    passed = false;
+
+  // The checks of float values are in the table of the stages
+  for (size_t i = 0; i < nchecks; i++) {
+    if (checks[i].error.nvalues > 0)
+      continue;
+
+    double diff = (checks[i].nvalues > 0 ? 100.0*checks[i].ndiff/(double)checks[i].nvalues : 0.0);
+    cout << checks[i].name << " (%): " << diff
+         << " (" << checks[i].ndiff << "/" << checks[i].nvalues << ")" << endl;
+    if (diff > checks[i].max_diff)
+      passed = false;
+  }
+
+  if (passed == false) {
+    cerr << endl << "Error: the " << test.name << " kernels exceed the conformance tolerances!!" << endl;
+    return false;
+  }
+
+  cout << endl << "Conformance test of the " << test.name << " kernels passed" << endl << endl;
+  return true;
+}
+
+/* ************************************************************************* */
+void check_kernel_stages(const CheckContext& ctx, KernelErrors& errors) {
+
+  const AKAZEKernels& ref = ctx.ref;
+  const AKAZEKernels& test = ctx.test;
+  const ConformanceTolerances& tol = ctx.tol;
+  const cv::Mat& img = ctx.img;
+  cv::RNG& rng = ctx.rng;
+
+  cv::Mat smooth, Lx, Ly;
+  gaussian_2D_convolution(img, smooth, 0, 0, 1.0);
+  image_derivatives_scharr(smooth, Lx, 1, 0);
+  image_derivatives_scharr(smooth, Ly, 0, 1);
+  float k = compute_k_percentile(img, 0.7, 1.0, 300, 0, 0);
+
+  // Diffusivities
+  diffusivity_kernel ref_g[4] = {ref.pm_g1, ref.pm_g2, ref.weickert_diffusivity, ref.charbonnier_diffusivity};
+  diffusivity_kernel test_g[4] = {test.pm_g1, test.pm_g2, test.weickert_diffusivity, test.charbonnier_diffusivity};
+
+  for (int i = 0; i < 4; i++) {
+    cv::Mat gref(img.size(), CV_32F), gtest(img.size(), CV_32F);
+    ref_g[i](Lx, Ly, gref, k);
+    test_g[i](Lx, Ly, gtest, k);
+    compare_images(gref, gtest, tol, errors.diffusivity[i]);
+  }
+
+  // Multiscale derivatives
+  for (size_t scale = 1; scale <= 4; scale++) {
+    for (size_t order = 0; order < 2; order++) {
+      cv::Mat dref, dtest;
+      ref.compute_scharr_derivatives(smooth, dref, 1-order, order, scale);
+      test.compute_scharr_derivatives(smooth, dtest, 1-order, order, scale);
+      compare_images(dref, dtest, tol, errors.scharr);
+    }
+  }
+
+  // Explicit diffusion steps
+  cv::Mat c(img.size(), CV_32F);
+  ref.pm_g2(Lx, Ly, c, k);
+  cv::Mat Ldref = smooth.clone(), Ldtest = smooth.clone();
+  cv::Mat Lstep_ref(img.size(), CV_32F), Lstep_test(img.size(), CV_32F);
+
+  for (int j = 0; j < 3; j++) {
+    float stepsize = rng.uniform(0.05f, 2.0f);
+    ref.nld_step_scalar(Ldref, c, Lstep_ref, stepsize);
+    test.nld_step_scalar(Ldtest, c, Lstep_test, stepsize);
+  }
+  compare_images(Ldref, Ldtest, tol, errors.nld);
+
+  // Flux of a random band of rows, on images with the replicated guard band of the evolution
+  cv::Mat Ld_guard, c_guard;
+  cv::copyMakeBorder(smooth, Ld_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+  cv::copyMakeBorder(c, c_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+  cv::Rect inner(1, 1, img.cols, img.rows);
+  int y0 = rng.uniform(0, img.rows), y1 = rng.uniform(y0+1, img.rows+1);
+  float stepsize = rng.uniform(0.05f, 2.0f);
+  ref.nld_flux_rows(Ld_guard(inner), c_guard(inner), Lstep_ref, stepsize, y0, y1);
+  test.nld_flux_rows(Ld_guard(inner), c_guard(inner), Lstep_test, stepsize, y0, y1);
+  compare_images(Lstep_ref.rowRange(y0, y1), Lstep_test.rowRange(y0, y1), tol, errors.flux);
+
+  // Guarded steps, filling the guard band again before every step as AKAZE does
+  cv::Mat Ldg_ref = smooth.clone(), Ldg_test = Ld_guard(inner);
+  for (int j = 0; j < 3; j++) {
+    float stepsize = rng.uniform(0.05f, 2.0f);
+    ref.nld_step_scalar(Ldg_ref, c, Lstep_ref, stepsize);
+    cv::copyMakeBorder(Ldg_test.clone(), Ld_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+    test.nld_step_guarded(Ldg_test, c_guard(inner), Lstep_test, stepsize, OMP_MAX_THREADS);
+  }
+  compare_images(Ldg_ref, Ldg_test, tol, errors.guarded);
+
+  // Determinant of the Hessian
+  cv::Mat Lxx, Lxy, Lyy;
+  ref.compute_scharr_derivatives(Lx, Lxx, 1, 0, 1);
+  ref.compute_scharr_derivatives(Lx, Lxy, 0, 1, 1);
+  ref.compute_scharr_derivatives(Ly, Lyy, 0, 1, 1);
+  float hessian_scale = (float)pow(rng.uniform(1, 6), 4);
+  cv::Mat Ldet_ref(img.size(), CV_32F), Ldet_test(img.size(), CV_32F);
+  ref.compute_determinant_hessian(Lxx, Lxy, Lyy, Ldet_ref, hessian_scale);
+  test.compute_determinant_hessian(Lxx, Lxy, Lyy, Ldet_test, hessian_scale);
+  compare_images(Ldet_ref, Ldet_test, tol, errors.hessian);
+
+  // Half precision conversions. Both must round to the same values
+  cv::Mat half_ref, half_test;
+  ref.convert_to_half(Ldref, half_ref);
+  test.convert_to_half(Ldref, half_test);
+  cv::Mat back_ref(img.size(), CV_32F), back_test(img.size(), CV_32F);
+  for (int y = 0; y < img.rows; y++) {
+    ref.convert_from_half(half_ref.ptr<unsigned short>(y), back_ref.ptr<float>(y), img.cols);
+    test.convert_from_half(half_test.ptr<unsigned short>(y), back_test.ptr<float>(y), img.cols);
+  }
+  ConformanceTolerances exact;
+  exact.max_ulp = 0;
+  exact.max_abs = 0.0;
+  compare_images(back_ref, back_test, exact, errors.half);
+
+  // Interleaved descriptor plane. It is a copy, so both must give the same values
+  cv::Mat plane_ref(img.size(), CV_32FC4), plane_test(img.size(), CV_32FC4);
+  ref.pack_descriptor_plane(smooth, Lx, Ly, plane_ref);
+  test.pack_descriptor_plane(smooth, Lx, Ly, plane_test);
+  compare_images(plane_ref.reshape(1), plane_test.reshape(1), exact, errors.plane);
+
+  // Fixed point kernels. They are integer, so both must give the same values
+  cv::Mat smooth_q, fx_ref, fx_test, fy_ref, fy_test;
+  smooth.convertTo(smooth_q, CV_16S, (double)(1 << fixed_image_bits));
+  const int first_shift = fixed_tap_bits + fixed_image_bits + 2 - fixed_derivative_bits;
+  const int second_shift = fixed_tap_bits + 2;
+
+  cv::Mat gauss;
+  compute_fixed_gaussian_kernel(gauss, rng.uniform(1.0f, 3.0f));
+  ref.fixed_sep_filter(smooth_q, fx_ref, gauss, gauss, second_shift, cv::BORDER_REPLICATE, OMP_MAX_THREADS);
+  test.fixed_sep_filter(smooth_q, fx_test, gauss, gauss, second_shift, cv::BORDER_REPLICATE, OMP_MAX_THREADS);
+  compare_fixed_images(fx_ref, fx_test, errors.fixed_filter);
+
+  size_t fixed_scale = rng.uniform(1, 5);
+  cv::Mat dx_kx, dx_ky, dy_kx, dy_ky;
+  compute_fixed_derivative_kernels(dx_kx, dx_ky, 1, 0, fixed_scale);
+  compute_fixed_derivative_kernels(dy_kx, dy_ky, 0, 1, fixed_scale);
+  ref.fixed_sep_filter(smooth_q, fx_ref, dx_kx, dx_ky, first_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  test.fixed_sep_filter(smooth_q, fx_test, dx_kx, dx_ky, first_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  ref.fixed_sep_filter(smooth_q, fy_ref, dy_kx, dy_ky, first_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  test.fixed_sep_filter(smooth_q, fy_test, dy_kx, dy_ky, first_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  compare_fixed_images(fx_ref, fx_test, errors.fixed_filter);
+  compare_fixed_images(fy_ref, fy_test, errors.fixed_filter);
+
+  vector<unsigned short> lut;
+  compute_fixed_diffusivity_lut(DIFFUSIVITY_TYPE(rng.uniform(0, 4)), k, lut);
+  cv::Mat c_ref(img.size(), CV_16S), c_test(img.size(), CV_16S);
+  ref.fixed_diffusivity(fx_ref, fy_ref, c_ref, &lut[0]);
+  test.fixed_diffusivity(fx_ref, fy_ref, c_test, &lut[0]);
+  compare_fixed_images(c_ref, c_test, errors.fixed_diffusivity);
+
+  // Large steps as in the last FED steps of the coarse levels
+  cv::Mat Lq_ref = smooth_q.clone(), Lq_test = smooth_q.clone();
+  cv::Mat Lstep_q(img.size(), CV_16S);
+  for (int j = 0; j < 3; j++) {
+    float stepsize = rng.uniform(0.05f, 40.0f);
+    ref.nld_step_fixed(Lq_ref, c_ref, Lstep_q, stepsize);
+    test.nld_step_fixed(Lq_test, c_ref, Lstep_q, stepsize);
+  }
+  compare_fixed_images(Lq_ref, Lq_test, errors.fixed_nld);
+
+  cv::Mat Lq_guard, cq_guard;
+  cv::copyMakeBorder(smooth_q, Lq_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+  cv::copyMakeBorder(c_ref, cq_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+  Lq_ref = smooth_q.clone();
+  Lq_test = Lq_guard(inner);
+  for (int j = 0; j < 3; j++) {
+    float stepsize = rng.uniform(0.05f, 40.0f);
+    ref.nld_step_fixed(Lq_ref, c_ref, Lstep_q, stepsize);
+    cv::copyMakeBorder(Lq_test.clone(), Lq_guard, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+    test.nld_step_fixed_guarded(Lq_test, cq_guard(inner), Lstep_q, stepsize, OMP_MAX_THREADS);
+  }
+  compare_fixed_images(Lq_ref, Lq_test, errors.fixed_guarded);
+
+  cv::Mat fxx, fxy, fyy;
+  ref.fixed_sep_filter(fx_ref, fxx, dx_kx, dx_ky, second_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  ref.fixed_sep_filter(fx_ref, fxy, dy_kx, dy_ky, second_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  ref.fixed_sep_filter(fy_ref, fyy, dy_kx, dy_ky, second_shift, cv::BORDER_REFLECT_101, OMP_MAX_THREADS);
+  ref.fixed_determinant_hessian(fxx, fxy, fyy, Ldet_ref, hessian_scale);
+  test.fixed_determinant_hessian(fxx, fxy, fyy, Ldet_test, hessian_scale);
+  compare_images(Ldet_ref, Ldet_test, exact, errors.fixed_hessian);
+}
+
+/* ************************************************************************* */
+void check_evolutions(const CheckContext& ctx, KernelErrors& errors) {
+
+  const AKAZEKernels& ref = ctx.ref;
+  const AKAZEKernels& test = ctx.test;
+  const ConformanceTolerances& tol = ctx.tol;
+  cv::RNG& rng = ctx.rng;
+
+  // Whole pipeline with the rotation invariant and upright M-LDB descriptors,
+  // in float and half precision storage and with the fixed point engine
+  for (int d = 0; d < 6; d++) {
+
+    AKAZEOptions options;
+    options.descriptor = (d % 2 == 0 ? MLDB : MLDB_UPRIGHT);
+    options.storage = (d/2 == 1 ? STORAGE_FP16 : STORAGE_FP32);
+    options.engine = (d/2 == 2 ? ENGINE_FIXED : ENGINE_FLOAT);
+    const bool rotated = (options.descriptor == MLDB);
+    const bool half = (options.storage == STORAGE_FP16);
+
+    cv::Ptr<AKAZE> evolution_ref, evolution_test;
+    vector<cv::KeyPoint> kpts_ref, kpts_test;
+    cv::Mat desc_ref, desc_test;
+
+    create_engine(options, ref, ctx.img, evolution_ref, &kpts_ref);
+    evolution_ref->Compute_Descriptors(kpts_ref, desc_ref);
+
+    create_engine(options, test, ctx.img, evolution_test, &kpts_test);
+    evolution_test->Compute_Descriptors(kpts_test, desc_test);
+
+    const vector<TEvolution>& eref = evolution_ref->Get_Evolution();
+    const vector<TEvolution>& etest = evolution_test->Get_Evolution();
+
+    // With half precision storage the levels are only kept in the half planes
+    for (size_t i = 0; i < eref.size(); i++) {
+      if (half) {
+        compare_images(decode_half(ref, eref[i].Lt16), decode_half(ref, etest[i].Lt16), tol, errors.lt);
+        compare_images(decode_half(ref, eref[i].Ldet16), decode_half(ref, etest[i].Ldet16), tol, errors.ldet);
+      }
+      else {
+        compare_images(eref[i].Lt, etest[i].Lt, tol, errors.lt);
+        compare_images(eref[i].Ldet, etest[i].Ldet, tol, errors.ldet);
+      }
+    }
+
+    // Keypoints found by only one of the backends
+    vector<int> match_test(kpts_test.size(), -1);
+    size_t nmatched = 0;
+
+    for (size_t i = 0; i < kpts_ref.size(); i++) {
+      for (size_t j = 0; j < kpts_test.size(); j++) {
+        if (match_test[j] == -1 && kpts_ref[i].class_id == kpts_test[j].class_id &&
+            fabs(kpts_ref[i].pt.x-kpts_test[j].pt.x) < 0.5 &&
+            fabs(kpts_ref[i].pt.y-kpts_test[j].pt.y) < 0.5) {
+          match_test[j] = i;
+          nmatched++;
+          break;
+        }
+      }
+    }
+
+    errors.nkpts += kpts_ref.size() + kpts_test.size();
+    errors.nkpts_diff += kpts_ref.size() + kpts_test.size() - 2*nmatched;
+
+    // Descriptor bit flips of the common keypoints
+    for (size_t j = 0; j < kpts_test.size(); j++) {
+      if (match_test[j] != -1) {
+        errors.desc_flips += hamming_distance(desc_ref.ptr<unsigned char>(match_test[j]),
+                                              desc_test.ptr<unsigned char>(j), desc_ref.cols);
+        errors.desc_bits += 8*desc_ref.cols;
+      }
+    }
+
+    // M-LDB kernels on the same reference evolution at random locations
+    const int pattern_size = options.descriptor_pattern_size;
+    const double size_mult[3] = {1, 2.0/3.0, 1.0/2.0};
+
+    for (size_t i = 0; i < eref.size(); i++) {
+
+      float ratio = (float)(1 << eref[i].octave);
+      float scale = (float)fRound(eref[i].esigma*options.derivative_factor/ratio);
+      int margin = (int)ceil(pattern_size*scale*sqrt(2.0f)) + 2;
+      if (2*margin >= eref[i].Lt.cols || 2*margin >= eref[i].Lt.rows)
+        continue;
+
+      for (int s = 0; s < 20; s++) {
+        float xf = rng.uniform((float)margin, (float)(eref[i].Lt.cols-margin));
+        float yf = rng.uniform((float)margin, (float)(eref[i].Lt.rows-margin));
+        float angle = rng.uniform(0.0f, (float)(2.0*CV_PI));
+        float co = (rotated ? cos(angle) : 1.0f), si = (rotated ? sin(angle) : 0.0f);
+
+        unsigned char bref[61], btest[61];
+        memset(bref, 0, sizeof(bref));
+        memset(btest, 0, sizeof(btest));
+        int pref = 0, ptest = 0;
+
+        for (int lvl = 0; lvl < 3; lvl++) {
+          float vref[16*3], vtest[16*3];
+          int val_count = (lvl + 2) * (lvl + 2);
+          int sample_step = static_cast<int>(ceil(pattern_size * size_mult[lvl]));
+
+          if (rotated) {
+            mldb_fill_kernel fill_ref = (half ? ref.mldb_fill_values_half : ref.mldb_fill_values);
+            mldb_fill_kernel fill_test = (half ? test.mldb_fill_values_half : test.mldb_fill_values);
+            fill_ref(eref[i], vref, sample_step, pattern_size, options.descriptor_channels,
+                     xf, yf, co, si, scale);
+            fill_test(eref[i], vtest, sample_step, pattern_size, options.descriptor_channels,
+                      xf, yf, co, si, scale);
+          }
+          else {
+            mldb_fill_upright_kernel fill_ref = (half ? ref.mldb_fill_upright_values_half :
+                                                        ref.mldb_fill_upright_values);
+            mldb_fill_upright_kernel fill_test = (half ? test.mldb_fill_upright_values_half :
+                                                         test.mldb_fill_upright_values);
+            fill_ref(eref[i], vref, sample_step, pattern_size, options.descriptor_channels,
+                     xf, yf, scale);
+            fill_test(eref[i], vtest, sample_step, pattern_size, options.descriptor_channels,
+                      xf, yf, scale);
+          }
+
+          compare_images(cv::Mat(1, val_count*options.descriptor_channels, CV_32F, vref),
+                         cv::Mat(1, val_count*options.descriptor_channels, CV_32F, vtest),
+                         tol, errors.mldb);
+
+          ref.mldb_binary_comparisons(vref, bref, val_count, options.descriptor_channels, pref);
+          test.mldb_binary_comparisons(vref, btest, val_count, options.descriptor_channels, ptest);
+        }
+
+        errors.mldb_flips += hamming_distance(bref, btest, (pref+7)/8);
+        errors.mldb_bits += pref;
+
+        // Sampling at the precomputed offsets of the same angle
+        if (rotated) {
+          vector<short> offsets;
+          compute_mldb_sampling_offsets(offsets, pattern_size, co, si, (int)scale);
+          const short* grid_offsets = &offsets[0];
+          mldb_gather_kernel gather_ref = (half ? ref.mldb_gather_values_half : ref.mldb_gather_values);
+          mldb_gather_kernel gather_test = (half ? test.mldb_gather_values_half : test.mldb_gather_values);
+
+          for (int lvl = 0; lvl < 3; lvl++) {
+            float vref[16*3], vtest[16*3];
+            int val_count = (lvl + 2) * (lvl + 2);
+            int sample_step = static_cast<int>(ceil(pattern_size * size_mult[lvl]));
+            int nsamples = sample_step*sample_step;
+            gather_ref(eref[i], vref, grid_offsets, val_count, nsamples, options.descriptor_channels,
+                       fRound(xf), fRound(yf), co, si);
+            gather_test(eref[i], vtest, grid_offsets, val_count, nsamples, options.descriptor_channels,
+                        fRound(xf), fRound(yf), co, si);
+            compare_images(cv::Mat(1, val_count*options.descriptor_channels, CV_32F, vref),
+                           cv::Mat(1, val_count*options.descriptor_channels, CV_32F, vtest),
+                           tol, errors.gather);
+            grid_offsets += 2*val_count*nsamples;
+          }
+        }
+      }
+
+      // M-SURF kernels on the float or half precision derivatives of the same levels
+      int msurf_margin = (int)ceil(12*scale*sqrt(2.0f)) + 2;
+      if (options.engine != ENGINE_FLOAT ||
+          2*msurf_margin >= eref[i].Lt.cols || 2*msurf_margin >= eref[i].Lt.rows)
+        continue;
+
+      for (int s = 0; s < 20; s++) {
+        float xf = rng.uniform((float)msurf_margin, (float)(eref[i].Lt.cols-msurf_margin));
+        float yf = rng.uniform((float)msurf_margin, (float)(eref[i].Lt.rows-msurf_margin));
+        float angle = rng.uniform(0.0f, (float)(2.0*CV_PI));
+        float dref[64], dtest[64];
+
+        if (rotated) {
+          msurf_kernel msurf_ref = (half ? ref.msurf_descriptor_half : ref.msurf_descriptor);
+          msurf_kernel msurf_test = (half ? test.msurf_descriptor_half : test.msurf_descriptor);
+          msurf_ref(eref[i], dref, xf, yf, cos(angle), sin(angle), (int)scale);
+          msurf_test(eref[i], dtest, xf, yf, cos(angle), sin(angle), (int)scale);
+        }
+        else {
+          msurf_upright_kernel msurf_ref = (half ? ref.msurf_upright_descriptor_half :
+                                                   ref.msurf_upright_descriptor);
+          msurf_upright_kernel msurf_test = (half ? test.msurf_upright_descriptor_half :
+                                                    test.msurf_upright_descriptor);
+          msurf_ref(eref[i], dref, xf, yf, (int)scale);
+          msurf_test(eref[i], dtest, xf, yf, (int)scale);
+        }
+
+        compare_images(cv::Mat(1, 64, CV_32F, dref), cv::Mat(1, 64, CV_32F, dtest),
+                       tol, errors.msurf);
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+bool create_engine(AKAZEOptions options, const AKAZEKernels& kernels, const cv::Mat& img,
+                   cv::Ptr<AKAZE>& evolution, std::vector<cv::KeyPoint>* kpts) {
+
+  options.img_width = img.cols;
+  options.img_height = img.rows;
+
+  evolution = cv::Ptr<AKAZE>(new AKAZE(options));
+  evolution->Set_Kernels(kernels);
+
+  if (evolution->Create_Nonlinear_Scale_Space(img) != 0)
+    return false;
+
+  if (kpts != NULL)
+    evolution->Feature_Detection(*kpts);
+
+  return true;
+}
+
+/* ************************************************************************* */
+size_t matched_keypoints(const std::vector<cv::KeyPoint>& a, const std::vector<cv::KeyPoint>& b) {
+
+  size_t nmatched = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    for (size_t j = 0; j < b.size(); j++) {
+      if (a[i].class_id == b[j].class_id &&
+          fabs(a[i].pt.x-b[j].pt.x) < 0.5 && fabs(a[i].pt.y-b[j].pt.y) < 0.5) {
+        nmatched++;
+        break;
+      }
+    }
+  }
+
+  return nmatched;
+}
+
+/* ************************************************************************* */
+bool check_fixed_engine_keypoints(const CheckContext& ctx, FeatureCheck& check) {
+
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution_float, evolution_fixed;
+  vector<cv::KeyPoint> kpts_float, kpts_fixed;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_float, &kpts_float) == false)
+    return false;
+  options.engine = ENGINE_FIXED;
+  if (create_engine(options, ctx.test, ctx.img, evolution_fixed, &kpts_fixed) == false)
+    return false;
+
+  check.nvalues += kpts_float.size();
+  check.ndiff += kpts_float.size() - matched_keypoints(kpts_float, kpts_fixed);
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_fixed_engine_descriptors(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The descriptors are computed at the keypoints of the float engine, so that all
+  // the bits are compared
+  for (int d = 0; d < 2; d++) {
+
+    AKAZEOptions options;
+    options.descriptor = (d == 0 ? MLDB : MLDB_UPRIGHT);
+
+    cv::Ptr<AKAZE> evolution_float, evolution_fixed;
+    vector<cv::KeyPoint> kpts_float, kpts_det;
+    cv::Mat desc_float, desc_fixed;
+
+    if (create_engine(options, ctx.test, ctx.img, evolution_float, &kpts_float) == false)
+      return false;
+    options.engine = ENGINE_FIXED;
+    if (create_engine(options, ctx.test, ctx.img, evolution_fixed, &kpts_det) == false)
+      return false;
+
+    evolution_float->Compute_Descriptors(kpts_float, desc_float);
+    evolution_fixed->Compute_Descriptors(kpts_float, desc_fixed);
+
+    for (int i = 0; i < desc_float.rows; i++) {
+      check.ndiff += hamming_distance(desc_float.ptr<unsigned char>(i),
+                                      desc_fixed.ptr<unsigned char>(i), desc_float.cols);
+      check.nvalues += 8*desc_float.cols;
+    }
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_wavefront(const CheckContext& ctx, FeatureCheck& check) {
+
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution_seq, evolution_wave;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_seq) == false)
+    return false;
+  options.wavefront = true;
+  if (create_engine(options, ctx.test, ctx.img, evolution_wave) == false)
+    return false;
+
+  const vector<TEvolution>& eseq = evolution_seq->Get_Evolution();
+  const vector<TEvolution>& ewave = evolution_wave->Get_Evolution();
+  for (size_t i = 0; i < eseq.size(); i++)
+    compare_images(eseq[i].Lt, ewave[i].Lt, ctx.tol, check.error);
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_pipeline(const CheckContext& ctx, FeatureCheck& check) {
+
+  for (int d = 0; d < 2; d++) {
+
+    AKAZEOptions options;
+    options.engine = (d == 0 ? ENGINE_FLOAT : ENGINE_FIXED);
+
+    cv::Ptr<AKAZE> evolution_seq, evolution_pipe;
+    vector<cv::KeyPoint> kpts_seq, kpts_pipe;
+
+    if (create_engine(options, ctx.test, ctx.img, evolution_seq, &kpts_seq) == false)
+      return false;
+    options.pipeline = true;
+    if (create_engine(options, ctx.test, ctx.img, evolution_pipe, &kpts_pipe) == false)
+      return false;
+
+    check.nvalues += kpts_seq.size();
+    if (kpts_pipe.size() != kpts_seq.size()) {
+      check.ndiff += max(kpts_pipe.size(), kpts_seq.size());
+    }
+    else {
+      for (size_t i = 0; i < kpts_seq.size(); i++) {
+        if (kpts_seq[i].pt != kpts_pipe[i].pt || kpts_seq[i].class_id != kpts_pipe[i].class_id ||
+            kpts_seq[i].response != kpts_pipe[i].response)
+          check.ndiff++;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_external_keypoints(const CheckContext& ctx, FeatureCheck& check) {
+
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution_det, evolution_ext;
+  vector<cv::KeyPoint> kpts_det, kpts_ext;
+  cv::Mat desc_det, desc_ext;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_det, &kpts_det) == false ||
+      create_engine(options, ctx.test, ctx.img, evolution_ext) == false)
+    return false;
+
+  evolution_det->Compute_Descriptors(kpts_det, desc_det);
+  kpts_ext = kpts_det;
+  evolution_ext->Compute_External_Descriptors(kpts_ext, desc_ext);
+
+  // The refined keypoints next to the borders may be removed, and the others keep their order
+  check.nvalues += kpts_ext.size();
+  size_t j = 0;
+  for (size_t i = 0; i < kpts_ext.size(); i++, j++) {
+    while (j < kpts_det.size() && kpts_det[j].pt != kpts_ext[i].pt)
+      j++;
+
+    if (j == kpts_det.size()) {
+      check.ndiff += kpts_ext.size() - i;
+      break;
+    }
+
+    if (kpts_ext[i].class_id != kpts_det[j].class_id ||
+        hamming_distance(desc_det.ptr<unsigned char>(j), desc_ext.ptr<unsigned char>(i), desc_det.cols) > 0)
+      check.ndiff++;
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_dense_mldb(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The shared cell sums against the grid sites computed one by one, in the middle level
+  AKAZEOptions options;
+  options.descriptor = MLDB_UPRIGHT;
+
+  cv::Ptr<AKAZE> evolution;
+  if (create_engine(options, ctx.test, ctx.img, evolution) == false)
+    return false;
+
+  vector<cv::KeyPoint> kpts_dense, kpts_sites;
+  cv::Mat desc_dense, desc_sites;
+  evolution->Compute_Dense_Descriptors(evolution->Get_Evolution().size()/2, 3, kpts_dense, desc_dense);
+  kpts_sites = kpts_dense;
+  evolution->Compute_Descriptors(kpts_sites, desc_sites);
+
+  for (size_t i = 0; i < kpts_dense.size(); i++) {
+    check.ndiff += hamming_distance(desc_sites.ptr<unsigned char>(i), desc_dense.ptr<unsigned char>(i),
+                                    desc_sites.cols);
+    check.nvalues += 8*desc_sites.cols;
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_dense_msurf(const CheckContext& ctx, FeatureCheck& check) {
+
+  AKAZEOptions options;
+  options.descriptor = MSURF_UPRIGHT;
+
+  cv::Ptr<AKAZE> evolution;
+  if (create_engine(options, ctx.test, ctx.img, evolution) == false)
+    return false;
+
+  vector<cv::KeyPoint> kpts_dense, kpts_sites;
+  cv::Mat desc_dense, desc_sites;
+  evolution->Compute_Dense_Descriptors(evolution->Get_Evolution().size()/2, 3, kpts_dense, desc_dense);
+  kpts_sites = kpts_dense;
+  evolution->Compute_Descriptors(kpts_sites, desc_sites);
+
+  if (kpts_dense.empty() == false)
+    compare_images(desc_sites, desc_dense, ctx.tol, check.error);
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_descriptor_set(const CheckContext& ctx, FeatureCheck& check) {
+
+  AKAZEOptions options;
+  options.extra_descriptors = (1 << MSURF);
+
+  cv::Ptr<AKAZE> evolution_set, evolution_mldb, evolution_msurf;
+  vector<cv::KeyPoint> kpts_set, kpts_mldb, kpts_msurf, kpts_det;
+  vector<cv::Mat> descs;
+  cv::Mat desc_mldb, desc_msurf;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_set, &kpts_set) == false)
+    return false;
+  kpts_mldb = kpts_set;
+  kpts_msurf = kpts_set;
+  evolution_set->Compute_Descriptors(kpts_set, descs);
+
+  options.extra_descriptors = 0;
+  if (create_engine(options, ctx.test, ctx.img, evolution_mldb, &kpts_det) == false)
+    return false;
+  evolution_mldb->Compute_Descriptors(kpts_mldb, desc_mldb);
+
+  options.descriptor = MSURF;
+  if (create_engine(options, ctx.test, ctx.img, evolution_msurf, &kpts_det) == false)
+    return false;
+  evolution_msurf->Compute_Descriptors(kpts_msurf, desc_msurf);
+
+  check.nvalues += kpts_set.size();
+  for (size_t i = 0; i < kpts_set.size(); i++) {
+    if (kpts_set[i].angle != kpts_mldb[i].angle ||
+        hamming_distance(descs[0].ptr<unsigned char>(i), desc_mldb.ptr<unsigned char>(i), desc_mldb.cols) > 0 ||
+        memcmp(descs[1].ptr<float>(i), desc_msurf.ptr<float>(i), 64*sizeof(float)) != 0)
+      check.ndiff++;
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_descriptor_padding(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The Hamming distances of the padded rows must be the reference ones of the unpadded rows
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution, evolution_padded;
+  vector<cv::KeyPoint> kpts, kpts_padded, kpts_det;
+  cv::Mat desc, desc_padded;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution, &kpts) == false)
+    return false;
+  kpts_padded = kpts;
+  evolution->Compute_Descriptors(kpts, desc);
+
+  options.descriptor_padding = true;
+  if (create_engine(options, ctx.test, ctx.img, evolution_padded, &kpts_det) == false)
+    return false;
+  evolution_padded->Compute_Descriptors(kpts_padded, desc_padded);
+
+  check.nvalues += kpts.size();
+  if (kpts.empty() == false &&
+      (desc_padded.cols % 64 != 0 || ((size_t)desc_padded.data & 63) != 0 || desc_padded.isContinuous() == false)) {
+    check.ndiff += kpts.size();
+    return true;
+  }
+
+  vector<int> dist_ref(kpts.size()), dist_test(kpts.size());
+  for (size_t i = 0; i < kpts.size(); i++) {
+    const unsigned char* d = desc_padded.ptr<unsigned char>(i);
+    bool differs = (memcmp(d, desc.ptr<unsigned char>(i), desc.cols) != 0);
+    for (int j = desc.cols; j < desc_padded.cols; j++)
+      differs = differs || (d[j] != 0);
+
+    ctx.ref.hamming_distances(desc.ptr<unsigned char>(i), desc, &dist_ref[0]);
+    ctx.test.hamming_distances(d, desc_padded, &dist_test[0]);
+    if (differs || dist_ref != dist_test)
+      check.ndiff++;
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_int8_descriptors(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The values converted back must be within half a quantization step of the float descriptors
+  AKAZEOptions options;
+  options.descriptor = MSURF;
+
+  cv::Ptr<AKAZE> evolution, evolution_int8;
+  vector<cv::KeyPoint> kpts, kpts_int8, kpts_det;
+  cv::Mat desc, desc_int8;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution, &kpts) == false)
+    return false;
+  kpts_int8 = kpts;
+  evolution->Compute_Descriptors(kpts, desc);
+
+  options.descriptor_int8 = true;
+  if (create_engine(options, ctx.test, ctx.img, evolution_int8, &kpts_det) == false)
+    return false;
+  evolution_int8->Compute_Descriptors(kpts_int8, desc_int8);
+
+  check.nvalues += kpts.size();
+  vector<int> dot_ref(kpts.size()), dot_test(kpts.size());
+  for (size_t i = 0; i < kpts.size(); i++) {
+    const float* d = desc.ptr<float>(i);
+    const signed char* q = desc_int8.ptr<signed char>(i);
+    float factor = 0.0f;
+    memcpy(&factor, q + 64, sizeof(float));
+
+    bool differs = false;
+    for (int j = 0; j < 64; j++)
+      differs = differs || (fabs(q[j]*factor - d[j]) > 0.5f*factor + 1e-6f);
+
+    ctx.ref.int8_dot_products(q, desc_int8, &dot_ref[0]);
+    ctx.test.int8_dot_products(q, desc_int8, &dot_test[0]);
+    if (differs || dot_ref != dot_test)
+      check.ndiff++;
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_pca_projection(const CheckContext& ctx, FeatureCheck& check) {
+
+  // Random basis of 24 components
+  AKAZEOptions options;
+  options.descriptor = MSURF;
+
+  const string pca_path = temporary_path("akaze_conformance_pca.yml");
+  cv::Mat projection(24, 64, CV_32F), bias(1, 24, CV_32F);
+  ctx.rng.fill(projection, cv::RNG::UNIFORM, -0.5, 0.5);
+  ctx.rng.fill(bias, cv::RNG::UNIFORM, -0.5, 0.5);
+
+  if (write_pca_basis(pca_path, projection, bias) == false) {
+    cerr << "Error: cannot write the PCA basis: " << pca_path << endl;
+    return false;
+  }
+
+  cv::Ptr<AKAZE> evolution, evolution_pca;
+  vector<cv::KeyPoint> kpts, kpts_pca, kpts_det;
+  cv::Mat desc, desc_pca;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution, &kpts) == false) {
+    std::remove(pca_path.c_str());
+    return false;
+  }
+  kpts_pca = kpts;
+  evolution->Compute_Descriptors(kpts, desc);
+
+  options.pca_basis = pca_path;
+  const bool created = create_engine(options, ctx.test, ctx.img, evolution_pca, &kpts_det);
+  std::remove(pca_path.c_str());
+  if (created == false)
+    return false;
+  evolution_pca->Compute_Descriptors(kpts_pca, desc_pca);
+
+  if (kpts.empty() == false) {
+    cv::Mat desc_ref(desc.rows, projection.rows, CV_32F);
+    for (int i = 0; i < desc.rows; i++)
+      ctx.ref.pca_projection(desc.ptr<float>(i), projection.ptr<float>(), bias.ptr<float>(),
+                             projection.rows, desc_ref.ptr<float>(i));
+    compare_images(desc_ref, desc_pca, ctx.tol, check.error);
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_secondary_orientations(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The keypoints with their main orientation must keep their descriptors, and every
+  // copy must follow its keypoint with another orientation
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution, evolution_orient;
+  vector<cv::KeyPoint> kpts, kpts_orient, kpts_det;
+  cv::Mat desc, desc_orient;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution, &kpts) == false)
+    return false;
+  kpts_orient = kpts;
+  evolution->Compute_Descriptors(kpts, desc);
+
+  options.orientation_ratio = 0.8f;
+  if (create_engine(options, ctx.test, ctx.img, evolution_orient, &kpts_det) == false)
+    return false;
+  evolution_orient->Compute_Descriptors(kpts_orient, desc_orient);
+
+  check.nvalues += kpts.size();
+  size_t j = 0;
+  for (size_t i = 0; i < kpts.size(); i++, j++) {
+    if (j >= kpts_orient.size() || kpts_orient[j].pt != kpts[i].pt || kpts_orient[j].angle != kpts[i].angle ||
+        hamming_distance(desc.ptr<unsigned char>(i), desc_orient.ptr<unsigned char>(j), desc.cols) > 0) {
+      check.ndiff++;
+      continue;
+    }
+
+    while (j+1 < kpts_orient.size() && kpts_orient[j+1].pt == kpts[i].pt &&
+           kpts_orient[j+1].class_id == kpts[i].class_id && (i+1 == kpts.size() || kpts[i+1].pt != kpts[i].pt)) {
+      j++;
+      if (kpts_orient[j].angle == kpts[i].angle)
+        check.ndiff++;
+    }
+  }
+
+  if (j != kpts_orient.size())
+    check.ndiff++;
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_bit_selection_table(const CheckContext& ctx, FeatureCheck& check) {
+
+  // Every third bit of the full length descriptor as the table
+  AKAZEOptions options;
+
+  const string bits_path = temporary_path("akaze_conformance_bits.yml");
+  const int nfull = (6+36+120)*options.descriptor_channels;
+  vector<int> bits;
+  for (int b = nfull-1; b >= 0; b -= 3)
+    bits.push_back(b);
+
+  if (write_descriptor_bits(bits_path, bits, options.descriptor_channels,
+                            options.descriptor_pattern_size) == false) {
+    cerr << "Error: cannot write the bit selection table: " << bits_path << endl;
+    return false;
+  }
+
+  cv::Ptr<AKAZE> evolution_full, evolution_table;
+  vector<cv::KeyPoint> kpts_full, kpts_table, kpts_det;
+  cv::Mat desc_full, desc_table;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_full, &kpts_full) == false) {
+    std::remove(bits_path.c_str());
+    return false;
+  }
+  kpts_table = kpts_full;
+  evolution_full->Compute_Descriptors(kpts_full, desc_full);
+
+  options.descriptor_size = (int)bits.size();
+  options.descriptor_bits = bits_path;
+  const bool created = create_engine(options, ctx.test, ctx.img, evolution_table, &kpts_det);
+  std::remove(bits_path.c_str());
+  if (created == false)
+    return false;
+  evolution_table->Compute_Descriptors(kpts_table, desc_table);
+
+  for (size_t i = 0; i < kpts_full.size(); i++) {
+    const unsigned char* full = desc_full.ptr<unsigned char>(i);
+    const unsigned char* sub = desc_table.ptr<unsigned char>(i);
+    for (size_t k = 0; k < bits.size(); k++) {
+      const int fb = (full[bits[k] >> 3] >> (bits[k] & 7)) & 1;
+      const int sb = (sub[k >> 3] >> (k & 7)) & 1;
+      check.ndiff += (fb != sb);
+    }
+    check.nvalues += bits.size();
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_sparse_derivatives(const CheckContext& ctx, FeatureCheck& check) {
+
+  // After the detection in half precision storage and with the fixed point engine, and for
+  // external keypoints. The last two cases compute the descriptors of other keypoints first,
+  // so that the second call finds some tiles already computed and has to compute the rest
+  for (int d = 0; d < 5; d++) {
+
+    const bool fixed = (d == 1 || d == 3), external = (d == 2 || d == 4), twice = (d >= 3);
+
+    AKAZEOptions options;
+    options.storage = (d == 0 ? STORAGE_FP16 : STORAGE_FP32);
+    options.engine = (fixed ? ENGINE_FIXED : ENGINE_FLOAT);
+
+    cv::Ptr<AKAZE> evolution_dense, evolution_sparse;
+    vector<cv::KeyPoint> kpts_dense, kpts_sparse, kpts_first;
+    cv::Mat desc_dense, desc_sparse, desc_first;
+
+    if (create_engine(options, ctx.test, ctx.img, evolution_dense, &kpts_dense) == false)
+      return false;
+    options.sparse_derivatives = true;
+    if (create_engine(options, ctx.test, ctx.img, evolution_sparse) == false)
+      return false;
+
+    if (external == false) {
+      evolution_sparse->Feature_Detection(kpts_sparse);
+      if (twice == true) {
+        // Only a few keypoints, so that the tiles are used, and the first ones elsewhere
+        const size_t n = min(kpts_sparse.size()/2, (size_t)4);
+        kpts_first.assign(kpts_sparse.begin(), kpts_sparse.begin()+n);
+        kpts_sparse.assign(kpts_sparse.end()-n, kpts_sparse.end());
+        kpts_dense.assign(kpts_dense.end()-min(n, kpts_dense.size()), kpts_dense.end());
+        evolution_sparse->Compute_Descriptors(kpts_first, desc_first);
+      }
+      evolution_dense->Compute_Descriptors(kpts_dense, desc_dense);
+      evolution_sparse->Compute_Descriptors(kpts_sparse, desc_sparse);
+    }
+    else {
+      // Only a few keypoints, so that the tiles are used
+      if (twice == true) {
+        const size_t n = min(kpts_dense.size()/2, (size_t)4);
+        kpts_first.assign(kpts_dense.begin(), kpts_dense.begin()+n);
+        kpts_dense.assign(kpts_dense.end()-n, kpts_dense.end());
+      }
+      else {
+        kpts_dense.resize(min(kpts_dense.size(), (size_t)4));
+      }
+      kpts_sparse = kpts_dense;
+      if (twice == true)
+        evolution_sparse->Compute_External_Descriptors(kpts_first, desc_first);
+      evolution_dense->Compute_External_Descriptors(kpts_dense, desc_dense);
+      evolution_sparse->Compute_External_Descriptors(kpts_sparse, desc_sparse);
+    }
+
+    check.nvalues += kpts_dense.size();
+    if (kpts_sparse.size() != kpts_dense.size()) {
+      check.ndiff += max(kpts_sparse.size(), kpts_dense.size());
+    }
+    else {
+      for (int i = 0; i < desc_dense.rows; i++) {
+        if (hamming_distance(desc_dense.ptr<unsigned char>(i), desc_sparse.ptr<unsigned char>(i), desc_dense.cols) > 0)
+          check.ndiff++;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_sparse_detector(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The sparse detector only skips tiles without keypoints. The filters of the tiles may
+  // round differently from those of the whole levels
+  AKAZEOptions options;
+  cv::Ptr<AKAZE> evolution_dense, evolution_sparse;
+  vector<cv::KeyPoint> kpts_dense, kpts_sparse;
+
+  if (create_engine(options, ctx.test, ctx.img, evolution_dense, &kpts_dense) == false)
+    return false;
+  options.sparse_detector = true;
+  if (create_engine(options, ctx.test, ctx.img, evolution_sparse, &kpts_sparse) == false)
+    return false;
+
+  const size_t nkpts = max(kpts_dense.size(), kpts_sparse.size());
+  check.nvalues += nkpts;
+  check.ndiff += nkpts - matched_keypoints(kpts_dense, kpts_sparse);
+  return true;
+}
+
+/* ************************************************************************* */
+bool check_descriptor_plane(const CheckContext& ctx, FeatureCheck& check) {
+
+  // The random bit selection reads the plane too, and the tiles of the sparse derivatives
+  // are packed. The last case packs the tiles of external keypoints in two calls on
+  // disjoint keypoints
+  for (int d = 0; d < 4; d++) {
+
+    AKAZEOptions options;
+    options.descriptor = (d == 2 ? MSURF : MLDB);
+    options.descriptor_size = (d == 1 ? 256 : 0);
+    options.sparse_derivatives = (d == 1 || d == 3);
+
+    cv::Ptr<AKAZE> evolution_float, evolution_plane;
+    vector<cv::KeyPoint> kpts_float, kpts_plane;
+    cv::Mat desc_float, desc_plane;
+
+    if (create_engine(options, ctx.test, ctx.img, evolution_float, &kpts_float) == false)
+      return false;
+    options.descriptor_plane = true;
+    if (create_engine(options, ctx.test, ctx.img, evolution_plane) == false)
+      return false;
+
+    if (d < 3) {
+      evolution_float->Compute_Descriptors(kpts_float, desc_float);
+      evolution_plane->Feature_Detection(kpts_plane);
+      evolution_plane->Compute_Descriptors(kpts_plane, desc_plane);
+    }
+    else {
+      const size_t n = min(kpts_float.size()/2, (size_t)4);
+      vector<cv::KeyPoint> kpts_first(kpts_float.begin(), kpts_float.begin()+n);
+      cv::Mat desc_first;
+      kpts_float.assign(kpts_float.end()-n, kpts_float.end());
+      kpts_plane = kpts_float;
+      evolution_plane->Compute_External_Descriptors(kpts_first, desc_first);
+      evolution_plane->Compute_External_Descriptors(kpts_plane, desc_plane);
+      evolution_float->Compute_External_Descriptors(kpts_float, desc_float);
+    }
+
+    check.nvalues += kpts_float.size();
+    if (kpts_plane.size() != kpts_float.size()) {
+      check.ndiff += max(kpts_plane.size(), kpts_float.size());
+      continue;
+    }
+
+    for (int i = 0; i < desc_float.rows; i++) {
+      if (desc_float.type() == CV_32F) {
+        if (cv::norm(desc_float.row(i), desc_plane.row(i), cv::NORM_INF) > 1e-5)
+          check.ndiff++;
+      }
+      else if (hamming_distance(desc_float.ptr<unsigned char>(i), desc_plane.ptr<unsigned char>(i), desc_float.cols) > 0) {
+        check.ndiff++;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* ************************************************************************* */
+void create_random_image(cv::RNG& rng, int min_size, int max_size, cv::Mat& img) {
+
+  int width = rng.uniform(min_size, max_size+1);
+  int height = rng.uniform(min_size, max_size+1);
+
+  // Smooth background
+  cv::Mat noise(height, width, CV_32F);
+  rng.fill(noise, cv::RNG::UNIFORM, 0.0, 1.0);
+  cv::GaussianBlur(noise, img, cv::Size(0,0), rng.uniform(2.0, 8.0));
+  cv::normalize(img, img, 0.2, 0.8, cv::NORM_MINMAX);
+
+  // Blobs and corners
+  int nshapes = rng.uniform(10, 60);
+  for (int i = 0; i < nshapes; i++) {
+    cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+    int radius = rng.uniform(2, max(3, min(width, height)/8));
+    double value = rng.uniform(0.0, 1.0);
+
+    if (rng.uniform(0, 2) == 0) {
+      cv::circle(img, center, radius, cv::Scalar(value), -1);
+    }
+    else {
+      cv::Point corner(center.x + rng.uniform(-radius, radius+1), center.y + rng.uniform(-radius, radius+1));
+      cv::rectangle(img, center, corner, cv::Scalar(value), -1);
+    }
+  }
+
+  // Fine noise
+  cv::Mat fine(height, width, CV_32F);
+  rng.fill(fine, cv::RNG::NORMAL, 0.0, 0.02);
+  img += fine;
+}
+
+/* ************************************************************************* */
+long long ulp_distance(float a, float b) {
+
+  if (a == b)
+    return 0;
+
+  if (a != a || b != b)
+    return numeric_limits<long long>::max();
+
+  int ia = 0, ib = 0;
+  memcpy(&ia, &a, sizeof(float));
+  memcpy(&ib, &b, sizeof(float));
+
+  // Map the sign-magnitude representation into a monotonic one
+  long long la = (ia < 0 ? (long long)INT_MIN - ia : ia);
+  long long lb = (ib < 0 ? (long long)INT_MIN - ib : ib);
+
+  return (la > lb ? la - lb : lb - la);
+}
+
+/* ************************************************************************* */
+void compare_images(const cv::Mat& ref, const cv::Mat& test,
+                    const ConformanceTolerances& tol, StageError& error) {
+
+  CV_Assert(ref.size() == test.size() && ref.type() == CV_32F && test.type() == CV_32F);
+
+  for (int y = 0; y < ref.rows; y++) {
+    const float* ref_row = ref.ptr<float>(y);
+    const float* test_row = test.ptr<float>(y);
+
+    for (int x = 0; x < ref.cols; x++) {
+      double abs_error = fabs((double)ref_row[x] - (double)test_row[x]);
+      long long ulp = ulp_distance(ref_row[x], test_row[x]);
+
+      if (abs_error > error.max_abs)
+        error.max_abs = abs_error;
+
+      if (ulp > error.max_ulp)
+        error.max_ulp = ulp;
+
+      if (ulp > tol.max_ulp && !(abs_error <= tol.max_abs))
+        error.nfailures++;
+    }
+  }
+
+  error.nvalues += ref.rows*ref.cols;
+}
+
+/* ************************************************************************* */
+void compare_fixed_images(const cv::Mat& ref, const cv::Mat& test, StageError& error) {
+
+  CV_Assert(ref.size() == test.size() && ref.type() == CV_16S && test.type() == CV_16S);
+
+  for (int y = 0; y < ref.rows; y++) {
+    const short* ref_row = ref.ptr<short>(y);
+    const short* test_row = test.ptr<short>(y);
+
+    for (int x = 0; x < ref.cols; x++) {
+      int abs_error = abs((int)ref_row[x] - (int)test_row[x]);
+
+      if (abs_error > error.max_abs)
+        error.max_abs = abs_error;
+
+      if (abs_error > error.max_ulp)
+        error.max_ulp = abs_error;
+
+      if (abs_error != 0)
+        error.nfailures++;
+    }
+  }
+
+  error.nvalues += ref.rows*ref.cols;
+}
+
+/* ************************************************************************* */
+std::string temporary_path(const std::string& name) {
+
+  const char* vars[] = {"TMPDIR", "TMP", "TEMP"};
+  for (int k = 0; k < 3; k++) {
+    const char* dir = getenv(vars[k]);
+    if (dir != NULL && *dir != '\0')
+      return string(dir) + "/" + name;
+  }
+
+#ifdef _WIN32
+  return name;
+#else
+  return "/tmp/" + name;
+#endif
+}
+
+/* ************************************************************************* */
+cv::Mat decode_half(const AKAZEKernels& kernels, const cv::Mat& half) {
+
+  cv::Mat img(half.rows, half.cols, CV_32F);
+  for (int y = 0; y < half.rows; y++)
+    kernels.convert_from_half(half.ptr<unsigned short>(y), img.ptr<float>(y), half.cols);
+
+  return img;
+}
+
+/* ************************************************************************* */
+int hamming_distance(const unsigned char* a, const unsigned char* b, int nbytes) {
+
+  int dist = 0;
+  for (int i = 0; i < nbytes; i++) {
+    unsigned char v = a[i] ^ b[i];
+    for (; v; v &= v-1)
+      dist++;
+  }
+
+  return dist;
+}
+
+/* ************************************************************************* */
+void show_conformance_help() {
+
+  cout << "A-KAZE Features" << endl;
+  cout << "Usage: ./akaze_conformance [options]" << endl << endl;
+  cout << "Checks the kernels of the library supported by the CPU against the scalar reference kernels" << endl << endl;
+  cout << left;
+  cout << setw(18) << "--help" << "Show the command line options" << endl;
+  cout << setw(18) << "--verbose" << "Show the differences of every image" << endl;
+  cout << setw(18) << "--kernels" << "Check only the given kernels: baseline, avx2, avx512 or avx512vnni" << endl;
+  cout << setw(18) << "--nimages" << "Number of random images (20 by default)" << endl;
+  cout << setw(18) << "--min_size" << "Minimum width and height of the images (64 by default)" << endl;
+  cout << setw(18) << "--max_size" << "Maximum width and height of the images (640 by default)" << endl;
+  cout << setw(18) << "--seed" << "Seed of the random number generator (0 by default)" << endl;
+  cout << setw(18) << "--max_ulp" << "Maximum error in ULPs of every value (4 by default)" << endl;
+  cout << setw(18) << "--max_abs" << "Maximum absolute error of every value. Values within --max_ulp or --max_abs pass (1e-5 by default)" << endl;
+  cout << setw(18) << "--max_kpts_diff" << "Maximum percentage of keypoints not found by both kernels (1 by default)" << endl;
+  cout << setw(18) << "--max_bitflip" << "Maximum percentage of different descriptor bits (1 by default)" << endl;
+  cout << setw(18) << "--max_fixed_bitflip" << "Maximum M-LDB bit error rate (%) of the fixed point engine against the float engine (5 by default)" << endl;
+  cout << endl;
+}
+
+/* ************************************************************************* */
+int parse_input_options(ConformanceTolerances& tol, int& nimages, int& min_size,
+                        int& max_size, int& seed, bool& verbose, std::string& kernels_name,
+                        int argc, char *argv[]) {
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"--help")) {
+      show_conformance_help();
+      return -1;
+    }
+    else if (!strcmp(argv[i],"--verbose")) {
+      verbose = true;
+    }
+    else if (!strcmp(argv[i],"--kernels")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        kernels_name = argv[i];
+      }
+    }
+    else if (!strcmp(argv[i],"--nimages")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        nimages = atoi(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--min_size")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        min_size = max(atoi(argv[i]), 16);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_size")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        max_size = atoi(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--seed")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        seed = atoi(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_ulp")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        tol.max_ulp = atoll(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_abs")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        tol.max_abs = atof(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_kpts_diff")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        tol.max_kpts_diff = atof(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_bitflip")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        tol.max_bitflip = atof(argv[i]);
+      }
+    }
+    else if (!strcmp(argv[i],"--max_fixed_bitflip")) {
+      i = i+1;
+      if (i >= argc) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        tol.max_fixed_bitflip = atof(argv[i]);
+      }
+    }
+    else {
+      cerr << "Error introducing input options!!" << endl;
+      return -1;
+    }
+  }
+
+  if (max_size < min_size)
+    max_size = min_size;
+
+  return 0;
+}
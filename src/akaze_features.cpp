@@ -57,8 +57,9 @@ int main(int argc, char *argv[]) {
     cout << options << endl;
   }
 
-  // Try to read the image and if necessary convert to grayscale.
-  cv::Mat img = cv::imread(img_path.c_str(), 0);
+  // Try to read the image and if necessary convert to grayscale. For omin > 0 the
+  // image is decoded directly at the resolution of the initial octave
+  cv::Mat img = read_image(img_path, options.omin);
   if (img.data == NULL) {
     cerr << "Error: cannot load image from file:" << endl << img_path << endl;
     return -1;
@@ -82,11 +83,12 @@ int main(int argc, char *argv[]) {
   t2 = cv::getTickCount();
   tdet = 1000.0*(t2-t1) / cv::getTickFrequency();
 
-  // Compute descriptors.
-  cv::Mat desc;
+  // Compute descriptors, with the extra descriptors in the same pass. The first one is saved
+  vector<cv::Mat> descs;
   t1 = cv::getTickCount();
-  evolution.Compute_Descriptors(kpts, desc);
+  evolution.Compute_Descriptors(kpts, descs);
   t2 = cv::getTickCount();
+  cv::Mat desc = descs[0];
   tdesc = 1000.0*(t2-t1) / cv::getTickFrequency();
 
   if (options.show_results == true) {
@@ -98,6 +100,10 @@ int main(int argc, char *argv[]) {
     cout << "Time Detector: " << tdet << " ms" << endl;
     cout << "Time Descriptor: " << tdesc << " ms" << endl;
 
+    // The keypoints are in pixels of the original image
+    if (options.omin > 0)
+      img = cv::imread(img_path.c_str(), 0);
+
     cv::Mat img_rgb = cv::Mat(cv::Size(img.cols, img.rows), CV_8UC3);
     cvtColor(img,img_rgb, cv::COLOR_GRAY2BGR);
     draw_keypoints(img_rgb, kpts);
@@ -134,7 +140,18 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path,
     img_path = argv[1];
 
     for (int i = 2; i < argc; i++) {
-      if (!strcmp(argv[i],"--soffset")) {
+      if (!strcmp(argv[i],"--options")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else if (!read_akaze_options(argv[i], options)) {
+          cerr << "Error: cannot load the options from file:" << endl << argv[i] << endl;
+          return -1;
+        }
+      }
+      else if (!strcmp(argv[i],"--soffset")) {
         i = i+1;
         if (i >= argc) {
           cerr << "Error introducing input options!!" << endl;
@@ -144,6 +161,20 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path,
           options.soffset = atof(argv[i]);
         }
       }
+      else if (!strcmp(argv[i],"--omin")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.omin = atoi(argv[i]);
+          if (options.omin < 0 || options.omin > 2) {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
       else if (!strcmp(argv[i],"--omax")) {
         i = i+1;
         if ( i >= argc ) {
@@ -254,6 +285,192 @@ int parse_input_options(AKAZEOptions& options, std::string& img_path,
           options.show_results = (bool)atoi(argv[i]);
         }
       }
+      else if (!strcmp(argv[i],"--pin_threads")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pin_threads = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--first_touch")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.first_touch = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pipeline")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pipeline = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--wavefront")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.wavefront = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_derivatives")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_derivatives = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--sparse_detector")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.sparse_detector = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_plane")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_plane = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--mldb_angle_bins")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.mldb_angle_bins = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--extra_descriptors")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.extra_descriptors = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_bits")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_bits = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_padding")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_padding = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_int8")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_int8 = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pca_basis")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.pca_basis = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--orientation_ratio")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.orientation_ratio = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--huge_pages")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.huge_pages = (bool)atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--storage")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int storage = atoi(argv[i]);
+          if (storage == 0)
+            options.storage = STORAGE_FP32;
+          else if (storage == 1)
+            options.storage = STORAGE_FP16;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--engine")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          int engine = atoi(argv[i]);
+          if (engine == 0)
+            options.engine = ENGINE_FLOAT;
+          else if (engine == 1)
+            options.engine = ENGINE_FIXED;
+          else {
+            cerr << "Error introducing input options!!" << endl;
+            return -1;
+          }
+        }
+      }
       else if (!strcmp(argv[i],"--verbose")) {
         options.verbosity = true;
       }
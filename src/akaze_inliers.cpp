@@ -67,15 +67,16 @@ int main(int argc, char *argv[]) {
     if (parse_input_options(options, img_path1, img_path2, inliers_path, argc, argv))
         return -1;
 
-    // Read image 1 and if necessary convert to grayscale.
-    img1 = cv::imread(img_path1, 0);
+    // Read image 1 and if necessary convert to grayscale. For omin > 0 the
+    // images are decoded directly at the resolution of the initial octave
+    img1 = read_image(img_path1, options.omin);
     if (img1.data == NULL) {
         cerr << "Error loading image 1: " << img_path1 << endl;
         return -1;
     }
 
     // Read image 2 and if necessary convert to grayscale.
-    img2 = cv::imread(img_path2, 0);
+    img2 = read_image(img_path2, options.omin);
     if (img2.data == NULL) {
         cerr << "Error loading image 2: " << img_path2 << endl;
         return -1;
@@ -114,8 +115,12 @@ int main(int argc, char *argv[]) {
     cv::Ptr<cv::DescriptorMatcher> matcher_l2 = cv::DescriptorMatcher::create("BruteForce");
     cv::Ptr<cv::DescriptorMatcher> matcher_l1 = cv::DescriptorMatcher::create("BruteForce-Hamming");
 
-    if (options.descriptor < MLDB_UPRIGHT)
+    if (options.descriptor < MLDB_UPRIGHT && options.descriptor_int8 == true && options.pca_basis.empty())
+        match_int8_descriptors(desc1, desc2, dmatches);
+    else if (options.descriptor < MLDB_UPRIGHT)
         matcher_l2->knnMatch(desc1, desc2, dmatches, 2);
+    else if (options.descriptor_padding == true)
+        match_binary_descriptors(desc1, desc2, dmatches);
     else
         matcher_l1->knnMatch(desc1, desc2, dmatches, 2);
 
@@ -201,7 +206,16 @@ int parse_input_options(AKAZEOptions &options, std::string &img_path1, std::stri
         img_path2 = argv[2];
 
         for (int i = 3; i < argc; i++) {
-            if (!strcmp(argv[i], "--soffset")) {
+            if (!strcmp(argv[i], "--options")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else if (!read_akaze_options(argv[i], options)) {
+                    cerr << "Error: cannot load the options from file:" << endl << argv[i] << endl;
+                    return -1;
+                }
+            } else if (!strcmp(argv[i], "--soffset")) {
                 i = i + 1;
                 if (i >= argc) {
                     cerr << "Error introducing input options!!" << endl;
@@ -209,6 +223,18 @@ int parse_input_options(AKAZEOptions &options, std::string &img_path1, std::stri
                 } else {
                     options.soffset = atof(argv[i]);
                 }
+            } else if (!strcmp(argv[i], "--omin")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.omin = atoi(argv[i]);
+                    if (options.omin < 0 || options.omin > 2) {
+                        cerr << "Error introducing input options!!" << endl;
+                        return -1;
+                    }
+                }
             } else if (!strcmp(argv[i], "--omax")) {
                 i = i + 1;
                 if (i >= argc) {
@@ -293,6 +319,158 @@ int parse_input_options(AKAZEOptions &options, std::string &img_path1, std::stri
                 } else {
                     options.show_results = (bool) atoi(argv[i]);
                 }
+            } else if (!strcmp(argv[i], "--pin_threads")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.pin_threads = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--first_touch")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.first_touch = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--pipeline")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.pipeline = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--wavefront")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.wavefront = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--sparse_derivatives")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.sparse_derivatives = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--sparse_detector")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.sparse_detector = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--descriptor_plane")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.descriptor_plane = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--mldb_angle_bins")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.mldb_angle_bins = atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--extra_descriptors")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.extra_descriptors = atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--descriptor_bits")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.descriptor_bits = argv[i];
+                }
+            } else if (!strcmp(argv[i], "--descriptor_padding")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.descriptor_padding = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--descriptor_int8")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.descriptor_int8 = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--pca_basis")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.pca_basis = argv[i];
+                }
+            } else if (!strcmp(argv[i], "--orientation_ratio")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.orientation_ratio = atof(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--huge_pages")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    options.huge_pages = (bool) atoi(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "--storage")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    int storage = atoi(argv[i]);
+                    if (storage == 0) {
+                        options.storage = STORAGE_FP32;
+                    } else if (storage == 1) {
+                        options.storage = STORAGE_FP16;
+                    } else {
+                        cerr << "Error introducing input options!!" << endl;
+                        return -1;
+                    }
+                }
+            } else if (!strcmp(argv[i], "--engine")) {
+                i = i + 1;
+                if (i >= argc) {
+                    cerr << "Error introducing input options!!" << endl;
+                    return -1;
+                } else {
+                    int engine = atoi(argv[i]);
+                    if (engine == 0) {
+                        options.engine = ENGINE_FLOAT;
+                    } else if (engine == 1) {
+                        options.engine = ENGINE_FIXED;
+                    } else {
+                        cerr << "Error introducing input options!!" << endl;
+                        return -1;
+                    }
+                }
             } else if (!strcmp(argv[i], "--verbose")) {
                 options.verbosity = true;
             } else if (!strcmp(argv[i],"--output")) {
@@ -0,0 +1,381 @@
+//=============================================================================
+//
+// akaze_train.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file akaze_train.cpp
+ * @brief Main program for training the bit selection table of the M-LDB descriptors
+ * with descriptor_size > 0 on the full length descriptors of a set of images, or the
+ * PCA basis of the SURF and M-SURF descriptors
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "./lib/AKAZE.h"
+
+// OpenCV
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+// System
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+/* ************************************************************************* */
+/**
+ * @brief This function parses the command line arguments for setting the training options
+ * @param options Structure that contains the A-KAZE settings of the trained descriptor
+ * @param image_paths Paths of the training images
+ * @param output_path Path for the output bit selection table or PCA basis
+ * @param nbits Number of bits of the table
+ * @param ncomponents Number of components of the PCA basis
+ * @param whiten Set to true for whitening the components of the PCA basis
+ */
+int parse_input_options(AKAZEOptions& options, std::vector<std::string>& image_paths,
+                        std::string& output_path, int& nbits, int& ncomponents, bool& whiten,
+                        int argc, char *argv[]);
+
+/// This function selects nbits bits of the full length descriptors with a greedy search.
+/// The bits are visited by decreasing variance, and a bit is kept when its correlation
+/// with every kept bit is below a threshold, which is raised until nbits bits are kept
+/// @param desc Full length descriptors of the training set, one per row
+/// @param nfull Number of bits of the full length descriptor
+/// @param nbits Number of bits to select
+/// @param bits Indices of the selected bits, in order of selection
+/// @param threshold Correlation threshold reached by the search
+void select_descriptor_bits(const cv::Mat& desc, int nfull, int nbits,
+                            std::vector<int>& bits, double& threshold);
+
+/* ************************************************************************* */
+int main(int argc, char *argv[]) {
+
+  // Variables
+  AKAZEOptions options;
+  vector<string> image_paths;
+  string output_path;
+  int nbits = 256, ncomponents = 32;
+  bool whiten = false;
+
+  // Parse the input command line options
+  if (parse_input_options(options, image_paths, output_path, nbits, ncomponents, whiten, argc, argv))
+    return -1;
+
+  // The table selects bits of the full length descriptor, and the basis projects the 64 values
+  const bool pca = (options.descriptor < MLDB_UPRIGHT);
+  options.descriptor_size = 0;
+  options.descriptor_int8 = false;
+  options.pca_basis = "";
+  const int nfull = (6+36+120)*options.descriptor_channels;
+
+  if (output_path.empty())
+    output_path = (pca ? "./akaze_pca.yml" : "./akaze_bits.yml");
+
+  if (pca == false && (nbits < 1 || nbits > nfull)) {
+    cerr << "Error: the table must have between 1 and " << nfull << " bits!!" << endl;
+    return -1;
+  }
+  else if (pca == true && (ncomponents < 1 || ncomponents > 64)) {
+    cerr << "Error: the PCA basis must have between 1 and 64 components!!" << endl;
+    return -1;
+  }
+
+  // Descriptors of the training images
+  cv::Mat desc_all;
+
+  for (size_t i = 0; i < image_paths.size(); i++) {
+    cv::Mat img = read_image(image_paths[i], options.omin);
+    if (img.data == NULL) {
+      cerr << "Error: cannot load image from file:" << endl << image_paths[i] << endl;
+      return -1;
+    }
+
+    cv::Mat img_32;
+    img.convertTo(img_32, CV_32F, 1.0/255.0, 0);
+
+    options.img_width = img.cols;
+    options.img_height = img.rows;
+    libAKAZE::AKAZE evolution(options);
+
+    vector<cv::KeyPoint> kpts;
+    cv::Mat desc;
+    evolution.Create_Nonlinear_Scale_Space(img_32);
+    evolution.Feature_Detection(kpts);
+    evolution.Compute_Descriptors(kpts, desc);
+
+    if (options.verbosity)
+      cout << image_paths[i] << ": " << desc.rows << " descriptors" << endl;
+
+    desc_all.push_back(desc);
+  }
+
+  if (desc_all.rows < 2) {
+    cerr << "Error: the training images do not have enough keypoints!!" << endl;
+    return -1;
+  }
+
+  if (pca == true) {
+    cv::Mat projection, bias;
+    compute_pca_basis(desc_all, ncomponents, whiten, projection, bias);
+
+    cout << "Number of training descriptors: " << desc_all.rows << endl;
+    cout << "Number of components: " << projection.rows << (whiten ? ", whitened" : "") << endl;
+
+    if (write_pca_basis(output_path, projection, bias) == false) {
+      cerr << "Error: cannot write the PCA basis:" << endl << output_path << endl;
+      return -1;
+    }
+
+    cout << endl << "PCA basis saved in: " << output_path << endl;
+    cout << "Use it with: --descriptor " << options.descriptor << " --pca_basis " << output_path << endl;
+    return 0;
+  }
+
+  vector<int> bits;
+  double threshold = 0.0;
+  select_descriptor_bits(desc_all, nfull, nbits, bits, threshold);
+
+  cout << "Number of training descriptors: " << desc_all.rows << endl;
+  cout << "Number of selected bits: " << bits.size() << " of " << nfull << endl;
+  cout << "Correlation threshold of the selected bits: " << threshold << endl;
+
+  if (write_descriptor_bits(output_path, bits, options.descriptor_channels,
+                            options.descriptor_pattern_size) == false) {
+    cerr << "Error: cannot write the bit selection table:" << endl << output_path << endl;
+    return -1;
+  }
+
+  cout << endl << "Bit selection table saved in: " << output_path << endl;
+  cout << "Use it with: --descriptor_size N --descriptor_bits " << output_path
+       << " (N <= " << nbits << ")" << endl;
+
+  return 0;
+}
+
+/* ************************************************************************* */
+/// Number of bits set in a 64 bit word
+static inline int count_bits(uint64_t v) {
+
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((v * 0x0101010101010101ULL) >> 56);
+}
+
+/* ************************************************************************* */
+void select_descriptor_bits(const cv::Mat& desc, int nfull, int nbits,
+                            std::vector<int>& bits, double& threshold) {
+
+  const int n = desc.rows;
+  const int nwords = (n+63)/64;
+
+  // Every bit of the descriptor as a column of n bits
+  vector<vector<uint64_t> > columns(nfull, vector<uint64_t>(nwords, 0));
+  for (int r = 0; r < n; r++) {
+    const unsigned char* d = desc.ptr<unsigned char>(r);
+    for (int b = 0; b < nfull; b++) {
+      if (d[b >> 3] & (1 << (b & 7)))
+        columns[b][r >> 6] |= (uint64_t)1 << (r & 63);
+    }
+  }
+
+  vector<double> mean(nfull, 0.0);
+  vector<pair<double, int> > order(nfull);
+  for (int b = 0; b < nfull; b++) {
+    int ones = 0;
+    for (int w = 0; w < nwords; w++)
+      ones += count_bits(columns[b][w]);
+    mean[b] = ones/(double)n;
+    order[b] = make_pair(fabs(mean[b]-0.5), b);
+  }
+
+  // Largest variance first, i.e. closest to one half
+  sort(order.begin(), order.end());
+
+  bits.clear();
+  vector<char> selected(nfull, 0);
+  bits.push_back(order[0].second);
+  selected[order[0].second] = 1;
+
+  // Every bit is kept in the last pass, with a threshold of 1
+  for (int pass = 0; (int)bits.size() < nbits; pass++) {
+    threshold = min(0.2 + 0.05*pass, 1.0);
+    const bool last = (threshold >= 1.0);
+
+    for (int k = 1; k < nfull && (int)bits.size() < nbits; k++) {
+      const int b = order[k].second;
+      if (selected[b] != 0)
+        continue;
+
+      const double var_b = mean[b]*(1.0-mean[b]);
+      bool keep = (var_b > 0.0 || last);
+
+      for (size_t s = 0; s < bits.size() && keep && !last; s++) {
+        const int a = bits[s];
+        const double var_a = mean[a]*(1.0-mean[a]);
+        if (var_a <= 0.0)
+          continue;
+
+        int both = 0;
+        for (int w = 0; w < nwords; w++)
+          both += count_bits(columns[a][w] & columns[b][w]);
+
+        double corr = (both/(double)n - mean[a]*mean[b])/sqrt(var_a*var_b);
+        if (fabs(corr) >= threshold)
+          keep = false;
+      }
+
+      if (keep) {
+        bits.push_back(b);
+        selected[b] = 1;
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+int parse_input_options(AKAZEOptions& options, std::vector<std::string>& image_paths,
+                        std::string& output_path, int& nbits, int& ncomponents, bool& whiten,
+                        int argc, char *argv[]) {
+
+  // If there is only one argument return
+  if (argc == 1) {
+    show_input_options_help(5);
+    return -1;
+  }
+  // Set the options from the command line
+  else if (argc >= 2) {
+
+    // Load the default options
+    options = AKAZEOptions();
+    output_path = "";
+
+    if (!strcmp(argv[1],"--help")) {
+      show_input_options_help(5);
+      return -1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i],"--options")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else if (!read_akaze_options(argv[i], options)) {
+          cerr << "Error: cannot load the options from file:" << endl << argv[i] << endl;
+          return -1;
+        }
+      }
+      else if (!strcmp(argv[i],"--nbits")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          nbits = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--pca")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          ncomponents = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--whiten")) {
+        whiten = true;
+      }
+      else if (!strcmp(argv[i],"--output")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          output_path = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--dthreshold")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.dthreshold = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor = DESCRIPTOR_TYPE(atoi(argv[i]));
+
+          if (options.descriptor < 0 || options.descriptor > MLDB) {
+            options.descriptor = MLDB;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_channels")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_channels = atoi(argv[i]);
+
+          if (options.descriptor_channels <= 0 || options.descriptor_channels > 3) {
+            options.descriptor_channels = 3;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor_pattern_size")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor_pattern_size = atoi(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--verbose")) {
+        options.verbosity = true;
+      }
+      else if (!strncmp(argv[i],"--",2)) {
+        cerr << "Error introducing input options!!" << endl;
+        return -1;
+      }
+      else {
+        image_paths.push_back(argv[i]);
+      }
+    }
+  }
+
+  if (image_paths.empty()) {
+    cerr << "Error: no training images!!" << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,538 @@
+//=============================================================================
+//
+// akaze_tune.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file akaze_tune.cpp
+ * @brief Main program for selecting the A-KAZE options that give the best
+ * accuracy/speed trade-off on an image sequence with ground truth homographies
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "./lib/AKAZE.h"
+
+// OpenCV
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+// System
+#include <algorithm>
+
+using namespace std;
+
+/* ************************************************************************* */
+// Evaluation options
+const float MIN_H_ERROR = 2.50f;            ///< Maximum error in pixels to accept an inlier
+const float DRATIO = 0.80f;                 ///< NNDR Matching value
+const float OVERLAP_ERROR = 0.40f;          ///< Maximum overlap error to accept a correspondence
+const float PIXEL_ERROR = 5.0f;             ///< Maximum location error in pixels to accept a correspondence
+
+/* ************************************************************************* */
+/// Evaluation results of one configuration of the search space
+struct TuneResult {
+
+  TuneResult() {
+    ms = 0.0;
+    memory_mb = 0.0;
+    repeatability = 0.0;
+    inliers = 0.0;
+    npairs = 0;
+  }
+
+  AKAZEOptions options;     ///< Evaluated options
+  double ms;                ///< Mean computation time per frame in ms
+  double memory_mb;         ///< Estimated memory of the nonlinear scale space in MB
+  double repeatability;     ///< Mean repeatability (%)
+  double inliers;           ///< Mean number of inliers per image pair
+  int npairs;               ///< Number of image pairs used in the evaluation
+};
+
+/* ************************************************************************* */
+/**
+ * @brief This function parses the command line arguments for setting the tuning budgets
+ * @param options Structure that contains the fixed A-KAZE settings
+ * @param dataset_path Path for the folder with the image sequence
+ * @param output_path Path for the output options file
+ * @param budget_ms Maximum computation time per frame in ms (0 means no limit)
+ * @param budget_mb Maximum memory of the nonlinear scale space in MB (0 means no limit)
+ * @param eta Reduction factor of the successive halving
+ * @param nruns Number of times each image is processed for timing
+ */
+int parse_input_options(AKAZEOptions& options, std::string& dataset_path,
+                        std::string& output_path, float& budget_ms, float& budget_mb,
+                        int& eta, int& nruns, int argc, char *argv[]);
+
+/// This function estimates the memory in MB of the nonlinear scale space
+/// allocated by AKAZE::Allocate_Memory_Evolution for the given options
+double estimate_memory_mb(const AKAZEOptions& options);
+
+/// This function creates the search space of options
+void create_search_space(const AKAZEOptions& options, std::vector<TuneResult>& space);
+
+/// This function evaluates one configuration on the first npairs image pairs of the sequence
+void evaluate_configuration(const std::vector<cv::Mat>& images, const std::vector<cv::Mat>& H,
+                            int npairs, int nruns, TuneResult& result);
+
+/// Returns true if the result a dominates the result b. Time and memory are
+/// minimized, repeatability and number of inliers are maximized
+bool dominates(const TuneResult& a, const TuneResult& b);
+
+/// This function computes the non-dominated sorting rank of every result (0 is the Pareto frontier)
+void compute_pareto_ranks(const std::vector<TuneResult>& results, std::vector<int>& ranks);
+
+/* ************************************************************************* */
+int main(int argc, char *argv[]) {
+
+  // Variables
+  AKAZEOptions options;
+  string dataset_path, output_path;
+  vector<string> image_paths, homography_paths;
+  float budget_ms = 0.0, budget_mb = 0.0;
+  int eta = 3, nruns = 1;
+
+  // Parse the input command line options
+  if (parse_input_options(options, dataset_path, output_path, budget_ms, budget_mb,
+                          eta, nruns, argc, argv))
+    return -1;
+
+  if (read_image_sequence(dataset_path, image_paths, homography_paths) < 2) {
+    cerr << "Error: cannot find an image sequence with ground truth homographies in:" << endl;
+    cerr << dataset_path << endl;
+    return -1;
+  }
+
+  // Load the images and homographies
+  vector<cv::Mat> images(image_paths.size()), H(homography_paths.size());
+
+  for (size_t i = 0; i < image_paths.size(); i++) {
+    cv::Mat img = cv::imread(image_paths[i], 0);
+    if (img.data == NULL) {
+      cerr << "Error: cannot load image from file:" << endl << image_paths[i] << endl;
+      return -1;
+    }
+    img.convertTo(images[i], CV_32F, 1.0/255.0, 0);
+  }
+
+  for (size_t i = 0; i < homography_paths.size(); i++) {
+    if (read_homography(homography_paths[i], H[i]) == false) {
+      cerr << "Error: cannot load homography from file:" << endl << homography_paths[i] << endl;
+      return -1;
+    }
+  }
+
+  // The memory is estimated with the size of the reference image
+  options.img_width = images[0].cols;
+  options.img_height = images[0].rows;
+
+  vector<TuneResult> candidates, space;
+  create_search_space(options, space);
+
+  for (size_t i = 0; i < space.size(); i++) {
+    if (budget_mb <= 0.0 || space[i].memory_mb <= budget_mb)
+      candidates.push_back(space[i]);
+  }
+
+  cout << "Number of configurations: " << space.size() << endl;
+  cout << "Number of configurations within the memory budget: " << candidates.size() << endl;
+
+  // Successive halving. Every rung evaluates the surviving configurations on eta
+  // times more image pairs and keeps the best 1/eta of them, selected by Pareto rank
+  int max_pairs = (int)H.size();
+  int npairs = 1;
+
+  while (candidates.size() > 0) {
+
+    cout << "Evaluating " << candidates.size() << " configurations with "
+         << npairs << " image pairs" << endl;
+
+    vector<TuneResult> evaluated;
+    for (size_t i = 0; i < candidates.size(); i++) {
+      evaluate_configuration(images, H, npairs, nruns, candidates[i]);
+
+      if (options.verbosity) {
+        cout << "omax: " << candidates[i].options.omax
+             << " nsublevels: " << candidates[i].options.nsublevels
+             << " dthreshold: " << candidates[i].options.dthreshold
+             << " descriptor_size: " << candidates[i].options.descriptor_size
+             << " descriptor_channels: " << candidates[i].options.descriptor_channels
+             << " -> ms: " << candidates[i].ms
+             << " rep: " << candidates[i].repeatability
+             << " inliers: " << candidates[i].inliers << endl;
+      }
+
+      if (budget_ms <= 0.0 || candidates[i].ms <= budget_ms)
+        evaluated.push_back(candidates[i]);
+    }
+
+    candidates = evaluated;
+
+    if (npairs == max_pairs || candidates.size() <= 1)
+      break;
+
+    // Keep complete Pareto layers until 1/eta of the configurations are selected
+    vector<int> ranks;
+    compute_pareto_ranks(candidates, ranks);
+
+    size_t nkeep = (candidates.size() + eta - 1)/eta;
+    vector<TuneResult> survivors;
+    for (int r = 0; survivors.size() < nkeep; r++) {
+      for (size_t i = 0; i < candidates.size(); i++) {
+        if (ranks[i] == r)
+          survivors.push_back(candidates[i]);
+      }
+    }
+
+    candidates = survivors;
+    npairs = min(npairs*eta, max_pairs);
+  }
+
+  if (candidates.size() == 0) {
+    cerr << "Error: no configuration satisfies the time and memory budgets!!" << endl;
+    return -1;
+  }
+
+  // Pareto frontier of the last rung sorted by computation time
+  vector<int> ranks;
+  vector<TuneResult> frontier;
+  compute_pareto_ranks(candidates, ranks);
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (ranks[i] == 0)
+      frontier.push_back(candidates[i]);
+  }
+
+  for (size_t i = 0; i < frontier.size(); i++) {
+    for (size_t j = i+1; j < frontier.size(); j++) {
+      if (frontier[j].ms < frontier[i].ms)
+        swap(frontier[i], frontier[j]);
+    }
+  }
+
+  // The recommended configuration is the most repeatable one within the budgets
+  size_t best = 0;
+  for (size_t i = 1; i < frontier.size(); i++) {
+    if (frontier[i].repeatability > frontier[best].repeatability)
+      best = i;
+  }
+
+  cout << endl << "Pareto frontier (" << frontier[0].npairs << " image pairs):" << endl;
+  cout << left;
+  cout << setw(6) << "omax" << setw(12) << "nsublevels" << setw(12) << "dthreshold"
+       << setw(10) << "dsize" << setw(10) << "dchan" << setw(10) << "ms"
+       << setw(12) << "memory (MB)" << setw(10) << "Rep (%)" << setw(10) << "Inliers" << endl;
+
+  for (size_t i = 0; i < frontier.size(); i++) {
+    const AKAZEOptions& opt = frontier[i].options;
+    cout << setw(6) << opt.omax << setw(12) << opt.nsublevels << setw(12) << opt.dthreshold
+         << setw(10) << opt.descriptor_size << setw(10) << opt.descriptor_channels
+         << setw(10) << frontier[i].ms << setw(12) << frontier[i].memory_mb
+         << setw(10) << frontier[i].repeatability << setw(10) << frontier[i].inliers
+         << (i == best ? " (*)" : "") << endl;
+  }
+
+  // Save the recommended options and the whole frontier
+  cv::FileStorage fs(output_path, cv::FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    cerr << "Error: cannot write the options file:" << endl << output_path << endl;
+    return -1;
+  }
+
+  write_akaze_options(fs, frontier[best].options);
+
+  fs << "frontier" << "[";
+  for (size_t i = 0; i < frontier.size(); i++) {
+    fs << "{";
+    fs << "ms" << frontier[i].ms;
+    fs << "memory_mb" << frontier[i].memory_mb;
+    fs << "repeatability" << frontier[i].repeatability;
+    fs << "inliers" << frontier[i].inliers;
+    write_akaze_options(fs, frontier[i].options);
+    fs << "}";
+  }
+  fs << "]";
+  fs.release();
+
+  cout << endl << "Options saved in: " << output_path << endl;
+  cout << "Use them with: --options " << output_path << endl;
+
+  return 0;
+}
+
+/* ************************************************************************* */
+double estimate_memory_mb(const AKAZEOptions& options) {
+  return libAKAZE::AKAZE::Evolution_Memory_Size(options)/(1024.0*1024.0);
+}
+
+/* ************************************************************************* */
+void create_search_space(const AKAZEOptions& options, std::vector<TuneResult>& space) {
+
+  const int omax_values[] = {2, 3, 4};
+  const int nsublevels_values[] = {2, 3, 4};
+  const float dthreshold_values[] = {0.0005f, 0.001f, 0.002f, 0.004f};
+  const int size_values[] = {0, 256, 128, 64};
+  const int channels_values[] = {1, 2, 3};
+
+  // Descriptor size and channels only apply to the binary descriptor
+  bool binary = (options.descriptor >= MLDB_UPRIGHT);
+  int nsizes = (binary ? 4 : 1);
+  int nchannels = (binary ? 3 : 1);
+
+  space.clear();
+
+  for (int a = 0; a < 3; a++) {
+    for (int b = 0; b < 3; b++) {
+      for (int c = 0; c < 4; c++) {
+        for (int d = 0; d < nsizes; d++) {
+          for (int e = 0; e < nchannels; e++) {
+
+            TuneResult result;
+            result.options = options;
+            result.options.omax = omax_values[a];
+            result.options.nsublevels = nsublevels_values[b];
+            result.options.dthreshold = dthreshold_values[c];
+
+            if (binary) {
+              result.options.descriptor_size = size_values[d];
+              result.options.descriptor_channels = channels_values[e];
+
+              // The full descriptor has 162 comparisons per channel
+              if (result.options.descriptor_size > 162*result.options.descriptor_channels)
+                continue;
+            }
+
+            result.memory_mb = estimate_memory_mb(result.options);
+            space.push_back(result);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+void evaluate_configuration(const std::vector<cv::Mat>& images, const std::vector<cv::Mat>& H,
+                            int npairs, int nruns, TuneResult& result) {
+
+  vector<vector<cv::KeyPoint> > kpts(npairs+1);
+  vector<cv::Mat> desc(npairs+1);
+  double t1 = 0.0, t2 = 0.0, tsum = 0.0;
+
+  AKAZEOptions options = result.options;
+  options.verbosity = false;
+
+  for (int i = 0; i <= npairs; i++) {
+
+    options.img_width = images[i].cols;
+    options.img_height = images[i].rows;
+    libAKAZE::AKAZE evolution(options);
+
+    for (int r = 0; r < nruns; r++) {
+      t1 = cv::getTickCount();
+      evolution.Create_Nonlinear_Scale_Space(images[i]);
+      evolution.Feature_Detection(kpts[i]);
+      evolution.Compute_Descriptors(kpts[i], desc[i]);
+      t2 = cv::getTickCount();
+      tsum += 1000.0*(t2-t1) / cv::getTickFrequency();
+    }
+  }
+
+  cv::Ptr<cv::DescriptorMatcher> matcher;
+  if (options.descriptor < MLDB_UPRIGHT)
+    matcher = cv::DescriptorMatcher::create("BruteForce");
+  else
+    matcher = cv::DescriptorMatcher::create("BruteForce-Hamming");
+
+  double rep = 0.0, ninliers = 0.0;
+
+  for (int i = 1; i <= npairs; i++) {
+
+    vector<cv::DMatch> corresp;
+    int nvisible = 0;
+    compute_correspondences(kpts[0], kpts[i], H[i-1], images[0].size(), images[i].size(),
+                            OVERLAP_ERROR, PIXEL_ERROR, corresp, nvisible);
+    rep += (nvisible > 0 ? 100.0*corresp.size()/(double)nvisible : 0.0);
+
+    vector<vector<cv::DMatch> > dmatches;
+    vector<cv::Point2f> matches, inliers;
+    if (desc[0].rows > 0 && desc[i].rows > 1) {
+      if (options.descriptor < MLDB_UPRIGHT && options.descriptor_int8 == true && options.pca_basis.empty())
+        match_int8_descriptors(desc[0], desc[i], dmatches);
+      else
+        matcher->knnMatch(desc[0], desc[i], dmatches, 2);
+    }
+    matches2points_nndr(kpts[0], kpts[i], dmatches, matches, DRATIO);
+    compute_inliers_homography(matches, inliers, H[i-1], MIN_H_ERROR);
+    ninliers += inliers.size()/2;
+  }
+
+  result.ms = tsum/(double)((npairs+1)*nruns);
+  result.repeatability = rep/npairs;
+  result.inliers = ninliers/npairs;
+  result.npairs = npairs;
+}
+
+/* ************************************************************************* */
+bool dominates(const TuneResult& a, const TuneResult& b) {
+
+  bool no_worse = (a.ms <= b.ms && a.memory_mb <= b.memory_mb &&
+                   a.repeatability >= b.repeatability && a.inliers >= b.inliers);
+  bool better = (a.ms < b.ms || a.memory_mb < b.memory_mb ||
+                 a.repeatability > b.repeatability || a.inliers > b.inliers);
+  return no_worse && better;
+}
+
+/* ************************************************************************* */
+void compute_pareto_ranks(const std::vector<TuneResult>& results, std::vector<int>& ranks) {
+
+  ranks.assign(results.size(), -1);
+  size_t nranked = 0;
+
+  for (int r = 0; nranked < results.size(); r++) {
+
+    vector<size_t> layer;
+    for (size_t i = 0; i < results.size(); i++) {
+      if (ranks[i] != -1)
+        continue;
+
+      bool dominated = false;
+      for (size_t j = 0; j < results.size() && !dominated; j++) {
+        if (j != i && ranks[j] == -1 && dominates(results[j], results[i]))
+          dominated = true;
+      }
+
+      if (!dominated)
+        layer.push_back(i);
+    }
+
+    for (size_t k = 0; k < layer.size(); k++)
+      ranks[layer[k]] = r;
+    nranked += layer.size();
+  }
+}
+
+/* ************************************************************************* */
+int parse_input_options(AKAZEOptions& options, std::string& dataset_path,
+                        std::string& output_path, float& budget_ms, float& budget_mb,
+                        int& eta, int& nruns, int argc, char *argv[]) {
+
+  // If there is only one argument return
+  if (argc == 1) {
+    show_input_options_help(4);
+    return -1;
+  }
+  // Set the options from the command line
+  else if (argc >= 2) {
+
+    // Load the default options
+    options = AKAZEOptions();
+    output_path = "./akaze_options.yml";
+
+    if (!strcmp(argv[1],"--help")) {
+      show_input_options_help(4);
+      return -1;
+    }
+
+    dataset_path = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+      if (!strcmp(argv[i],"--budget_ms")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          budget_ms = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--budget_mb")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          budget_mb = atof(argv[i]);
+        }
+      }
+      else if (!strcmp(argv[i],"--eta")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          eta = atoi(argv[i]);
+
+          if (eta < 2) {
+            eta = 2;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--nruns")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          nruns = atoi(argv[i]);
+
+          if (nruns < 1) {
+            nruns = 1;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--output")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          output_path = argv[i];
+        }
+      }
+      else if (!strcmp(argv[i],"--diffusivity")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.diffusivity = DIFFUSIVITY_TYPE(atoi(argv[i]));
+        }
+      }
+      else if (!strcmp(argv[i],"--descriptor")) {
+        i = i+1;
+        if (i >= argc) {
+          cerr << "Error introducing input options!!" << endl;
+          return -1;
+        }
+        else {
+          options.descriptor = DESCRIPTOR_TYPE(atoi(argv[i]));
+
+          if (options.descriptor < 0 || options.descriptor > MLDB) {
+            options.descriptor = MLDB;
+          }
+        }
+      }
+      else if (!strcmp(argv[i],"--verbose")) {
+        options.verbosity = true;
+      }
+    }
+  }
+
+  return 0;
+}
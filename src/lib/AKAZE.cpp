@@ -23,68 +23,208 @@
 #include "AKAZE.h"
 #include <opencv2/highgui/highgui.hpp>
 
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 using namespace std;
 using namespace libAKAZE;
 
+/* ************************************************************************* */
+/// Returns the descriptor types computed by the options in the order of their matrices,
+/// descriptor first and then the types of extra_descriptors in increasing order
+static vector<DESCRIPTOR_TYPE> descriptor_types(const AKAZEOptions& options) {
+
+  vector<DESCRIPTOR_TYPE> types(1, options.descriptor);
+  for (int type = SURF_UPRIGHT; type <= MLDB; type++) {
+    if ((options.extra_descriptors & (1 << type)) != 0 && type != options.descriptor)
+      types.push_back(DESCRIPTOR_TYPE(type));
+  }
+
+  return types;
+}
+
+/// Returns true when the options compute the descriptor type
+static bool uses_descriptor(const AKAZEOptions& options, DESCRIPTOR_TYPE type) {
+
+  vector<DESCRIPTOR_TYPE> types = descriptor_types(options);
+  return (find(types.begin(), types.end(), type) != types.end());
+}
+
+/// Returns true when the detector response and the candidate extrema of every level are
+/// computed together with the scale space. With half precision storage the float images
+/// of a level only live while the level is computed
+static bool detects_with_scale_space(const AKAZEOptions& options) {
+  return (options.pipeline == true || options.storage == STORAGE_FP16);
+}
+
+/// Planes read by the samplers of the orientation and the descriptors
+enum SAMPLE_PLANES {
+  SAMPLE_FLOAT = 0,   ///< Lt, Lx and Ly
+  SAMPLE_HALF = 1,    ///< Lt16, Lx16 and Ly16
+  SAMPLE_PLANE = 2    ///< Interleaved descriptor plane Ldesc
+};
+
+/// Returns the planes read by the samplers with the options
+static SAMPLE_PLANES sample_planes(const AKAZEOptions& options) {
+
+  if (options.descriptor_plane == true)
+    return SAMPLE_PLANE;
+
+  return (options.storage == STORAGE_FP16 ? SAMPLE_HALF : SAMPLE_FLOAT);
+}
+
 /* ************************************************************************* */
 AKAZE::AKAZE(const AKAZEOptions& options) : options_(options) {
 
   ncycles_ = 0;
   reordering_ = true;
+  kernels_ = &active_kernels();
+  diffusion_threads_ = OMP_MAX_THREADS;
+  detection_threads_ = OMP_MAX_THREADS;
+  arena_ = NULL;
+  arena_size_ = 0;
+  mldb_table_scales_ = 0;
+  mldb_table_size_ = 0;
+
+  if (options_.descriptor_size > 0 && (uses_descriptor(options_, MLDB_UPRIGHT) || uses_descriptor(options_, MLDB))) {
+    vector<int> bits;
+    int nchannels = 0, pattern_size = 0;
+
+    if (options_.descriptor_bits.empty() == false) {
+      if (read_descriptor_bits(options_.descriptor_bits, bits, nchannels, pattern_size) == false) {
+        cerr << "Error: cannot read the descriptor bits from file: " << options_.descriptor_bits << endl;
+        bits.clear();
+      }
+      else if (nchannels != options_.descriptor_channels || pattern_size != options_.descriptor_pattern_size ||
+               (int)bits.size() < options_.descriptor_size) {
+        cerr << "Error: the descriptor bits of " << options_.descriptor_bits << " do not fit the descriptor options, "
+             << "using the random selection" << endl;
+        bits.clear();
+      }
+    }
 
-  if (options_.descriptor_size > 0 && options_.descriptor >= MLDB_UPRIGHT) {
-    generateDescriptorSubsample(descriptorSamples_, descriptorBits_, options_.descriptor_size,
+    if (bits.empty() == false)
+      selectDescriptorSubsample(descriptorSamples_, descriptorBits_, bits, options_.descriptor_size,
                                 options_.descriptor_pattern_size, options_.descriptor_channels);
+    else
+      generateDescriptorSubsample(descriptorSamples_, descriptorBits_, options_.descriptor_size,
+                                  options_.descriptor_pattern_size, options_.descriptor_channels);
   }
 
+  if (options_.pca_basis.empty() == false) {
+    if (read_pca_basis(options_.pca_basis, pca_projection_, pca_bias_) == false) {
+      cerr << "Error: cannot read the PCA basis from file: " << options_.pca_basis << endl;
+      pca_projection_.release();
+    }
+    else if (pca_projection_.cols != 64 || pca_projection_.rows < 1 || pca_projection_.rows > 64 ||
+             pca_bias_.cols != pca_projection_.rows) {
+      cerr << "Error: the PCA basis of " << options_.pca_basis << " does not project 64 values, "
+           << "using the 64 values" << endl;
+      pca_projection_.release();
+    }
+    else if (options_.descriptor_int8 == true) {
+      cerr << "Warning: the int8 descriptors are ignored with a PCA basis" << endl;
+      options_.descriptor_int8 = false;
+    }
+  }
+
+  // The plane is packed from the float images, which only live while the level is computed
+  if (options_.storage == STORAGE_FP16 && options_.descriptor_plane == true) {
+    cerr << "Warning: the descriptor plane is ignored with half precision storage" << endl;
+    options_.descriptor_plane = false;
+  }
+
+  // The Hessian of the float engine is computed from Lx and Ly, so the detector needs
+  // them on the whole level and only the external descriptors can skip them
+  if (options_.sparse_derivatives == true && options_.engine == ENGINE_FLOAT)
+    cerr << "Warning: the sparse derivatives only apply to the fixed point engine and the "
+         << "external descriptors" << endl;
+
+  if (options_.pin_threads == true)
+    Pin_Threads();
+
   Allocate_Memory_Evolution();
+  Compute_MLDB_Sampling_Table();
 }
 
 /* ************************************************************************* */
 AKAZE::~AKAZE() {
   evolution_.clear();
+  Release_Evolution_Arena();
 }
 
 /* ************************************************************************* */
-void AKAZE::Allocate_Memory_Evolution() {
+/// Computes the size of every level of the evolution, nsublevels per octave from omin,
+/// and the octave where the evolution stops. The last octaves are dropped when they are
+/// smaller than 80x40 pixels
+static void compute_level_sizes(const AKAZEOptions& options, vector<cv::Size>& sizes, int& omax) {
 
-  float rfactor = 0.0;
-  int level_height = 0, level_width = 0;
+  sizes.clear();
 
-  // Allocate the dimension of the matrices for the evolution
-  for (int i = 0; i <= options_.omax-1; i++) {
-    rfactor = 1.0/pow(2.0f, i);
-    level_height = (int)(options_.img_height*rfactor);
-    level_width = (int)(options_.img_width*rfactor);
+  // The evolution starts at octave omin, whose size is the size of the input image.
+  // Octaves keep their index, so keypoints are in pixels of the original image
+  omax = max(options.omax, options.omin+1);
+
+  for (int i = options.omin; i <= omax-1; i++) {
+    float rfactor = 1.0/pow(2.0f, i-options.omin);
+    int level_height = (int)(options.img_height*rfactor);
+    int level_width = (int)(options.img_width*rfactor);
 
     // Smallest possible octave and allow one scale if the image is small
-    if ((level_width < 80 || level_height < 40) && i != 0) {
-      options_.omax = i;
+    if ((level_width < 80 || level_height < 40) && i != options.omin) {
+      omax = i;
       break;
     }
 
-    for (int j = 0; j < options_.nsublevels; j++) {
-      TEvolution step;
-      cv::Size size(level_width, level_height);
-      step.Lx.create(size, CV_32F);
-      step.Ly.create(size, CV_32F);
-      step.Lxx.create(size, CV_32F);
-      step.Lxy.create(size, CV_32F);
-      step.Lyy.create(size, CV_32F);
-      step.Lt.create(size, CV_32F);
-      step.Ldet.create(size, CV_32F);
-      step.Lflow.create(size, CV_32F);
-      step.Lstep.create(size, CV_32F);
+    for (int j = 0; j < options.nsublevels; j++)
+      sizes.push_back(cv::Size(level_width, level_height));
+  }
+}
 
-      step.esigma = options_.soffset*pow(2.0f, (float)(j)/(float)(options_.nsublevels) + i);
-      step.sigma_size = fRound(step.esigma);
-      step.etime = 0.5*(step.esigma*step.esigma);
-      step.octave = i;
-      step.sublevel = j;
-      evolution_.push_back(step);
-    }
+/* ************************************************************************* */
+void AKAZE::Allocate_Memory_Evolution() {
+
+  vector<cv::Size> sizes;
+
+  evolution_.clear();
+  nsteps_.clear();
+  tsteps_.clear();
+  ncycles_ = 0;
+
+  // Allocate the dimension of the matrices for the evolution
+  compute_level_sizes(options_, sizes, options_.omax);
+
+  for (size_t k = 0; k < sizes.size(); k++) {
+    const int i = options_.omin + (int)k/options_.nsublevels;
+    const int j = (int)k%options_.nsublevels;
+
+    TEvolution step;
+    step.esigma = options_.soffset*pow(2.0f, (float)(j)/(float)(options_.nsublevels) + i);
+    step.sigma_size = fRound(step.esigma);
+    step.etime = 0.5*(step.esigma*step.esigma);
+    step.octave = i;
+    step.sublevel = j;
+    evolution_.push_back(step);
   }
 
+  // Matrices of the evolution in a single arena
+  Allocate_Evolution_Arena(sizes);
+  level_extrema_.assign(evolution_.size(), vector<cv::KeyPoint>());
+  descriptor_data_pending_.assign(evolution_.size(), 0);
+  descriptor_plane_pending_.assign(evolution_.size(), 0);
+  descriptor_tiles_.assign(evolution_.size(), vector<char>());
+
   // Allocate memory for the number of cycles and time steps
   for (size_t i = 1; i < evolution_.size(); i++) {
     int naux = 0;
@@ -96,6 +236,353 @@ void AKAZE::Allocate_Memory_Evolution() {
     tsteps_.push_back(tau);
     ncycles_++;
   }
+
+  if (options_.first_touch == true)
+    First_Touch_Evolution();
+}
+
+/* ************************************************************************* */
+/// Guard band around the matrices of the evolution. The left band is one cache
+/// line wide, so that the rows of the images start at 64 byte boundaries
+static const int arena_guard = 1;
+static const int arena_guard_left = 64/sizeof(float);
+static const int arena_fixed_guard_left = 64/sizeof(short);
+
+/// Returns the row step in bytes of the matrices of the arena. Rows start at 64 byte
+/// boundaries, and steps multiple of 512 bytes get one more cache line so that
+/// consecutive rows do not map to the same L1 sets (4K aliasing)
+static size_t arena_row_step(int width, size_t elem_size = sizeof(float)) {
+
+  size_t step = (width*elem_size + 63) & ~(size_t)63;
+  if (step % 512 == 0)
+    step += 64;
+
+  return step;
+}
+
+/* ************************************************************************* */
+/// Number of float, half precision and fixed point matrices of every level of the arena
+static const int arena_float_mats = 10, arena_half_mats = 4, arena_fixed_mats = 9;
+
+/// Returns the alignment of the arena. Transparent huge pages need 2MB aligned arenas
+static size_t arena_alignment(const AKAZEOptions& options) {
+  return (options.huge_pages == true ? (size_t)(2 << 20) : 64);
+}
+
+/// Returns the size of the float working sets of half precision storage, of the size of
+/// the first level with its guard band, and their row step
+static cv::Size arena_working_set(const AKAZEOptions& options, const std::vector<cv::Size>& sizes,
+                                  size_t& working_step) {
+
+  working_step = 0;
+  if (options.storage != STORAGE_FP16 || sizes.empty() == true)
+    return cv::Size(0, 0);
+
+  cv::Size working(arena_guard_left + sizes[0].width + arena_guard, sizes[0].height + 2*arena_guard);
+  working_step = arena_row_step(working.width);
+  return working;
+}
+
+/// Returns the size in bytes of the arena for the given levels, with the guard bands,
+/// the padded rows, the working sets of half precision storage, the descriptor plane
+/// and the fixed point images
+static size_t arena_size(const AKAZEOptions& options, const std::vector<cv::Size>& sizes) {
+
+  const bool half = (options.storage == STORAGE_FP16);
+
+  // The constructor ignores the descriptor plane with half precision storage
+  const bool plane = (options.descriptor_plane == true && half == false);
+
+  size_t working_step = 0;
+  cv::Size working = arena_working_set(options, sizes, working_step);
+
+  size_t size = 2*arena_float_mats*working_step*working.height;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    size_t step = arena_row_step(arena_guard_left + sizes[i].width + arena_guard);
+    if (half == false)
+      size += arena_float_mats*step*(sizes[i].height + 2*arena_guard);
+    else
+      size += arena_half_mats*arena_row_step(sizes[i].width, sizeof(unsigned short))*sizes[i].height;
+    if (plane == true)
+      size += arena_row_step(sizes[i].width, 4*sizeof(float))*sizes[i].height;
+    if (options.engine == ENGINE_FIXED)
+      size += arena_fixed_mats*arena_row_step(arena_fixed_guard_left + sizes[i].width + arena_guard, sizeof(short))*
+          (sizes[i].height + 2*arena_guard);
+  }
+
+  const size_t alignment = arena_alignment(options);
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/* ************************************************************************* */
+size_t AKAZE::Evolution_Memory_Size(const AKAZEOptions& options) {
+
+  vector<cv::Size> sizes;
+  int omax = 0;
+  compute_level_sizes(options, sizes, omax);
+  return arena_size(options, sizes);
+}
+
+/* ************************************************************************* */
+void AKAZE::Allocate_Evolution_Arena(const std::vector<cv::Size>& sizes) {
+
+  const int nmats = arena_float_mats, nhalf_mats = arena_half_mats, nfixed_mats = arena_fixed_mats;
+  const bool half = (options_.storage == STORAGE_FP16);
+
+  // With half precision storage the levels only keep Lt, Lx, Ly and Ldet in half precision,
+  // and the float images are two working sets of the size of the first level, used by
+  // the even and the odd levels while they are computed
+  size_t working_step = 0;
+  cv::Size working = arena_working_set(options_, sizes, working_step);
+
+  const size_t size = arena_size(options_, sizes);
+  const size_t alignment = arena_alignment(options_);
+
+  Release_Evolution_Arena();
+
+#ifdef _WIN32
+  arena_ = (unsigned char*)_aligned_malloc(size, alignment);
+#else
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, alignment, size) != 0)
+    ptr = NULL;
+  arena_ = (unsigned char*)ptr;
+#endif
+
+  if (arena_ == NULL) {
+    cerr << "Error allocating " << size << " bytes for the nonlinear scale space!!" << endl;
+    throw std::bad_alloc();
+  }
+
+  arena_size_ = size;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (options_.huge_pages == true && madvise(arena_, arena_size_, MADV_HUGEPAGE) != 0)
+    cerr << "Warning: transparent huge pages are not available" << endl;
+#endif
+
+  // The matrices are ROI headers into the arena, surrounded by their guard band
+  unsigned char* data = arena_;
+  unsigned char* working_sets[2] = {data, data + nmats*working_step*working.height};
+  data += 2*nmats*working_step*working.height;
+
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    TEvolution& e = evolution_[i];
+    cv::Mat* mats[nmats] = {&e.Lx, &e.Ly, &e.Lxx, &e.Lxy, &e.Lyy,
+                            &e.Lt, &e.Ldet, &e.Lflow, &e.Lstep, &e.Lsmooth};
+    cv::Size guarded(arena_guard_left + sizes[i].width + arena_guard, sizes[i].height + 2*arena_guard);
+    cv::Rect roi(arena_guard_left, arena_guard, sizes[i].width, sizes[i].height);
+
+    if (half == false) {
+      size_t step = arena_row_step(guarded.width);
+      for (int k = 0; k < nmats; k++) {
+        *mats[k] = cv::Mat(guarded, CV_32F, data, step)(roi);
+        data += step*guarded.height;
+      }
+    }
+    else {
+      unsigned char* set = working_sets[i % 2];
+      for (int k = 0; k < nmats; k++) {
+        *mats[k] = cv::Mat(guarded, CV_32F, set, working_step)(roi);
+        set += working_step*working.height;
+      }
+    }
+
+    // Half precision storage, without guard band
+    if (half == true) {
+      cv::Mat* half_mats[nhalf_mats] = {&e.Lt16, &e.Lx16, &e.Ly16, &e.Ldet16};
+      size_t half_step = arena_row_step(sizes[i].width, sizeof(unsigned short));
+
+      for (int k = 0; k < nhalf_mats; k++) {
+        *half_mats[k] = cv::Mat(sizes[i], CV_16U, data, half_step);
+        data += half_step*sizes[i].height;
+      }
+    }
+
+    // Interleaved descriptor plane, without guard band
+    if (options_.descriptor_plane == true) {
+      size_t plane_step = arena_row_step(sizes[i].width, 4*sizeof(float));
+      e.Ldesc = cv::Mat(sizes[i], CV_32FC4, data, plane_step);
+      data += plane_step*sizes[i].height;
+    }
+
+    // Fixed point images, with the same guard band
+    if (options_.engine == ENGINE_FIXED) {
+      cv::Mat* fixed_mats[nfixed_mats] = {&e.Lt_q, &e.Lsmooth_q, &e.Lflow_q, &e.Lstep_q,
+                                          &e.Lx_q, &e.Ly_q, &e.Lxx_q, &e.Lxy_q, &e.Lyy_q};
+      cv::Size fixed_guarded(arena_fixed_guard_left + sizes[i].width + arena_guard, guarded.height);
+      cv::Rect fixed_roi(arena_fixed_guard_left, arena_guard, sizes[i].width, sizes[i].height);
+      size_t fixed_step = arena_row_step(fixed_guarded.width, sizeof(short));
+
+      for (int k = 0; k < nfixed_mats; k++) {
+        *fixed_mats[k] = cv::Mat(fixed_guarded, CV_16S, data, fixed_step)(fixed_roi);
+        data += fixed_step*fixed_guarded.height;
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_MLDB_Sampling_Table() {
+
+  mldb_offsets_.clear();
+  mldb_table_scales_ = 0;
+  mldb_table_size_ = 0;
+
+  if (options_.mldb_angle_bins <= 0 || uses_descriptor(options_, MLDB) == false || options_.descriptor_size != 0)
+    return;
+
+  // Integer scales of the keypoints detected in the levels
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    float ratio = pow(2.0f, (float)evolution_[i].octave);
+    mldb_table_scales_ = max(mldb_table_scales_, fRound(evolution_[i].esigma*options_.derivative_factor/ratio));
+  }
+
+  for (int bin = 0; bin < options_.mldb_angle_bins; bin++) {
+    float angle = 2.0*CV_PI*bin/options_.mldb_angle_bins;
+    for (int scale = 1; scale <= mldb_table_scales_; scale++)
+      compute_mldb_sampling_offsets(mldb_offsets_, options_.descriptor_pattern_size,
+                                    cos(angle), sin(angle), scale);
+  }
+
+  mldb_table_size_ = (int)mldb_offsets_.size()/(options_.mldb_angle_bins*mldb_table_scales_);
+}
+
+/* ************************************************************************* */
+void AKAZE::Release_Evolution_Arena() {
+
+  if (arena_ == NULL)
+    return;
+
+#ifdef _WIN32
+  _aligned_free(arena_);
+#else
+  free(arena_);
+#endif
+
+  arena_ = NULL;
+  arena_size_ = 0;
+}
+
+/* ************************************************************************* */
+void AKAZE::Clone_Evolution(std::vector<TEvolution>& evolution) const {
+
+  evolution.resize(evolution_.size());
+
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    const TEvolution& src = evolution_[i];
+    TEvolution& dst = evolution[i];
+
+    // Copy the scalar members, then replace the headers into the arena
+    dst = src;
+    cv::Mat TEvolution::* const mats[] = {
+      &TEvolution::Lx, &TEvolution::Ly, &TEvolution::Lxx, &TEvolution::Lxy, &TEvolution::Lyy,
+      &TEvolution::Lflow, &TEvolution::Lt, &TEvolution::Lsmooth, &TEvolution::Lstep,
+      &TEvolution::Ldet, &TEvolution::Lt16, &TEvolution::Lx16, &TEvolution::Ly16,
+      &TEvolution::Ldet16, &TEvolution::Ldesc, &TEvolution::Lt_q, &TEvolution::Lsmooth_q,
+      &TEvolution::Lflow_q, &TEvolution::Lstep_q, &TEvolution::Lx_q, &TEvolution::Ly_q,
+      &TEvolution::Lxx_q, &TEvolution::Lxy_q, &TEvolution::Lyy_q
+    };
+
+    for (size_t k = 0; k < sizeof(mats)/sizeof(mats[0]); k++)
+      dst.*mats[k] = (src.*mats[k]).clone();
+  }
+}
+
+#if defined(_OPENMP) && defined(__linux__)
+/// Returns the CPUs where the process can run. The set is read once, before any thread is pinned
+static const vector<int>& process_cpus() {
+
+  static vector<int> cpus;
+  static bool initialized = false;
+
+#pragma omp critical(akaze_process_cpus)
+  {
+    if (initialized == false) {
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+          if (CPU_ISSET(c, &allowed))
+            cpus.push_back(c);
+        }
+      }
+      initialized = true;
+    }
+  }
+
+  return cpus;
+}
+#endif
+
+/* ************************************************************************* */
+void AKAZE::Pin_Threads() {
+
+#if defined(_OPENMP) && defined(__linux__)
+  const vector<int>& cpus = process_cpus();
+  if (cpus.empty()) {
+    cerr << "Warning: the CPU affinity of the process could not be read. Threads are not pinned" << endl;
+    return;
+  }
+
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel
+  {
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &cpu);
+    sched_setaffinity(0, sizeof(cpu_set_t), &cpu);
+  }
+#else
+  cerr << "Warning: pinning threads is only supported with OpenMP on Linux" << endl;
+#endif
+}
+
+/* ************************************************************************* */
+void AKAZE::First_Touch_Evolution() {
+
+  // Rows of the images updated by the FED steps, with the same schedule as nld_step_scalar
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    TEvolution& e = evolution_[i];
+    const size_t row_size = e.Lt.cols*sizeof(float);
+
+#ifdef _OPENMP
+    omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < e.Lt.rows; y++) {
+      memset(e.Lt.ptr<float>(y), 0, row_size);
+      memset(e.Lflow.ptr<float>(y), 0, row_size);
+      memset(e.Lstep.ptr<float>(y), 0, row_size);
+      if (options_.engine == ENGINE_FIXED) {
+        memset(e.Lt_q.ptr<short>(y), 0, e.Lt_q.cols*sizeof(short));
+        memset(e.Lflow_q.ptr<short>(y), 0, e.Lt_q.cols*sizeof(short));
+        memset(e.Lstep_q.ptr<short>(y), 0, e.Lt_q.cols*sizeof(short));
+      }
+    }
+  }
+
+  // Levels of the derivatives, with the same schedule as Compute_Multiscale_Derivatives
+#ifdef _OPENMP
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < (int)evolution_.size(); i++) {
+    evolution_[i].Lsmooth = cv::Scalar(0);
+    evolution_[i].Lx = cv::Scalar(0);
+    evolution_[i].Ly = cv::Scalar(0);
+    evolution_[i].Lxx = cv::Scalar(0);
+    evolution_[i].Lxy = cv::Scalar(0);
+    evolution_[i].Lyy = cv::Scalar(0);
+    if (options_.engine == ENGINE_FIXED) {
+      evolution_[i].Lsmooth_q = cv::Scalar(0);
+      evolution_[i].Lx_q = cv::Scalar(0);
+      evolution_[i].Ly_q = cv::Scalar(0);
+      evolution_[i].Lxx_q = cv::Scalar(0);
+      evolution_[i].Lxy_q = cv::Scalar(0);
+      evolution_[i].Lyy_q = cv::Scalar(0);
+    }
+  }
 }
 
 /* ************************************************************************* */
@@ -109,6 +596,14 @@ int AKAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
     return -1;
   }
 
+  // The first level lives in the evolution arena, so copyTo must not reallocate it
+  if (img.type() != CV_32F || img.cols != options_.img_width || img.rows != options_.img_height) {
+    cerr << "Error generating the nonlinear scale space!!" << endl;
+    cerr << "The image must be CV_32F of " << options_.img_width << "x" << options_.img_height
+         << " pixels, as in the options" << endl;
+    return -1;
+  }
+
   t1 = cv::getTickCount();
 
   // Copy the original image to the first level of the evolution
@@ -116,6 +611,10 @@ int AKAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
   gaussian_2D_convolution(evolution_[0].Lt, evolution_[0].Lt, 0, 0, options_.soffset);
   evolution_[0].Lt.copyTo(evolution_[0].Lsmooth);
 
+  descriptor_data_pending_.assign(evolution_.size(), 0);
+  descriptor_plane_pending_.assign(evolution_.size(), (char)options_.descriptor_plane);
+  descriptor_tiles_.assign(evolution_.size(), vector<char>());
+
   // First compute the kcontrast factor
   options_.kcontrast = compute_k_percentile(img, options_.kcontrast_percentile,
                                             1.0, options_.kcontrast_nbins, 0, 0);
@@ -123,229 +622,827 @@ int AKAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
   t2 = cv::getTickCount();
   timing_.kcontrast = 1000.0*(t2-t1) / cv::getTickFrequency();
 
-  // Now generate the rest of evolution levels
-  for (size_t i = 1; i < evolution_.size(); i++) {
+  // The fixed point engine starts from the first level in Q12
+  if (options_.engine == ENGINE_FIXED) {
+    evolution_[0].Lt.convertTo(evolution_[0].Lt_q, CV_16S, (double)(1 << fixed_image_bits));
+    evolution_[0].Lt_q.copyTo(evolution_[0].Lsmooth_q);
+    fixed_lut_.clear();
+  }
+
+  if (detects_with_scale_space(options_) == true) {
+    Create_Pipelined_Scale_Space();
+
+    // The derivatives are computed together with the scale space
+    timing_.derivatives = 0.0;
+  }
+  else if (options_.wavefront == true && options_.engine == ENGINE_FLOAT) {
+    Create_Wavefront_Scale_Space();
+  }
+  else {
+    // Now generate the rest of evolution levels
+    for (size_t i = 1; i < evolution_.size(); i++)
+      Compute_Nonlinear_Level(i);
+  }
+
+  t2 = cv::getTickCount();
+  timing_.scale = 1000.0*(t2-t1) / cv::getTickFrequency();
+
+  return 0;
+}
+
+/* ************************************************************************* */
+/// Fills the guard band of the rows [y0, y1) of an evolution image, and the guard
+/// rows above and below the image when the band contains its first or last row
+template <typename T>
+static void replicate_guard_rows(cv::Mat& img, int y0, int y1) {
+
+  const size_t step = img.step1();
+
+  for (int y = y0; y < y1; y++) {
+    T* row = img.ptr<T>(y);
+    row[-1] = row[0];
+    row[img.cols] = row[img.cols-1];
+  }
+
+  if (y0 == 0) {
+    T* first = img.ptr<T>(0) - 1;
+    memcpy(first - step, first, (img.cols+2)*sizeof(T));
+  }
+
+  if (y1 == img.rows) {
+    T* last = img.ptr<T>(img.rows-1) - 1;
+    memcpy(last + step, last, (img.cols+2)*sizeof(T));
+  }
+}
 
-    if (evolution_[i].octave > evolution_[i-1].octave) {
-      halfsample_image(evolution_[i-1].Lt, evolution_[i].Lt);
-      options_.kcontrast = options_.kcontrast*0.75;
+/* ************************************************************************* */
+void AKAZE::Compute_Nonlinear_Level(size_t i) {
+
+  if (options_.engine == ENGINE_FIXED) {
+    Compute_Fixed_Nonlinear_Level(i);
+    return;
+  }
+
+  if (evolution_[i].octave > evolution_[i-1].octave) {
+    halfsample_image(evolution_[i-1].Lt, evolution_[i].Lt);
+    options_.kcontrast = options_.kcontrast*0.75;
+  }
+  else {
+    evolution_[i-1].Lt.copyTo(evolution_[i].Lt);
+  }
+
+  gaussian_2D_convolution(evolution_[i].Lt, evolution_[i].Lsmooth, 0, 0, 1.0);
+
+  // Compute the Gaussian derivatives Lx and Ly
+  image_derivatives_scharr(evolution_[i].Lsmooth, evolution_[i].Lx, 1, 0);
+  image_derivatives_scharr(evolution_[i].Lsmooth, evolution_[i].Ly, 0, 1);
+
+  // Compute the conductivity equation
+  Compute_Diffusivity(evolution_[i].Lx, evolution_[i].Ly, evolution_[i].Lflow, options_.kcontrast);
+
+  // Perform FED n inner steps. The conductivity is fixed during the steps, the evolution
+  // changes in every one of them
+  replicate_guard_rows<float>(evolution_[i].Lflow, 0, evolution_[i].Lflow.rows);
+  for (int j = 0; j < nsteps_[i-1]; j++) {
+    replicate_guard_rows<float>(evolution_[i].Lt, 0, evolution_[i].Lt.rows);
+    kernels_->nld_step_guarded(evolution_[i].Lt, evolution_[i].Lflow, evolution_[i].Lstep, tsteps_[i-1][j],
+                               diffusion_threads_);
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& Lflow, float kcontrast) {
+
+  switch (options_.diffusivity) {
+    case PM_G1:
+      kernels_->pm_g1(Lx, Ly, Lflow, kcontrast);
+    break;
+    case PM_G2:
+      kernels_->pm_g2(Lx, Ly, Lflow, kcontrast);
+    break;
+    case WEICKERT:
+      kernels_->weickert_diffusivity(Lx, Ly, Lflow, kcontrast);
+    break;
+    case CHARBONNIER:
+      kernels_->charbonnier_diffusivity(Lx, Ly, Lflow, kcontrast);
+    break;
+    default:
+      cerr << "Diffusivity: " << options_.diffusivity << " is not supported" << endl;
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Fixed_Nonlinear_Level(size_t i) {
+
+  // Smoothing and gradient filters of the conductivity, as in the float engine
+  cv::Mat gauss, dx_kx, dx_ky, dy_kx, dy_ky;
+  compute_fixed_gaussian_kernel(gauss, 1.0);
+  compute_fixed_derivative_kernels(dx_kx, dx_ky, 1, 0, 1);
+  compute_fixed_derivative_kernels(dy_kx, dy_ky, 0, 1, 1);
+  const int gauss_shift = fixed_tap_bits + 2;
+  const int deriv_shift = fixed_tap_bits + fixed_image_bits + 2 - fixed_derivative_bits;
+
+  if (evolution_[i].octave > evolution_[i-1].octave) {
+    halfsample_image(evolution_[i-1].Lt_q, evolution_[i].Lt_q);
+    options_.kcontrast = options_.kcontrast*0.75;
+    fixed_lut_.clear();
+  }
+  else {
+    evolution_[i-1].Lt_q.copyTo(evolution_[i].Lt_q);
+  }
+
+  kernels_->fixed_sep_filter(evolution_[i].Lt_q, evolution_[i].Lsmooth_q, gauss, gauss,
+                             gauss_shift, cv::BORDER_REPLICATE, diffusion_threads_);
+  kernels_->fixed_sep_filter(evolution_[i].Lsmooth_q, evolution_[i].Lx_q, dx_kx, dx_ky,
+                             deriv_shift, cv::BORDER_REFLECT_101, diffusion_threads_);
+  kernels_->fixed_sep_filter(evolution_[i].Lsmooth_q, evolution_[i].Ly_q, dy_kx, dy_ky,
+                             deriv_shift, cv::BORDER_REFLECT_101, diffusion_threads_);
+
+  // The contrast factor only changes between octaves
+  if (fixed_lut_.empty())
+    compute_fixed_diffusivity_lut(options_.diffusivity, options_.kcontrast, fixed_lut_);
+  kernels_->fixed_diffusivity(evolution_[i].Lx_q, evolution_[i].Ly_q, evolution_[i].Lflow_q, &fixed_lut_[0]);
+
+  // Perform FED n inner steps
+  replicate_guard_rows<short>(evolution_[i].Lflow_q, 0, evolution_[i].Lflow_q.rows);
+  for (int j = 0; j < nsteps_[i-1]; j++) {
+    replicate_guard_rows<short>(evolution_[i].Lt_q, 0, evolution_[i].Lt_q.rows);
+    kernels_->nld_step_fixed_guarded(evolution_[i].Lt_q, evolution_[i].Lflow_q, evolution_[i].Lstep_q,
+                                     tsteps_[i-1][j], diffusion_threads_);
+  }
+
+  // The descriptors read the float evolution
+  evolution_[i].Lt_q.convertTo(evolution_[i].Lt, CV_32F, 1.0/(1 << fixed_image_bits));
+}
+
+/* ************************************************************************* */
+void AKAZE::Create_Pipelined_Scale_Space() {
+
+  const int nlevels = (int)evolution_.size();
+
+  // With half precision storage the next level reuses the working set of the previous
+  // one, so every level is stored in half precision before the next one is diffused
+  if (options_.storage == STORAGE_FP16) {
+    for (int i = 0; i < nlevels; i++) {
+      if (i > 0)
+        Compute_Nonlinear_Level(i);
+      Compute_Level_Derivatives(i);
+      Compute_Level_Hessian_Response(i);
+      Find_Level_Extrema(i);
     }
-    else {
-      evolution_[i-1].Lt.copyTo(evolution_[i].Lt);
+    return;
+  }
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+  // Dependence tokens of the tasks: the diffused levels, and the detection, which
+  // processes the levels in order
+  vector<char> diffused(nlevels), detected(1);
+
+  // The diffusion of the next level runs together with the derivatives, the detector
+  // response and the candidate extrema of the levels already diffused. The next levels
+  // only read Lt of the previous one, and the comparisons between levels are done later
+  // in Find_Scale_Space_Extrema, so the keypoints are the same as without the pipeline.
+  // Both tasks open their own teams, so they split the thread budget between them
+  diffusion_threads_ = max(OMP_MAX_THREADS/2, 1);
+  detection_threads_ = max(OMP_MAX_THREADS-diffusion_threads_, 1);
+  const int max_active_levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+#pragma omp parallel num_threads(2)
+#pragma omp single
+  {
+    for (int i = 1; i < nlevels; i++) {
+#pragma omp task depend(in: diffused.data()[i-1]) depend(out: diffused.data()[i])
+      Compute_Nonlinear_Level(i);
     }
 
-    gaussian_2D_convolution(evolution_[i].Lt, evolution_[i].Lsmooth, 0, 0, 1.0);
+    for (int i = 0; i < nlevels; i++) {
+#pragma omp task depend(in: diffused.data()[i]) depend(inout: detected.data()[0])
+      {
+        Compute_Level_Derivatives(i);
+        Compute_Level_Hessian_Response(i);
+        Find_Level_Extrema(i);
+      }
+    }
+  }
 
-    // Compute the Gaussian derivatives Lx and Ly
-    image_derivatives_scharr(evolution_[i].Lsmooth, evolution_[i].Lx, 1, 0);
-    image_derivatives_scharr(evolution_[i].Lsmooth, evolution_[i].Ly, 0, 1);
+  omp_set_max_active_levels(max_active_levels);
+  diffusion_threads_ = OMP_MAX_THREADS;
+  detection_threads_ = OMP_MAX_THREADS;
+#else
+  // Without OpenMP tasks every level is detected after it is diffused
+  for (int i = 0; i < nlevels; i++) {
+    if (i > 0)
+      Compute_Nonlinear_Level(i);
+    Compute_Level_Derivatives(i);
+    Compute_Level_Hessian_Response(i);
+    Find_Level_Extrema(i);
+  }
+#endif
+}
 
-    // Compute the conductivity equation
-    switch (options_.diffusivity) {
-      case PM_G1:
-        pm_g1(evolution_[i].Lx, evolution_[i].Ly, evolution_[i].Lflow, options_.kcontrast);
-      break;
-      case PM_G2:
-        pm_g2(evolution_[i].Lx, evolution_[i].Ly, evolution_[i].Lflow, options_.kcontrast);
-      break;
-      case WEICKERT:
-        weickert_diffusivity(evolution_[i].Lx, evolution_[i].Ly, evolution_[i].Lflow, options_.kcontrast);
-      break;
-      case CHARBONNIER:
-        charbonnier_diffusivity(evolution_[i].Lx, evolution_[i].Ly, evolution_[i].Lflow, options_.kcontrast);
-      break;
-      default:
-        cerr << "Diffusivity: " << options_.diffusivity << " is not supported" << endl;
-    }
+/* ************************************************************************* */
+/// Minimum number of rows of the bands of the wavefront scale space
+static const int wavefront_rows = 32;
+
+/// Radius of the Gaussian of sigma 1 in gaussian_2D_convolution
+static const int wavefront_smooth_radius = 2;
+
+/* ************************************************************************* */
+void AKAZE::Compute_Conductivity_Rows(size_t i, int y0, int y1, float kcontrast) {
+
+  TEvolution& e = evolution_[i];
+  const int r = wavefront_smooth_radius;
+  const int rows = e.Lt.rows, cols = e.Lt.cols;
+
+  // Rows of Lsmooth read by the Scharr filter, and rows of Lt read by the Gaussian.
+  // The padding replicates the borders of the image as gaussian_2D_convolution does
+  const int s0 = max(y0-1, 0), s1 = min(y1+1, rows);
+  const int t0 = max(s0-r, 0), t1 = min(s1+r, rows);
+
+  cv::Mat Lt_band, Lsmooth_band, Lx_band, Ly_band;
+  cv::Mat Lsmooth_rows = e.Lsmooth.rowRange(y0, y1), Lx_rows = e.Lx.rowRange(y0, y1);
+  cv::Mat Ly_rows = e.Ly.rowRange(y0, y1), Lflow_rows = e.Lflow.rowRange(y0, y1);
+  cv::copyMakeBorder(e.Lt.rowRange(t0, t1), Lt_band, t0-(s0-r), (s1+r)-t1, r, r,
+                     cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+  gaussian_2D_convolution(Lt_band, Lsmooth_band, 0, 0, 1.0);
+  Lsmooth_band = Lsmooth_band(cv::Rect(r, r, cols, s1-s0));
+  Lsmooth_band.rowRange(y0-s0, y1-s0).copyTo(Lsmooth_rows);
+
+  // Same reflected borders as image_derivatives_scharr
+  cv::copyMakeBorder(Lsmooth_band, Lsmooth_band, 1-(y0-s0), 1-(s1-y1), 1, 1,
+                     cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+  image_derivatives_scharr(Lsmooth_band, Lx_band, 1, 0);
+  image_derivatives_scharr(Lsmooth_band, Ly_band, 0, 1);
+  Lx_band(cv::Rect(1, 1, cols, y1-y0)).copyTo(Lx_rows);
+  Ly_band(cv::Rect(1, 1, cols, y1-y0)).copyTo(Ly_rows);
+
+  Compute_Diffusivity(Lx_rows, Ly_rows, Lflow_rows, kcontrast);
+  replicate_guard_rows<float>(e.Lflow, y0, y1);
+}
 
-    // Perform FED n inner steps
-    for (int j = 0; j < nsteps_[i-1]; j++)
-      nld_step_scalar(evolution_[i].Lt, evolution_[i].Lflow, evolution_[i].Lstep, tsteps_[i-1][j]);
+/* ************************************************************************* */
+void AKAZE::Create_Wavefront_Scale_Space() {
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+  const int nlevels = (int)evolution_.size();
+  const int nbands_max = max(evolution_[0].Lt.rows/wavefront_rows, 1);
+
+  // Dependence tokens of the tasks, one per band of every level: the evolution
+  // image, the diffusivity and the step update of the band
+  vector<char> lt_tokens(nlevels*nbands_max), c_tokens(nlevels*nbands_max), step_tokens(nlevels*nbands_max);
+  float kcontrast = options_.kcontrast;
+
+  // The Gaussian and the Scharr filter of the conductivity read three rows above
+  // and below the band, and every FED step one row, so a band only waits for its
+  // two neighbours. The last band takes the remaining rows, so all the bands have
+  // at least wavefront_rows rows. The tasks run the same arithmetic on the same
+  // rows as Compute_Nonlinear_Level, so the evolution does not change
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel
+#pragma omp single
+  {
+    for (int i = 1; i < nlevels; i++) {
+
+      const int rows = evolution_[i].Lt.rows;
+      const int nbands = max(rows/wavefront_rows, 1);
+      const int k = i*nbands_max;
+
+      // The half sampling reads the whole previous level, so the octaves are barriers
+      if (evolution_[i].octave > evolution_[i-1].octave) {
+#pragma omp taskwait
+        halfsample_image(evolution_[i-1].Lt, evolution_[i].Lt);
+        replicate_guard_rows<float>(evolution_[i].Lt, 0, rows);
+        kcontrast = kcontrast*0.75;
+      }
+      else {
+        for (int b = 0; b < nbands; b++) {
+          const int y0 = b*wavefront_rows, y1 = (b == nbands-1) ? rows : y0+wavefront_rows;
+#pragma omp task depend(in: lt_tokens.data()[k-nbands_max+b]) depend(out: lt_tokens.data()[k+b])
+          {
+            cv::Mat Lt_rows = evolution_[i].Lt.rowRange(y0, y1);
+            evolution_[i-1].Lt.rowRange(y0, y1).copyTo(Lt_rows);
+            replicate_guard_rows<float>(evolution_[i].Lt, y0, y1);
+          }
+        }
+      }
+
+      for (int b = 0; b < nbands; b++) {
+        const int y0 = b*wavefront_rows, y1 = (b == nbands-1) ? rows : y0+wavefront_rows;
+        const int bm = max(b-1, 0), bp = min(b+1, nbands-1);
+#pragma omp task depend(in: lt_tokens.data()[k+bm], lt_tokens.data()[k+b], lt_tokens.data()[k+bp]) depend(out: c_tokens.data()[k+b])
+        Compute_Conductivity_Rows(i, y0, y1, kcontrast);
+      }
+
+      // Perform FED n inner steps. The update of a band waits until its
+      // neighbours have read it
+      for (int j = 0; j < nsteps_[i-1]; j++) {
+        const float stepsize = tsteps_[i-1][j];
+
+        for (int b = 0; b < nbands; b++) {
+          const int y0 = b*wavefront_rows, y1 = (b == nbands-1) ? rows : y0+wavefront_rows;
+          const int bm = max(b-1, 0), bp = min(b+1, nbands-1);
+#pragma omp task depend(in: lt_tokens.data()[k+bm], lt_tokens.data()[k+b], lt_tokens.data()[k+bp]) \
+                 depend(in: c_tokens.data()[k+bm], c_tokens.data()[k+b], c_tokens.data()[k+bp]) \
+                 depend(out: step_tokens.data()[k+b])
+          kernels_->nld_flux_rows(evolution_[i].Lt, evolution_[i].Lflow, evolution_[i].Lstep, stepsize, y0, y1);
+        }
+
+        for (int b = 0; b < nbands; b++) {
+          const int y0 = b*wavefront_rows, y1 = (b == nbands-1) ? rows : y0+wavefront_rows;
+#pragma omp task depend(in: step_tokens.data()[k+b]) depend(inout: lt_tokens.data()[k+b])
+          {
+            cv::Mat Lt_rows = evolution_[i].Lt.rowRange(y0, y1);
+            Lt_rows += evolution_[i].Lstep.rowRange(y0, y1);
+            replicate_guard_rows<float>(evolution_[i].Lt, y0, y1);
+          }
+        }
+      }
+    }
   }
 
+  options_.kcontrast = kcontrast;
+#else
+  // Without OpenMP tasks the levels are diffused one after the other
+  for (size_t i = 1; i < evolution_.size(); i++)
+    Compute_Nonlinear_Level(i);
+#endif
+}
+
+/* ************************************************************************* */
+void AKAZE::Feature_Detection(std::vector<cv::KeyPoint>& kpts) {
+
+  double t1 = 0.0, t2 = 0.0;
+
+  t1 = cv::getTickCount();
+
+  vector<cv::KeyPoint>().swap(kpts);
+
+  // The pipelined scale space already has the detector response
+  if (detects_with_scale_space(options_) == false)
+    Compute_Determinant_Hessian_Response();
+
+  Find_Scale_Space_Extrema(kpts);
+  Do_Subpixel_Refinement(kpts);
+
   t2 = cv::getTickCount();
-  timing_.scale = 1000.0*(t2-t1) / cv::getTickFrequency();
+  timing_.detector = 1000.0*(t2-t1) / cv::getTickFrequency();
+}
 
-  return 0;
+/* ************************************************************************* */
+void AKAZE::Compute_Multiscale_Derivatives() {
+
+  double t1 = 0.0, t2 = 0.0;
+
+  t1 = cv::getTickCount();
+
+#ifdef _OPENMP
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+
+  for (int i = 0; i < (int) evolution_.size(); i++)
+    Compute_Level_Derivatives(i);
+
+  t2 = cv::getTickCount();
+  timing_.derivatives = 1000.0*(t2-t1) / cv::getTickFrequency();
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Level_Derivatives(size_t i) {
+
+  float ratio = pow(2.0f,(float)evolution_[i].octave);
+  int sigma_size_ = fRound(evolution_[i].esigma*options_.derivative_factor/ratio);
+
+  Compute_Level_First_Derivatives(i);
+
+  // The data only read by the descriptors are computed later around the keypoints. The
+  // half precision storage is written with the level, while its float images live. The
+  // float engine has nothing to defer: Lx and Ly are the inputs of its Hessian
+  if (options_.sparse_derivatives == true && options_.storage == STORAGE_FP32) {
+    descriptor_data_pending_[i] = (options_.engine == ENGINE_FIXED);
+    descriptor_tiles_[i].clear();
+  }
+  else if (options_.engine == ENGINE_FIXED)
+    Convert_Fixed_Derivatives(i, cv::Rect(0, 0, evolution_[i].Lt.cols, evolution_[i].Lt.rows));
+
+  if (options_.engine == ENGINE_FIXED) {
+    TEvolution& e = evolution_[i];
+    cv::Mat dx_kx, dx_ky, dy_kx, dy_ky;
+    compute_fixed_derivative_kernels(dx_kx, dx_ky, 1, 0, sigma_size_);
+    compute_fixed_derivative_kernels(dy_kx, dy_ky, 0, 1, sigma_size_);
+    const int second_shift = fixed_tap_bits + 2;
+
+    kernels_->fixed_sep_filter(e.Lx_q, e.Lxx_q, dx_kx, dx_ky, second_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    kernels_->fixed_sep_filter(e.Ly_q, e.Lyy_q, dy_kx, dy_ky, second_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    kernels_->fixed_sep_filter(e.Lx_q, e.Lxy_q, dy_kx, dy_ky, second_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    return;
+  }
+
+  // The sparse detector computes the second order derivatives on its tiles
+  if (options_.sparse_detector == true)
+    return;
+
+  kernels_->compute_scharr_derivatives(evolution_[i].Lx, evolution_[i].Lxx, 1, 0, sigma_size_);
+  kernels_->compute_scharr_derivatives(evolution_[i].Ly, evolution_[i].Lyy, 0, 1, sigma_size_);
+  kernels_->compute_scharr_derivatives(evolution_[i].Lx, evolution_[i].Lxy, 0, 1, sigma_size_);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Level_First_Derivatives(size_t i) {
+
+  float ratio = pow(2.0f,(float)evolution_[i].octave);
+  int sigma_size_ = fRound(evolution_[i].esigma*options_.derivative_factor/ratio);
+
+  if (options_.engine == ENGINE_FIXED) {
+    TEvolution& e = evolution_[i];
+    cv::Mat dx_kx, dx_ky, dy_kx, dy_ky;
+    compute_fixed_derivative_kernels(dx_kx, dx_ky, 1, 0, sigma_size_);
+    compute_fixed_derivative_kernels(dy_kx, dy_ky, 0, 1, sigma_size_);
+    const int first_shift = fixed_tap_bits + fixed_image_bits + 2 - fixed_derivative_bits;
+
+    kernels_->fixed_sep_filter(e.Lsmooth_q, e.Lx_q, dx_kx, dx_ky, first_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    kernels_->fixed_sep_filter(e.Lsmooth_q, e.Ly_q, dy_kx, dy_ky, first_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    return;
+  }
+
+  kernels_->compute_scharr_derivatives(evolution_[i].Lsmooth, evolution_[i].Lx, 1, 0, sigma_size_);
+  kernels_->compute_scharr_derivatives(evolution_[i].Lsmooth, evolution_[i].Ly, 0, 1, sigma_size_);
+}
+
+/* ************************************************************************* */
+/// Copies the rectangle of the image with a halo of r pixels. The halo out of the image
+/// reflects its borders as the filters of the whole levels do
+static void copy_with_halo(const cv::Mat& img, const cv::Rect& rect, int r, cv::Mat& dst) {
+
+  cv::Rect src = cv::Rect(rect.x-r, rect.y-r, rect.width+2*r, rect.height+2*r) & cv::Rect(0, 0, img.cols, img.rows);
+  const int top = src.y-(rect.y-r), left = src.x-(rect.x-r);
+  const int bottom = (rect.y+rect.height+r)-(src.y+src.height);
+  const int right = (rect.x+rect.width+r)-(src.x+src.width);
+
+  cv::copyMakeBorder(img(src), dst, top, bottom, left, right, cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_First_Derivatives_Rect(size_t i, const cv::Rect& rect) {
+
+  TEvolution& e = evolution_[i];
+  float ratio = pow(2.0f,(float)e.octave);
+  int sigma_size_ = fRound(e.esigma*options_.derivative_factor/ratio);
+  const int r = sigma_size_;
+  cv::Rect inner(r, r, rect.width, rect.height);
+
+  if (options_.engine == ENGINE_FIXED) {
+    cv::Mat dx_kx, dx_ky, dy_kx, dy_ky, Lsmooth_q, Lx_q, Ly_q;
+    compute_fixed_derivative_kernels(dx_kx, dx_ky, 1, 0, sigma_size_);
+    compute_fixed_derivative_kernels(dy_kx, dy_ky, 0, 1, sigma_size_);
+    const int first_shift = fixed_tap_bits + fixed_image_bits + 2 - fixed_derivative_bits;
+
+    copy_with_halo(e.Lsmooth_q, rect, r, Lsmooth_q);
+    kernels_->fixed_sep_filter(Lsmooth_q, Lx_q, dx_kx, dx_ky, first_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+    kernels_->fixed_sep_filter(Lsmooth_q, Ly_q, dy_kx, dy_ky, first_shift,
+                               cv::BORDER_REFLECT_101, detection_threads_);
+
+    cv::Mat Lx_rect = e.Lx_q(rect), Ly_rect = e.Ly_q(rect);
+    Lx_q(inner).copyTo(Lx_rect);
+    Ly_q(inner).copyTo(Ly_rect);
+    return;
+  }
+
+  cv::Mat Lsmooth, Lx, Ly;
+  copy_with_halo(e.Lsmooth, rect, r, Lsmooth);
+  kernels_->compute_scharr_derivatives(Lsmooth, Lx, 1, 0, sigma_size_);
+  kernels_->compute_scharr_derivatives(Lsmooth, Ly, 0, 1, sigma_size_);
+
+  cv::Mat Lx_rect = e.Lx(rect), Ly_rect = e.Ly(rect);
+  Lx(inner).copyTo(Lx_rect);
+  Ly(inner).copyTo(Ly_rect);
+}
+
+/* ************************************************************************* */
+void AKAZE::Convert_Fixed_Derivatives(size_t i, const cv::Rect& rect) {
+
+  // The orientation and the descriptors read the float derivatives
+  cv::Mat Lx_rect = evolution_[i].Lx(rect), Ly_rect = evolution_[i].Ly(rect);
+  evolution_[i].Lx_q(rect).convertTo(Lx_rect, CV_32F, 1.0/(1 << fixed_derivative_bits));
+  evolution_[i].Ly_q(rect).convertTo(Ly_rect, CV_32F, 1.0/(1 << fixed_derivative_bits));
 }
 
 /* ************************************************************************* */
-void AKAZE::Feature_Detection(std::vector<cv::KeyPoint>& kpts) {
+void AKAZE::Convert_To_Half_Storage(size_t i, const cv::Rect& rect) {
+
+  cv::Mat Lt16_rect = evolution_[i].Lt16(rect);
+  cv::Mat Lx16_rect = evolution_[i].Lx16(rect);
+  cv::Mat Ly16_rect = evolution_[i].Ly16(rect);
+  kernels_->convert_to_half(evolution_[i].Lt(rect), Lt16_rect);
+  kernels_->convert_to_half(evolution_[i].Lx(rect), Lx16_rect);
+  kernels_->convert_to_half(evolution_[i].Ly(rect), Ly16_rect);
+}
+
+/* ************************************************************************* */
+void AKAZE::Pack_Descriptor_Plane(size_t i, const cv::Rect& rect) {
+
+  cv::Mat Ldesc_rect = evolution_[i].Ldesc(rect);
+  kernels_->pack_descriptor_plane(evolution_[i].Lt(rect), evolution_[i].Lx(rect),
+                                  evolution_[i].Ly(rect), Ldesc_rect);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Determinant_Hessian_Response() {
+
+  // Firstly compute the multiscale derivatives
+  Compute_Multiscale_Derivatives();
+
+  for (size_t i = 0; i < evolution_.size(); i++)
+    Compute_Level_Hessian_Response(i);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Level_Hessian_Response(size_t i) {
+
+  if (options_.verbosity == true)
+    cout << "Computing detector response. Determinant of Hessian. Evolution time: " << evolution_[i].etime << endl;
+
+  float ratio = pow(2.0f,(float)evolution_[i].octave);
+  int sigma_size = fRound(evolution_[i].esigma*options_.derivative_factor/ratio);
+  int sigma_size_quat = sigma_size*sigma_size*sigma_size*sigma_size;
+
+  if (options_.engine == ENGINE_FIXED)
+    kernels_->fixed_determinant_hessian(evolution_[i].Lxx_q, evolution_[i].Lxy_q, evolution_[i].Lyy_q,
+                                        evolution_[i].Ldet, sigma_size_quat);
+  else if (options_.sparse_detector == true)
+    Compute_Sparse_Hessian_Response(i, sigma_size_quat);
+  else
+    kernels_->compute_determinant_hessian(evolution_[i].Lxx, evolution_[i].Lxy, evolution_[i].Lyy,
+                                          evolution_[i].Ldet, sigma_size_quat);
+
+  // Half precision storage read by the detector and the descriptors
+  if (options_.storage == STORAGE_FP16) {
+    Convert_To_Half_Storage(i, cv::Rect(0, 0, evolution_[i].Lt.cols, evolution_[i].Lt.rows));
+    kernels_->convert_to_half(evolution_[i].Ldet, evolution_[i].Ldet16);
+  }
+}
+
+/* ************************************************************************* */
+/// Size of the tiles of the sparse detector in pixels of the level
+static const int detector_tile = 64;
+
+/* ************************************************************************* */
+void AKAZE::Compute_Sparse_Hessian_Response(size_t i, float scale) {
+
+  TEvolution& e = evolution_[i];
+  float ratio = pow(2.0f,(float)e.octave);
+  const int r = fRound(e.esigma*options_.derivative_factor/ratio);
+  const float threshold = max(options_.dthreshold, options_.min_dthreshold);
+  const cv::Rect level(0, 0, e.Ldet.cols, e.Ldet.rows);
+  const int ntiles_x = (level.width+detector_tile-1)/detector_tile;
+  const int ntiles = ntiles_x*((level.height+detector_tile-1)/detector_tile);
+  vector<char> active(ntiles, 0);
+
+  // Ldet <= |Lxx|*|Lyy|*scale, and the derivative kernels have an L1 norm of at most
+  // one, so |Lxx| and |Lxy| are bounded by the maximum of |Lx| under the filter, and
+  // |Lyy| by that of |Ly|. The tiles whose bound is under the threshold cannot have
+  // extrema. The margin covers the rounding of the filters
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(detection_threads_)
+#endif
+  for (int t = 0; t < ntiles; t++) {
+    cv::Rect tile = cv::Rect((t % ntiles_x)*detector_tile, (t / ntiles_x)*detector_tile,
+                             detector_tile, detector_tile) & level;
+    cv::Rect reach = cv::Rect(tile.x-r, tile.y-r, tile.width+2*r, tile.height+2*r) & level;
+    double bound = cv::norm(e.Lx(reach), cv::NORM_INF)*cv::norm(e.Ly(reach), cv::NORM_INF)*scale;
+    active[t] = (1.01*bound > threshold);
+  }
 
-  double t1 = 0.0, t2 = 0.0;
+  vector<cv::Rect> tiles;
+  for (int t = 0; t < ntiles; t++) {
+    if (active[t] != 0)
+      tiles.push_back(cv::Rect((t % ntiles_x)*detector_tile, (t / ntiles_x)*detector_tile,
+                               detector_tile, detector_tile) & level);
+  }
 
-  t1 = cv::getTickCount();
+  e.Ldet = cv::Scalar(0);
 
-  vector<cv::KeyPoint>().swap(kpts);
-  Compute_Determinant_Hessian_Response();
-  Find_Scale_Space_Extrema(kpts);
-  Do_Subpixel_Refinement(kpts);
+  // Every tile is computed with one pixel more on every side, read by the subpixel
+  // refinement of the keypoints on its borders
+  vector<cv::Mat> ldet_tiles(tiles.size());
 
-  t2 = cv::getTickCount();
-  timing_.detector = 1000.0*(t2-t1) / cv::getTickFrequency();
-}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(detection_threads_)
+#endif
+  for (int t = 0; t < (int)tiles.size(); t++) {
+    cv::Rect ext = cv::Rect(tiles[t].x-1, tiles[t].y-1, tiles[t].width+2, tiles[t].height+2) & level;
+    Compute_Hessian_Rect(i, ext, scale, ldet_tiles[t]);
 
-/* ************************************************************************* */
-void AKAZE::Compute_Multiscale_Derivatives() {
+    cv::Mat Ldet_tile = e.Ldet(tiles[t]);
+    cv::Rect inner(tiles[t].x-ext.x, tiles[t].y-ext.y, tiles[t].width, tiles[t].height);
+    ldet_tiles[t](inner).copyTo(Ldet_tile);
+  }
 
-  double t1 = 0.0, t2 = 0.0;
+  // The borders may belong to the neighbour tiles, so they are written after all of them
+  for (size_t t = 0; t < tiles.size(); t++) {
+    cv::Rect ext = cv::Rect(tiles[t].x-1, tiles[t].y-1, tiles[t].width+2, tiles[t].height+2) & level;
+    cv::Mat Ldet_ext = e.Ldet(ext);
+    const int top = tiles[t].y-ext.y, left = tiles[t].x-ext.x;
+    const int bottom = ext.height-tiles[t].height-top, right = ext.width-tiles[t].width-left;
 
-  t1 = cv::getTickCount();
+    for (int y = 0; y < ext.height; y++) {
+      const float* src = ldet_tiles[t].ptr<float>(y);
+      float* dst = Ldet_ext.ptr<float>(y);
 
-#ifdef _OPENMP
-  omp_set_num_threads(OMP_MAX_THREADS);
-#pragma omp parallel for
-#endif
+      if (y < top || y >= ext.height-bottom) {
+        memcpy(dst, src, ext.width*sizeof(float));
+      }
+      else {
+        if (left > 0)
+          dst[0] = src[0];
+        if (right > 0)
+          dst[ext.width-1] = src[ext.width-1];
+      }
+    }
+  }
+}
 
-  for (int i = 0; i < (int) evolution_.size(); i++) {
+/* ************************************************************************* */
+void AKAZE::Compute_Hessian_Rect(size_t i, const cv::Rect& rect, float scale, cv::Mat& Ldet) {
+
+  TEvolution& e = evolution_[i];
+  float ratio = pow(2.0f,(float)e.octave);
+  const int r = fRound(e.esigma*options_.derivative_factor/ratio);
+  cv::Rect inner(r, r, rect.width, rect.height);
+
+  cv::Mat Lx, Ly, Lxx, Lxy, Lyy;
+  copy_with_halo(e.Lx, rect, r, Lx);
+  copy_with_halo(e.Ly, rect, r, Ly);
+  kernels_->compute_scharr_derivatives(Lx, Lxx, 1, 0, r);
+  kernels_->compute_scharr_derivatives(Ly, Lyy, 0, 1, r);
+  kernels_->compute_scharr_derivatives(Lx, Lxy, 0, 1, r);
+
+  Ldet.create(rect.size(), CV_32F);
+  kernels_->compute_determinant_hessian(Lxx(inner), Lxy(inner), Lyy(inner), Ldet, scale);
+}
 
-    float ratio = pow(2.0f,(float)evolution_[i].octave);
-    int sigma_size_ = fRound(evolution_[i].esigma*options_.derivative_factor/ratio);
+/* ************************************************************************* */
+/// Radius of the descriptor windows in units of the scale of the keypoints
+static float descriptor_max_scale(const AKAZEOptions& options) {
 
-    compute_scharr_derivatives(evolution_[i].Lsmooth, evolution_[i].Lx, 1, 0, sigma_size_);
-    compute_scharr_derivatives(evolution_[i].Lsmooth, evolution_[i].Ly, 0, 1, sigma_size_);
-    compute_scharr_derivatives(evolution_[i].Lx, evolution_[i].Lxx, 1, 0, sigma_size_);
-    compute_scharr_derivatives(evolution_[i].Ly, evolution_[i].Lyy, 0, 1, sigma_size_);
-    compute_scharr_derivatives(evolution_[i].Lx, evolution_[i].Lxy, 0, 1, sigma_size_);
+  vector<DESCRIPTOR_TYPE> types = descriptor_types(options);
+  for (size_t t = 0; t < types.size(); t++) {
+    if (types[t] == MSURF_UPRIGHT || types[t] == MSURF)
+      return 12.0*sqrtf(2.0f);
   }
 
-  t2 = cv::getTickCount();
-  timing_.derivatives = 1000.0*(t2-t1) / cv::getTickFrequency();
+  return 10.0*sqrtf(2.0f);
 }
 
 /* ************************************************************************* */
-void AKAZE::Compute_Determinant_Hessian_Response() {
+void AKAZE::Find_Level_Extrema(size_t i) {
 
-  // Firstly compute the multiscale derivatives
-  Compute_Multiscale_Derivatives();
+  float value = 0.0, ratio = 0.0, smax = 0.0;
+  int sigma_size_ = 0, left_x = 0, right_x = 0, up_y = 0, down_y = 0;
+  cv::KeyPoint point;
+  vector<cv::KeyPoint>& candidates = level_extrema_[i];
 
-  for (size_t i = 0; i < evolution_.size(); i++) {
+  candidates.clear();
 
-    if (options_.verbosity == true)
-      cout << "Computing detector response. Determinant of Hessian. Evolution time: " << evolution_[i].etime << endl;
+  // Set maximum size
+  smax = descriptor_max_scale(options_);
 
-    float ratio = pow(2.0f,(float)evolution_[i].octave);
-    int sigma_size = fRound(evolution_[i].esigma*options_.derivative_factor/ratio);
-    int sigma_size_quat = sigma_size*sigma_size*sigma_size*sigma_size;
+  // Rows of the detector response converted from half precision
+  const bool half_storage = (options_.storage == STORAGE_FP16);
+  vector<float> ldet_rows;
 
-    for (int ix = 0; ix < evolution_[i].Ldet.rows; ix++) {
-      const float* lxx = evolution_[i].Lxx.ptr<float>(ix);
-      const float* lxy = evolution_[i].Lxy.ptr<float>(ix);
-      const float* lyy = evolution_[i].Lyy.ptr<float>(ix);
-      float* ldet = evolution_[i].Ldet.ptr<float>(ix);
-      for (int jx = 0; jx < evolution_[i].Ldet.cols; jx++)
-        ldet[jx] = (lxx[jx]*lyy[jx]-lxy[jx]*lxy[jx])*sigma_size_quat;
-    }
+  const int ncols = evolution_[i].Ldet.cols;
+  if (half_storage == true) {
+    ldet_rows.resize(3*ncols);
+    kernels_->convert_from_half(evolution_[i].Ldet16.ptr<unsigned short>(0), &ldet_rows[0], ncols);
+    kernels_->convert_from_half(evolution_[i].Ldet16.ptr<unsigned short>(1), &ldet_rows[ncols], ncols);
   }
+
+  for (int ix = 1; ix < evolution_[i].Ldet.rows-1; ix++) {
+
+    float* ldet_m = NULL;
+    float* ldet = NULL;
+    float* ldet_p = NULL;
+
+    if (half_storage == true) {
+      ldet_m = &ldet_rows[((ix-1)%3)*ncols];
+      ldet = &ldet_rows[(ix%3)*ncols];
+      ldet_p = &ldet_rows[((ix+1)%3)*ncols];
+      kernels_->convert_from_half(evolution_[i].Ldet16.ptr<unsigned short>(ix+1), ldet_p, ncols);
+    }
+    else {
+      ldet_m = evolution_[i].Ldet.ptr<float>(ix-1);
+      ldet = evolution_[i].Ldet.ptr<float>(ix);
+      ldet_p = evolution_[i].Ldet.ptr<float>(ix+1);
+    }
+
+    for (int jx = 1; jx < evolution_[i].Ldet.cols-1; jx++) {
+
+      value = ldet[jx];
+
+      // Filter the points with the detector threshold
+      if (value > options_.dthreshold && value >= options_.min_dthreshold &&
+          value > ldet[jx-1] && value > ldet[jx+1] &&
+          value > ldet_m[jx-1] && value > ldet_m[jx] && value > ldet_m[jx+1] &&
+          value > ldet_p[jx-1] && value > ldet_p[jx] && value > ldet_p[jx+1]) {
+
+        point.response = fabs(value);
+        point.size = evolution_[i].esigma*options_.derivative_factor;
+        point.octave = evolution_[i].octave;
+        point.class_id = i;
+        ratio = pow(2.0f, point.octave);
+        sigma_size_ = fRound(point.size/ratio);
+        point.pt.x = jx;
+        point.pt.y = ix;
+
+        // Check that the point is under the image limits for the descriptor computation
+        left_x = fRound(point.pt.x-smax*sigma_size_)-1;
+        right_x = fRound(point.pt.x+smax*sigma_size_) +1;
+        up_y = fRound(point.pt.y-smax*sigma_size_)-1;
+        down_y = fRound(point.pt.y+smax*sigma_size_)+1;
+
+        if (left_x >= 0 && right_x < evolution_[i].Ldet.cols &&
+            up_y >= 0 && down_y < evolution_[i].Ldet.rows) {
+          candidates.push_back(point);
+        }
+      }
+    } // for jx
+  } // for ix
 }
 
 /* ************************************************************************* */
 void AKAZE::Find_Scale_Space_Extrema(std::vector<cv::KeyPoint>& kpts) {
 
   double t1 = 0.0, t2 = 0.0;
-  float value = 0.0;
-  float dist = 0.0, ratio = 0.0, smax = 0.0;
+  float dist = 0.0, ratio = 0.0;
   int npoints = 0, id_repeated = 0;
-  int sigma_size_ = 0, left_x = 0, right_x = 0, up_y = 0, down_y = 0;
-  bool is_extremum = false, is_repeated = false, is_out = false;
+  bool is_extremum = false, is_repeated = false;
   cv::KeyPoint point;
   vector<cv::KeyPoint> kpts_aux;
 
-  // Set maximum size
-  if (options_.descriptor == SURF_UPRIGHT || options_.descriptor == SURF ||
-      options_.descriptor == MLDB_UPRIGHT || options_.descriptor == MLDB) {
-    smax = 10.0*sqrtf(2.0f);
-  }
-  else if (options_.descriptor == MSURF_UPRIGHT || options_.descriptor == MSURF) {
-    smax = 12.0*sqrtf(2.0f);
-  }
-
   t1 = cv::getTickCount();
 
+  // The candidates of every level are independent. The pipelined scale space
+  // already found them
+  if (detects_with_scale_space(options_) == false) {
+#ifdef _OPENMP
+    omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < (int)evolution_.size(); i++)
+      Find_Level_Extrema(i);
+  }
+
+  // Compare the candidates with the same and lower scale, in the order of the levels
   for (size_t i = 0; i < evolution_.size(); i++) {
-    for (int ix = 1; ix < evolution_[i].Ldet.rows-1; ix++) {
-
-      float* ldet_m = evolution_[i].Ldet.ptr<float>(ix-1);
-      float* ldet = evolution_[i].Ldet.ptr<float>(ix);
-      float* ldet_p = evolution_[i].Ldet.ptr<float>(ix+1);
-
-      for (int jx = 1; jx < evolution_[i].Ldet.cols-1; jx++) {
-
-        is_extremum = false;
-        is_repeated = false;
-        is_out = false;
-        value = ldet[jx];
-
-        // Filter the points with the detector threshold
-        if (value > options_.dthreshold && value >= options_.min_dthreshold &&
-            value > ldet[jx-1] && value > ldet[jx+1] &&
-            value > ldet_m[jx-1] && value > ldet_m[jx] && value > ldet_m[jx+1] &&
-            value > ldet_p[jx-1] && value > ldet_p[jx] && value > ldet_p[jx+1]) {
-
-          is_extremum = true;
-          point.response = fabs(value);
-          point.size = evolution_[i].esigma*options_.derivative_factor;
-          point.octave = evolution_[i].octave;
-          point.class_id = i;
-          ratio = pow(2.0f, point.octave);
-          sigma_size_ = fRound(point.size/ratio);
-          point.pt.x = jx;
-          point.pt.y = ix;
-
-          // Compare response with the same and lower scale
-          for (size_t ik = 0; ik < kpts_aux.size(); ik++) {
-
-            if ((point.class_id-1) == kpts_aux[ik].class_id ||
-                point.class_id == kpts_aux[ik].class_id) {
-
-              dist = (point.pt.x*ratio-kpts_aux[ik].pt.x)*(point.pt.x*ratio-kpts_aux[ik].pt.x) +
-                     (point.pt.y*ratio-kpts_aux[ik].pt.y)*(point.pt.y*ratio-kpts_aux[ik].pt.y);
-
-              if (dist <= point.size*point.size) {
-                if (point.response > kpts_aux[ik].response) {
-                  id_repeated = ik;
-                  is_repeated = true;
-                }
-                else {
-                  is_extremum = false;
-                }
-                break;
-              }
-            }
-          }
+    for (size_t k = 0; k < level_extrema_[i].size(); k++) {
+
+      is_extremum = true;
+      is_repeated = false;
+      point = level_extrema_[i][k];
+      ratio = pow(2.0f, point.octave);
+
+      for (size_t ik = 0; ik < kpts_aux.size(); ik++) {
 
-          // Check out of bounds
-          if (is_extremum == true) {
+        if ((point.class_id-1) == kpts_aux[ik].class_id ||
+            point.class_id == kpts_aux[ik].class_id) {
 
-            // Check that the point is under the image limits for the descriptor computation
-            left_x = fRound(point.pt.x-smax*sigma_size_)-1;
-            right_x = fRound(point.pt.x+smax*sigma_size_) +1;
-            up_y = fRound(point.pt.y-smax*sigma_size_)-1;
-            down_y = fRound(point.pt.y+smax*sigma_size_)+1;
+          dist = (point.pt.x*ratio-kpts_aux[ik].pt.x)*(point.pt.x*ratio-kpts_aux[ik].pt.x) +
+                 (point.pt.y*ratio-kpts_aux[ik].pt.y)*(point.pt.y*ratio-kpts_aux[ik].pt.y);
 
-            if (left_x < 0 || right_x >= evolution_[i].Ldet.cols ||
-                up_y < 0 || down_y >= evolution_[i].Ldet.rows) {
-              is_out = true;
+          if (dist <= point.size*point.size) {
+            if (point.response > kpts_aux[ik].response) {
+              id_repeated = ik;
+              is_repeated = true;
             }
+            else {
+              is_extremum = false;
+            }
+            break;
+          }
+        }
+      }
 
-            if (is_out == false) {
-              if (is_repeated == false) {
-                point.pt.x = point.pt.x*ratio + .5*(ratio-1.0);
-                point.pt.y = point.pt.y*ratio + .5*(ratio-1.0);
-                kpts_aux.push_back(point);
-                npoints++;
-              }
-              else {
-                point.pt.x = point.pt.x*ratio + .5*(ratio-1.0);
-                point.pt.y = point.pt.y*ratio + .5*(ratio-1.0);
-                kpts_aux[id_repeated] = point;
-              }
-            } // if is_out
-          } //if is_extremum
+      if (is_extremum == true) {
+        point.pt.x = point.pt.x*ratio + .5*(ratio-1.0);
+        point.pt.y = point.pt.y*ratio + .5*(ratio-1.0);
+
+        if (is_repeated == false) {
+          kpts_aux.push_back(point);
+          npoints++;
+        }
+        else {
+          kpts_aux[id_repeated] = point;
         }
-      } // for jx
-    } // for ix
-  } // for i
+      }
+    }
+  }
 
   // Now filter points with the upper scale level
   for (size_t i = 0; i < kpts_aux.size(); i++) {
@@ -395,25 +1492,24 @@ void AKAZE::Do_Subpixel_Refinement(std::vector<cv::KeyPoint>& kpts) {
     x = fRound(kpts[i].pt.x/ratio);
     y = fRound(kpts[i].pt.y/ratio);
 
+    // 3x3 neighbourhood of the detector response, from its half precision storage if needed
+    const TEvolution& e = evolution_[kpts[i].class_id];
+    float ldet[3][3];
+    for (int k = 0; k < 3; k++) {
+      if (options_.storage == STORAGE_FP16)
+        kernels_->convert_from_half(e.Ldet16.ptr<unsigned short>(y+k-1) + x-1, ldet[k], 3);
+      else
+        memcpy(ldet[k], e.Ldet.ptr<float>(y+k-1) + x-1, 3*sizeof(float));
+    }
+
     // Compute the gradient
-    Dx = (0.5)*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x+1)
-        -*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x-1));
-    Dy = (0.5)*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y+1)+x)
-        -*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y-1)+x));
+    Dx = (0.5)*(ldet[1][2]-ldet[1][0]);
+    Dy = (0.5)*(ldet[2][1]-ldet[0][1]);
 
     // Compute the Hessian
-    Dxx = (*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x+1)
-        + *(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x-1)
-        -2.0*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x)));
-
-    Dyy = (*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y+1)+x)
-        + *(evolution_[kpts[i].class_id].Ldet.ptr<float>(y-1)+x)
-        -2.0*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y)+x)));
-
-    Dxy = (0.25)*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y+1)+x+1)
-        +(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y-1)+x-1)))
-        -(0.25)*(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y-1)+x+1)
-        +(*(evolution_[kpts[i].class_id].Ldet.ptr<float>(y+1)+x-1)));
+    Dxx = (ldet[1][2] + ldet[1][0] - 2.0*ldet[1][1]);
+    Dyy = (ldet[2][1] + ldet[0][1] - 2.0*ldet[1][1]);
+    Dxy = (0.25)*(ldet[2][2] + ldet[0][0]) - (0.25)*(ldet[0][2] + ldet[2][0]);
 
     // Solve the linear system
     A(0,0) = Dxx;
@@ -446,6 +1542,53 @@ void AKAZE::Do_Subpixel_Refinement(std::vector<cv::KeyPoint>& kpts) {
   timing_.subpixel = 1000.0*(t2-t1) / cv::getTickFrequency();
 }
 
+/* ************************************************************************* */
+/// Returns a zeroed matrix for nrows binary descriptors of nbytes bytes. With padding, the
+/// rows are padded to a multiple of 64 bytes and the first one starts at a 64 byte boundary
+static cv::Mat allocate_binary_descriptors(int nrows, int nbytes, bool padding) {
+
+  if (padding == false)
+    return cv::Mat::zeros(nrows, nbytes, CV_8UC1);
+
+  const int step = 64*((nbytes + 63)/64);
+  if (nrows == 0)
+    return cv::Mat::zeros(0, step, CV_8UC1);
+
+  // The continuous rows are a reshaped ROI of one longer row, which keeps the reference count
+  cv::Mat buffer = cv::Mat::zeros(1, nrows*step + 64, CV_8UC1);
+  const int offset = (int)((64 - ((size_t)buffer.data & 63)) & 63);
+  return buffer.colRange(offset, offset + nrows*step).reshape(1, nrows);
+}
+
+/* ************************************************************************* */
+/// Replaces the float descriptors of desc by int8 descriptors of int8_descriptor_bytes bytes.
+/// The largest absolute value of every descriptor is mapped to 127
+static void quantize_float_descriptors(cv::Mat& desc) {
+
+  cv::Mat qdesc = cv::Mat::zeros(desc.rows, int8_descriptor_bytes, CV_8SC1);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < desc.rows; i++) {
+    const float* d = desc.ptr<float>(i);
+    signed char* q = qdesc.ptr<signed char>(i);
+
+    float vmax = 0.0f;
+    for (int j = 0; j < 64; j++)
+      vmax = max(vmax, fabsf(d[j]));
+
+    const float inv_factor = (vmax > 0.0f ? 127.0f/vmax : 0.0f);
+    for (int j = 0; j < 64; j++)
+      q[j] = (signed char)floorf(d[j]*inv_factor + 0.5f);
+
+    const float factor = vmax/127.0f;
+    memcpy(q + 64, &factor, sizeof(float));
+  }
+
+  desc = qdesc;
+}
+
 /* ************************************************************************* */
 /**
  * @brief This method  computes the set of descriptors through the nonlinear scale space
@@ -454,114 +1597,670 @@ void AKAZE::Do_Subpixel_Refinement(std::vector<cv::KeyPoint>& kpts) {
 */
 void AKAZE::Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) {
 
+  vector<cv::Mat> descs;
+  Compute_Descriptor_Set(kpts, vector<DESCRIPTOR_TYPE>(1, options_.descriptor), descs);
+  desc = descs[0];
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, std::vector<cv::Mat>& descs) {
+  Compute_Descriptor_Set(kpts, descriptor_types(options_), descs);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Descriptor_Set(std::vector<cv::KeyPoint>& kpts, const std::vector<DESCRIPTOR_TYPE>& types,
+                                   std::vector<cv::Mat>& descs) {
+
   double t1 = 0.0, t2 = 0.0;
 
   t1 = cv::getTickCount();
 
-  // Allocate memory for the matrix with the descriptors
-  if (options_.descriptor < MLDB_UPRIGHT) {
-    desc = cv::Mat::zeros(kpts.size(), 64, CV_32FC1);
+  // Data of the descriptors left for later by the sparse derivatives, and the
+  // interleaved planes of the levels with keypoints
+  vector<char> levels = descriptor_data_pending_;
+  for (size_t k = 0; k < kpts.size(); k++) {
+    const int level = kpts[k].class_id;
+    if (level >= 0 && level < (int)evolution_.size() && descriptor_plane_pending_[level] != 0)
+      levels[level] = 1;
   }
-  else {
-    // We use the full length binary descriptor -> 486 bits
-    if (options_.descriptor_size == 0) {
-      int t = (6+36+120)*options_.descriptor_channels;
-      desc = cv::Mat::zeros(kpts.size(), ceil(t/8.), CV_8UC1);
-    }
-    else {
-      // We use the random bit selection length binary descriptor
-      desc = cv::Mat::zeros(kpts.size(), ceil(options_.descriptor_size/8.), CV_8UC1);
-    }
+
+  if (count(levels.begin(), levels.end(), 1) > 0)
+    Compute_Descriptor_Data(kpts, levels, false);
+
+  bool rotated = false;
+  for (size_t t = 0; t < types.size(); t++) {
+    if (types[t] == SURF || types[t] == MSURF || types[t] == MLDB)
+      rotated = true;
   }
 
-  switch (options_.descriptor) {
+  // The secondary orientations are copies of the keypoints placed after them, so the
+  // orientations are computed before the descriptors
+  const bool secondary = (rotated == true && options_.orientation_ratio > 0.0f);
+  if (secondary == true) {
+    vector<vector<float> > angles(kpts.size());
 
-    case SURF_UPRIGHT : // Upright descriptors, not invariant to rotation
-    {
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Get_SURF_Descriptor_Upright_64(kpts[i],desc.ptr<float>(i));
+    for (int i = 0; i < (int)(kpts.size()); i++)
+      Compute_Orientations(kpts[i], options_.orientation_ratio, angles[i]);
+
+    vector<cv::KeyPoint> kpts_all;
+    for (size_t i = 0; i < kpts.size(); i++) {
+      kpts_all.push_back(kpts[i]);
+      for (size_t k = 0; k < angles[i].size(); k++) {
+        kpts_all.push_back(kpts[i]);
+        kpts_all.back().angle = angles[i][k];
       }
     }
-    break;
-    case SURF :
-    {
+
+    kpts.swap(kpts_all);
+  }
+
+  // Allocate memory for the matrices with the descriptors
+  descs.resize(types.size());
+
+  for (size_t t = 0; t < types.size(); t++) {
+    if (types[t] < MLDB_UPRIGHT) {
+      const int ncomponents = (pca_projection_.empty() ? 64 : pca_projection_.rows);
+      descs[t] = cv::Mat::zeros(kpts.size(), ncomponents, CV_32FC1);
+    }
+    else {
+      // We use the full length binary descriptor -> 486 bits
+      if (options_.descriptor_size == 0) {
+        int nbits = (6+36+120)*options_.descriptor_channels;
+        descs[t] = allocate_binary_descriptors(kpts.size(), ceil(nbits/8.), options_.descriptor_padding);
+      }
+      else {
+        // We use the random bit selection length binary descriptor
+        descs[t] = allocate_binary_descriptors(kpts.size(), ceil(options_.descriptor_size/8.),
+                                               options_.descriptor_padding);
+      }
+    }
+  }
+
+  // Every keypoint is described by all the types while its neighbourhood is in the cache,
+  // with the orientation computed once
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_SURF_Descriptor_64(kpts[i],desc.ptr<float>(i));
+  for (int i = 0; i < (int)(kpts.size()); i++) {
+    if (rotated == true && secondary == false)
+      Compute_Main_Orientation(kpts[i]);
+
+    for (size_t t = 0; t < types.size(); t++) {
+      // The 64 values of the float descriptors are projected before they are stored
+      if (types[t] < MLDB_UPRIGHT && pca_projection_.empty() == false) {
+        float values[64];
+        Get_Descriptor(kpts[i], types[t], (unsigned char*)values);
+        kernels_->pca_projection(values, pca_projection_.ptr<float>(), pca_bias_.ptr<float>(),
+                                 pca_projection_.rows, descs[t].ptr<float>(i));
+      }
+      else {
+        Get_Descriptor(kpts[i], types[t], descs[t].ptr<unsigned char>(i));
       }
     }
+  }
+
+  if (options_.descriptor_int8 == true) {
+    for (size_t t = 0; t < types.size(); t++) {
+      if (types[t] < MLDB_UPRIGHT)
+        quantize_float_descriptors(descs[t]);
+    }
+  }
+
+  t2 = cv::getTickCount();
+  timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
+}
+
+/* ************************************************************************* */
+void AKAZE::Get_Descriptor(const cv::KeyPoint& kpt, DESCRIPTOR_TYPE type, unsigned char* desc) {
+
+  switch (type) {
+    case SURF_UPRIGHT : // Upright descriptors, not invariant to rotation
+      Get_SURF_Descriptor_Upright_64(kpt, (float*)desc);
+    break;
+    case SURF :
+      Get_SURF_Descriptor_64(kpt, (float*)desc);
     break;
     case MSURF_UPRIGHT : // Upright descriptors, not invariant to rotation
-    {
+      Get_MSURF_Upright_Descriptor_64(kpt, (float*)desc);
+    break;
+    case MSURF :
+      Get_MSURF_Descriptor_64(kpt, (float*)desc);
+    break;
+    case MLDB_UPRIGHT : // Upright descriptors, not invariant to rotation
+      if (options_.descriptor_size == 0)
+        Get_Upright_MLDB_Full_Descriptor(kpt, desc);
+      else
+        Get_Upright_MLDB_Descriptor_Subset(kpt, desc);
+    break;
+    case MLDB :
+      if (options_.descriptor_size == 0)
+        Get_MLDB_Full_Descriptor(kpt, desc);
+      else
+        Get_MLDB_Descriptor_Subset(kpt, desc);
+    break;
+  }
+}
+
+/* ************************************************************************* */
+/// Size of the tiles of the sparse derivatives in pixels of the level
+static const int descriptor_tile = 64;
+
+/// State bits of the tiles of the descriptor data
+static const char tile_data_done = 1;
+static const char tile_plane_done = 2;
+
+/* ************************************************************************* */
+void AKAZE::Compute_Descriptor_Data(const std::vector<cv::KeyPoint>& kpts,
+                                    const std::vector<char>& levels, bool derivatives) {
+
+  // The half precision storage of every level is written with the scale space
+  if (options_.storage == STORAGE_FP16)
+    return;
+
+  const float smax = descriptor_max_scale(options_);
+  vector<vector<char> > tiles(evolution_.size());
+
+  // Level and rectangle of every job, with the tile index or -1 for the whole level
+  struct DataJob {
+    int level;
+    int tile;
+    cv::Rect rect;
+  };
+  vector<DataJob> jobs;
+
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    if (levels[i] != 0) {
+      const cv::Mat& Lt = evolution_[i].Lt;
+      const int ntiles = ((Lt.cols+descriptor_tile-1)/descriptor_tile)*((Lt.rows+descriptor_tile-1)/descriptor_tile);
+      tiles[i].assign(ntiles, 0);
+      if ((int)descriptor_tiles_[i].size() != ntiles)
+        descriptor_tiles_[i].assign(ntiles, 0);
+    }
+  }
+
+  // Tiles under the windows of the orientation and the descriptors, with two pixels
+  // of margin for the rounding of the samples
+  for (size_t k = 0; k < kpts.size(); k++) {
+    const int level = kpts[k].class_id;
+    if (level < 0 || level >= (int)evolution_.size() || levels[level] == 0)
+      continue;
+
+    const cv::Mat& Lt = evolution_[level].Lt;
+    const int ntiles_x = (Lt.cols+descriptor_tile-1)/descriptor_tile;
+    const float ratio = pow(2.0f, evolution_[level].octave);
+    const float radius = smax*fRound(0.5*kpts[k].size/ratio) + 2;
+    const float x = kpts[k].pt.x/ratio, y = kpts[k].pt.y/ratio;
+    const int tx0 = max((int)floor((x-radius)/descriptor_tile), 0);
+    const int tx1 = min((int)floor((x+radius)/descriptor_tile), ntiles_x-1);
+    const int ty0 = max((int)floor((y-radius)/descriptor_tile), 0);
+    const int ty1 = min((int)floor((y+radius)/descriptor_tile), (int)tiles[level].size()/ntiles_x-1);
+
+    for (int ty = ty0; ty <= ty1; ty++)
+      for (int tx = tx0; tx <= tx1; tx++)
+        tiles[level][ty*ntiles_x+tx] = 1;
+  }
+
+  // The levels where the keypoints are not sparse are computed at once. Without new
+  // derivatives, the tiles whose data and plane are already computed are skipped
+  for (size_t i = 0; i < evolution_.size(); i++) {
+    if (levels[i] == 0)
+      continue;
+
+    const cv::Mat& Lt = evolution_[i].Lt;
+    const int ntiles_x = (Lt.cols+descriptor_tile-1)/descriptor_tile;
+    const int ntiles = (int)tiles[i].size();
+    char needed = 0;
+    if (descriptor_data_pending_[i] != 0)
+      needed |= tile_data_done;
+    if (descriptor_plane_pending_[i] != 0)
+      needed |= tile_plane_done;
+
+    int nmarked = 0;
+    for (int t = 0; t < ntiles; t++) {
+      if (tiles[i][t] != 0 && derivatives == false && (descriptor_tiles_[i][t] & needed) == needed)
+        tiles[i][t] = 0;
+      nmarked += tiles[i][t];
+    }
+
+    if ((options_.sparse_derivatives == false && derivatives == true) || 2*nmarked > ntiles) {
+      DataJob job = {(int)i, -1, cv::Rect(0, 0, Lt.cols, Lt.rows)};
+      jobs.push_back(job);
+      continue;
+    }
+
+    for (int t = 0; t < ntiles; t++) {
+      if (tiles[i][t] != 0) {
+        cv::Rect tile((t % ntiles_x)*descriptor_tile, (t / ntiles_x)*descriptor_tile,
+                      descriptor_tile, descriptor_tile);
+        DataJob job = {(int)i, t, tile & cv::Rect(0, 0, Lt.cols, Lt.rows)};
+        jobs.push_back(job);
+      }
+    }
+  }
+
 #ifdef _OPENMP
-#pragma omp parallel for
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(dynamic)
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Get_MSURF_Upright_Descriptor_64(kpts[i],desc.ptr<float>(i));
+  for (int j = 0; j < (int)jobs.size(); j++) {
+    const int i = jobs[j].level;
+    const cv::Rect& rect = jobs[j].rect;
+    const char done = (jobs[j].tile < 0 ? 0 : descriptor_tiles_[i][jobs[j].tile]);
+
+    if (derivatives == true) {
+      if (jobs[j].tile < 0)
+        Compute_Level_First_Derivatives(i);
+      else
+        Compute_First_Derivatives_Rect(i, rect);
+    }
+
+    // The copies of the whole levels are already computed without sparse derivatives.
+    // New derivatives are copied and packed again, even on levels already packed
+    if (options_.engine == ENGINE_FIXED &&
+        (derivatives == true || (descriptor_data_pending_[i] != 0 && (done & tile_data_done) == 0)))
+      Convert_Fixed_Derivatives(i, rect);
+
+    if (options_.descriptor_plane == true &&
+        (derivatives == true || (descriptor_plane_pending_[i] != 0 && (done & tile_plane_done) == 0)))
+      Pack_Descriptor_Plane(i, rect);
+
+    if (jobs[j].tile >= 0)
+      descriptor_tiles_[i][jobs[j].tile] = tile_data_done | tile_plane_done;
+  }
+
+  // The flags of a level are only cleared once the whole level is computed
+  for (size_t j = 0; j < jobs.size(); j++) {
+    if (jobs[j].tile < 0) {
+      descriptor_data_pending_[jobs[j].level] = 0;
+      descriptor_plane_pending_[jobs[j].level] = 0;
+      descriptor_tiles_[jobs[j].level].clear();
+    }
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_External_Descriptors(std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) {
+
+  double t1 = 0.0, t2 = 0.0;
+  const float smax = descriptor_max_scale(options_);
+  vector<char> level_used(evolution_.size(), 0);
+  vector<cv::KeyPoint> kpts_aux;
+
+  t1 = cv::getTickCount();
+
+  for (size_t k = 0; k < kpts.size(); k++) {
+    cv::KeyPoint point = kpts[k];
+
+    // Level with the closest scale. The detected keypoints have a diameter of
+    // twice the scale of their level, and the keypoints without size go to the first one
+    if (point.size <= 0)
+      point.size = 2.0*evolution_[0].esigma*options_.derivative_factor;
+
+    int level = 0;
+    float best = FLT_MAX;
+    for (size_t i = 0; i < evolution_.size(); i++) {
+      float level_size = 2.0*evolution_[i].esigma*options_.derivative_factor;
+      float dist = fabs(log(point.size/level_size));
+      if (dist < best) {
+        best = dist;
+        level = i;
       }
     }
-    break;
-    case MSURF :
-    {
+
+    point.class_id = level;
+    point.octave = evolution_[level].octave;
+
+    // The samples of the descriptor must be in the level. Find_Level_Extrema keeps one more
+    // pixel of margin for the subpixel refinement, and the precomputed M-LDB offsets need it
+    // for their rounding
+    float ratio = pow(2.0f, point.octave);
+    int sigma_size_ = fRound(0.5*point.size/ratio);
+    float x = point.pt.x/ratio, y = point.pt.y/ratio;
+    int margin = (mldb_offsets_.empty() ? 0 : 1);
+    int left_x = fRound(x-smax*sigma_size_)-margin;
+    int right_x = fRound(x+smax*sigma_size_)+margin;
+    int up_y = fRound(y-smax*sigma_size_)-margin;
+    int down_y = fRound(y+smax*sigma_size_)+margin;
+
+    if (left_x >= 0 && right_x < evolution_[level].Lt.cols &&
+        up_y >= 0 && down_y < evolution_[level].Lt.rows) {
+      kpts_aux.push_back(point);
+      level_used[level] = 1;
+    }
+  }
+
+  kpts.swap(kpts_aux);
+
+  // Only the levels with keypoints need the derivatives, and their copies
+  Compute_Descriptor_Data(kpts, level_used, true);
+
+  t2 = cv::getTickCount();
+  timing_.derivatives = 1000.0*(t2-t1) / cv::getTickFrequency();
+
+  Compute_Descriptors(kpts, desc);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Dense_Descriptors(size_t level, int stride, std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) {
+
+  CV_Assert(level < evolution_.size() && stride > 0);
+
+  double t1 = 0.0, t2 = 0.0;
+  const TEvolution& e = evolution_[level];
+  vector<char> level_used(evolution_.size(), 0);
+
+  t1 = cv::getTickCount();
+
+  // Grid sites at the integer pixels of the level where the descriptor fits, with the
+  // scale of the level as the detected keypoints
+  const float ratio = (float)(1 << e.octave);
+  const float size = 2.0*e.esigma*options_.derivative_factor;
+  const int scale = fRound(0.5*size/ratio);
+  const int margin = (int)ceil(descriptor_max_scale(options_)*scale) +
+                     (mldb_offsets_.empty() ? 0 : 1);
+
+  kpts.clear();
+  for (int y = margin; y < e.Lt.rows-margin; y += stride) {
+    for (int x = margin; x < e.Lt.cols-margin; x += stride) {
+      cv::KeyPoint point(x*ratio, y*ratio, size, 0.0f, 0.0f, e.octave, (int)level);
+      kpts.push_back(point);
+    }
+  }
+
+  if (kpts.empty() == false)
+    level_used[level] = 1;
+
+  Compute_Descriptor_Data(kpts, level_used, true);
+
+  t2 = cv::getTickCount();
+  timing_.derivatives = 1000.0*(t2-t1) / cv::getTickFrequency();
+
+  if (kpts.empty() == false && options_.descriptor == MLDB_UPRIGHT && options_.descriptor_size == 0) {
+    t1 = cv::getTickCount();
+    Compute_Dense_Upright_MLDB(level, kpts, desc);
+    t2 = cv::getTickCount();
+    timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
+  }
+  else if (kpts.empty() == false && options_.descriptor == MSURF_UPRIGHT) {
+    t1 = cv::getTickCount();
+    Compute_Dense_Upright_MSURF(level, kpts, desc);
+    t2 = cv::getTickCount();
+    timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
+  }
+  else {
+    Compute_Descriptors(kpts, desc);
+  }
+}
+
+/* ************************************************************************* */
+/// Returns the float image of a plane of the evolution, converted from its half precision
+/// storage when the levels only keep that one
+static cv::Mat float_image(const AKAZEKernels& kernels, const cv::Mat& plane, const cv::Mat& half_plane,
+                           bool half) {
+
+  if (half == false)
+    return plane;
+
+  cv::Mat img(half_plane.size(), CV_32F);
+  for (int y = 0; y < img.rows; y++)
+    kernels.convert_from_half(half_plane.ptr<unsigned short>(y), img.ptr<float>(y), img.cols);
+
+  return img;
+}
+
+/* ************************************************************************* */
+/// Weighted sums of src on the lattices of n x n pixels spaced by step, n being the number of
+/// taps: the pixel (y,x) of dst is the sum of taps[a]*taps[b]*src(y+a*step,x+b*step). The
+/// lattices are separable, so the sums along the rows are shared by the n rows of the lattices
+/// that contain them. The pixels whose lattice leaves src are zero
+static void lattice_sums(const cv::Mat& src, const vector<float>& taps, int step, cv::Mat& dst) {
+
+  const int n = (int)taps.size();
+  const int extent = (n-1)*step;
+  const int rows = src.rows-extent, cols = src.cols-extent;
+
+  dst = cv::Mat::zeros(src.rows, src.cols, CV_32F);
+  if (rows <= 0 || cols <= 0)
+    return;
+
+  cv::Mat row_sums = cv::Mat::zeros(src.rows, cols, CV_32F);
+  for (int y = 0; y < src.rows; y++) {
+    const float* s = src.ptr<float>(y);
+    float* r = row_sums.ptr<float>(y);
+    for (int b = 0; b < n; b++) {
+      const float* sb = s + b*step;
+      for (int x = 0; x < cols; x++)
+        r[x] += taps[b]*sb[x];
+    }
+  }
+
+  for (int y = 0; y < rows; y++) {
+    float* d = dst.ptr<float>(y);
+    for (int a = 0; a < n; a++) {
+      const float* r = row_sums.ptr<float>(y+a*step);
+      for (int x = 0; x < cols; x++)
+        d[x] += taps[a]*r[x];
+    }
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Dense_Upright_MLDB(size_t level, const std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) const {
+
+  const int max_channels = 3;
+  CV_Assert(options_.descriptor_channels <= max_channels);
+  const int nchannels = options_.descriptor_channels;
+  const int pattern_size = options_.descriptor_pattern_size;
+  const double size_mult[3] = {1, 2.0/3.0, 1.0/2.0};
+  const TEvolution& e = evolution_[level];
+  const float ratio = (float)(1 << e.octave);
+  const int scale = fRound(0.5f*kpts[0].size/ratio);
+
+  // Channels of the cells: intensity, and the gradient magnitude or the first order derivatives
+  const bool half = (options_.storage == STORAGE_FP16);
+  cv::Mat channels[max_channels];
+  channels[0] = float_image(*kernels_, e.Lt, e.Lt16, half);
+  if (nchannels > 1) {
+    cv::Mat Lx = float_image(*kernels_, e.Lx, e.Lx16, half);
+    cv::Mat Ly = float_image(*kernels_, e.Ly, e.Ly16, half);
+
+    if (nchannels == 2) {
+      channels[1] = cv::Mat(Lx.rows, Lx.cols, CV_32F);
+      for (int y = 0; y < Lx.rows; y++) {
+        const float* lx = Lx.ptr<float>(y);
+        const float* ly = Ly.ptr<float>(y);
+        float* m = channels[1].ptr<float>(y);
+        for (int x = 0; x < Lx.cols; x++)
+          m[x] = sqrtf(lx[x]*lx[x] + ly[x]*ly[x]);
+      }
+    }
+    else {
+      channels[1] = Lx;
+      channels[2] = Ly;
+    }
+  }
+
+  // Sums of the cells of every grid at every pixel, the samples of a cell being spaced by the scale
+  cv::Mat sums[3][max_channels];
+  int sample_steps[3];
+  for (int lvl = 0; lvl < 3; lvl++)
+    sample_steps[lvl] = static_cast<int>(ceil(pattern_size * size_mult[lvl]));
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int j = 0; j < 3*nchannels; j++) {
+    const int lvl = j / nchannels, c = j % nchannels;
+    lattice_sums(channels[c], vector<float>(sample_steps[lvl], 1.0f), scale, sums[lvl][c]);
+  }
+
+  int t = (6+36+120)*nchannels;
+  desc = allocate_binary_descriptors(kpts.size(), ceil(t/8.), options_.descriptor_padding);
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_MSURF_Descriptor_64(kpts[i],desc.ptr<float>(i));
+  for (int k = 0; k < (int)kpts.size(); k++) {
+    const int x = fRound(kpts[k].pt.x/ratio), y = fRound(kpts[k].pt.y/ratio);
+    float values[16*max_channels];
+    int dpos = 0;
+
+    for (int lvl = 0; lvl < 3; lvl++) {
+      const int sample_step = sample_steps[lvl];
+      const float nsamples = (float)(sample_step*sample_step);
+      int val_count = (lvl + 2) * (lvl + 2);
+      int valpos = 0;
+
+      // Same cells as MLDB_Fill_Upright_Values, where i goes along x and j along y
+      for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+        for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+          for (int c = 0; c < nchannels; c++)
+            values[valpos+c] = *(sums[lvl][c].ptr<float>(y+j*scale) + x+i*scale) / nsamples;
+          valpos += nchannels;
+        }
       }
+
+      MLDB_Binary_Comparisons(values, desc.ptr<unsigned char>(k), val_count, dpos);
     }
-    break;
-    case MLDB_UPRIGHT : // Upright descriptors, not invariant to rotation
-    {
+  }
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Dense_Upright_MSURF(size_t level, const std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) const {
+
+  const TEvolution& e = evolution_[level];
+  const float ratio = (float)(1 << e.octave);
+  const int scale = fRound(0.5f*kpts[0].size/ratio);
+
+  // At the integer sites the bilinear samples of the upright M-SURF descriptor fall on the
+  // pixels, and the Gaussian weight of the 9x9 samples of a subregion is separable
+  vector<float> taps(9);
+  for (int a = 0; a < 9; a++)
+    taps[a] = expf(-(5.0f-a)*(5.0f-a)/(2.0f*2.5f*2.5f));
+
+  const bool half = (options_.storage == STORAGE_FP16);
+  cv::Mat channels[4];
+  channels[0] = float_image(*kernels_, e.Lx, e.Lx16, half);
+  channels[1] = float_image(*kernels_, e.Ly, e.Ly16, half);
+  channels[2] = cv::Mat(e.Lx.rows, e.Lx.cols, CV_32F);
+  channels[3] = cv::Mat(e.Ly.rows, e.Ly.cols, CV_32F);
+  for (int y = 0; y < e.Lx.rows; y++) {
+    const float* lx = channels[0].ptr<float>(y);
+    const float* ly = channels[1].ptr<float>(y);
+    float* mx = channels[2].ptr<float>(y);
+    float* my = channels[3].ptr<float>(y);
+    for (int x = 0; x < e.Lx.cols; x++) {
+      mx[x] = fabs(lx[x]);
+      my[x] = fabs(ly[x]);
+    }
+  }
+
+  cv::Mat sums[4];
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        if (options_.descriptor_size == 0)
-          Get_Upright_MLDB_Full_Descriptor(kpts[i], desc.ptr<unsigned char>(i));
-        else
-          Get_Upright_MLDB_Descriptor_Subset(kpts[i], desc.ptr<unsigned char>(i));
-      }
-    }
-    break;
-    case MLDB :
-    {
+  for (int c = 0; c < 4; c++)
+    lattice_sums(channels[c], taps, scale, sums[c]);
+
+  const bool pca = (pca_projection_.empty() == false);
+  desc = cv::Mat::zeros(kpts.size(), (pca ? pca_projection_.rows : 64), CV_32FC1);
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        if (options_.descriptor_size == 0)
-          Get_MLDB_Full_Descriptor(kpts[i], desc.ptr<unsigned char>(i));
-        else
-          Get_MLDB_Descriptor_Subset(kpts[i], desc.ptr<unsigned char>(i));
+  for (int k = 0; k < (int)kpts.size(); k++) {
+    const int x = fRound(kpts[k].pt.x/ratio), y = fRound(kpts[k].pt.y/ratio);
+    float values[64];
+    float* d = (pca ? values : desc.ptr<float>(k));
+    float len = 0.0f;
+
+    for (int ii = 0; ii < 4; ii++) {
+      for (int jj = 0; jj < 4; jj++) {
+        const int y0 = y + (-12+5*ii)*scale, x0 = x + (-12+5*jj)*scale;
+        const float gauss_s2 = gaussian(ii-1.5f, jj-1.5f, 1.5f);
+        float v[4];
+
+        for (int c = 0; c < 4; c++) {
+          v[c] = *(sums[c].ptr<float>(y0) + x0);
+          d[4*(4*ii+jj)+c] = v[c]*gauss_s2;
+        }
+
+        len += (v[0]*v[0] + v[1]*v[1] + v[2]*v[2] + v[3]*v[3])*gauss_s2*gauss_s2;
       }
     }
-    break;
+
+    // convert to unit vector
+    len = sqrt(len);
+
+    for (int i = 0; i < 64; i++)
+      d[i] /= len;
+
+    if (pca)
+      kernels_->pca_projection(values, pca_projection_.ptr<float>(), pca_bias_.ptr<float>(),
+                               pca_projection_.rows, desc.ptr<float>(k));
   }
 
-  t2 = cv::getTickCount();
-  timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
+  if (options_.descriptor_int8 == true)
+    quantize_float_descriptors(desc);
+}
+
+/* ************************************************************************* */
+/// Loads the evolution of the level at (x,y) from the planes read by the samplers
+static inline float load_intensity(const TEvolution& e, SAMPLE_PLANES planes, int x, int y) {
+
+  if (planes == SAMPLE_PLANE)
+    return *(e.Ldesc.ptr<float>(y) + 4*x);
+  else if (planes == SAMPLE_HALF)
+    return half_to_float(*(e.Lt16.ptr<unsigned short>(y)+x));
+
+  return *(e.Lt.ptr<float>(y)+x);
+}
+
+/// Loads the first order derivatives of the level at (x,y) from the planes read by the samplers
+static inline void load_derivatives(const TEvolution& e, SAMPLE_PLANES planes, int x, int y, float& rx, float& ry) {
+
+  if (planes == SAMPLE_PLANE) {
+    const float* p = e.Ldesc.ptr<float>(y) + 4*x;
+    rx = p[1];
+    ry = p[2];
+  }
+  else if (planes == SAMPLE_HALF) {
+    rx = half_to_float(*(e.Lx16.ptr<unsigned short>(y)+x));
+    ry = half_to_float(*(e.Ly16.ptr<unsigned short>(y)+x));
+  }
+  else {
+    rx = *(e.Lx.ptr<float>(y)+x);
+    ry = *(e.Ly.ptr<float>(y)+x);
+  }
 }
 
 /* ************************************************************************* */
 void AKAZE::Compute_Main_Orientation(cv::KeyPoint& kpt) const {
 
+  vector<float> angles;
+  Compute_Orientations(kpt, 0.0f, angles);
+}
+
+/* ************************************************************************* */
+void AKAZE::Compute_Orientations(cv::KeyPoint& kpt, float secondary_ratio, std::vector<float>& angles) const {
+
   int ix = 0, iy = 0, idx = 0, s = 0, level = 0;
-  float xf = 0.0, yf = 0.0, gweight = 0.0, ratio = 0.0;
+  float xf = 0.0, yf = 0.0, gweight = 0.0, ratio = 0.0, rx = 0.0, ry = 0.0;
   float resX[109], resY[109], Ang[109];
   const int id[] = {6,5,4,3,2,1,0,1,2,3,4,5,6};
+  const SAMPLE_PLANES planes = sample_planes(options_);
 
   // Variables for computing the dominant direction
   float sumX = 0.0, sumY = 0.0, max = 0.0, ang1 = 0.0, ang2 = 0.0;
 
+  // Sums of every window, for the secondary orientations
+  const int nwindows = 42;
+  float winX[nwindows], winY[nwindows], winLen[nwindows];
+  int nwin = 0, imax = 0;
+
   // Get the information from the keypoint
   level = kpt.class_id;
   ratio = (float)(1<<evolution_[level].octave);
@@ -577,8 +2276,9 @@ void AKAZE::Compute_Main_Orientation(cv::KeyPoint& kpt) const {
         ix = fRound(xf + i*s);
 
         gweight = gauss25[id[i+6]][id[j+6]];
-        resX[idx] = gweight*(*(evolution_[level].Lx.ptr<float>(iy)+ix));
-        resY[idx] = gweight*(*(evolution_[level].Ly.ptr<float>(iy)+ix));
+        load_derivatives(evolution_[level], planes, ix, iy, rx, ry);
+        resX[idx] = gweight*rx;
+        resY[idx] = gweight*ry;
         Ang[idx] = cv::fastAtan2(resY[idx], resX[idx])*(CV_PI/180.0);
         ++idx;
       }
@@ -611,8 +2311,28 @@ void AKAZE::Compute_Main_Orientation(cv::KeyPoint& kpt) const {
       // store largest orientation
       max = sumX*sumX + sumY*sumY;
       kpt.angle =  cv::fastAtan2(sumY, sumX)*(CV_PI/180.0);
+      imax = nwin;
+    }
+
+    if (nwin < nwindows) {
+      winX[nwin] = sumX;
+      winY[nwin] = sumY;
+      winLen[nwin] = sumX*sumX + sumY*sumY;
+      nwin++;
     }
   }
+
+  // The secondary orientations are the other local maxima of the circular sequence of
+  // windows that are long enough. Squared lengths are compared with the squared ratio
+  angles.clear();
+  if (secondary_ratio <= 0.0f || max <= 0.0f)
+    return;
+
+  for (int k = 0; k < nwin; k++) {
+    const float prev = winLen[(k + nwin - 1) % nwin], next = winLen[(k + 1) % nwin];
+    if (k != imax && winLen[k] >= secondary_ratio*secondary_ratio*max && winLen[k] > prev && winLen[k] >= next)
+      angles.push_back(cv::fastAtan2(winY[k], winX[k])*(CV_PI/180.0));
+  }
 }
 
 /* ************************************************************************* */
@@ -622,6 +2342,8 @@ void AKAZE::Get_SURF_Descriptor_Upright_64(const cv::KeyPoint& kpt, float *desc)
   float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0;
   float fx = 0.0, fy = 0.0, ratio = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
+  float res5 = 0.0, res6 = 0.0, res7 = 0.0, res8 = 0.0;
+  const SAMPLE_PLANES planes = sample_planes(options_);
   int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 0, pattern_size = 0, dcount = 0;
   int scale = 0, dsize = 0, level = 0;
 
@@ -659,17 +2381,12 @@ void AKAZE::Get_SURF_Descriptor_Upright_64(const cv::KeyPoint& kpt, float *desc)
           fx = sample_x-x1;
           fy = sample_y-y1;
 
-          res1 = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Lx.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Lx.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Lx.ptr<float>(y2)+x2);
+          load_derivatives(evolution_[level], planes, x1, y1, res1, res5);
+          load_derivatives(evolution_[level], planes, x2, y1, res2, res6);
+          load_derivatives(evolution_[level], planes, x1, y2, res3, res7);
+          load_derivatives(evolution_[level], planes, x2, y2, res4, res8);
           rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          res1 = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Ly.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Ly.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Ly.ptr<float>(y2)+x2);
-          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+          ry = (1.0-fx)*(1.0-fy)*res5 + fx*(1.0-fy)*res6 + (1.0-fx)*fy*res7 + fx*fy*res8;
 
           // Sum the derivatives to the cumulative descriptor
           dx += rx;
@@ -705,6 +2422,8 @@ void AKAZE::Get_SURF_Descriptor_64(const cv::KeyPoint& kpt, float *desc) const {
   float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0, co = 0.0, si = 0.0, angle = 0.0;
   float fx = 0.0, fy = 0.0, ratio = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
+  float res5 = 0.0, res6 = 0.0, res7 = 0.0, res8 = 0.0;
+  const SAMPLE_PLANES planes = sample_planes(options_);
   int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 0, pattern_size = 0, dcount = 0;
   int scale = 0, dsize = 0, level = 0;
 
@@ -745,17 +2464,12 @@ void AKAZE::Get_SURF_Descriptor_64(const cv::KeyPoint& kpt, float *desc) const {
           fx = sample_x-x1;
           fy = sample_y-y1;
 
-          res1 = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Lx.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Lx.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Lx.ptr<float>(y2)+x2);
+          load_derivatives(evolution_[level], planes, x1, y1, res1, res5);
+          load_derivatives(evolution_[level], planes, x2, y1, res2, res6);
+          load_derivatives(evolution_[level], planes, x1, y2, res3, res7);
+          load_derivatives(evolution_[level], planes, x2, y2, res4, res8);
           rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          res1 = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Ly.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Ly.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Ly.ptr<float>(y2)+x2);
-          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+          ry = (1.0-fx)*(1.0-fy)*res5 + fx*(1.0-fy)*res6 + (1.0-fx)*fy*res7 + fx*fy*res8;
 
           // Get the x and y derivatives on the rotated axis
           rry = rx*co + ry*si;
@@ -790,227 +2504,33 @@ void AKAZE::Get_SURF_Descriptor_64(const cv::KeyPoint& kpt, float *desc) const {
 /* ************************************************************************* */
 void AKAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float *desc) const {
 
-  float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
-  float sample_x = 0.0, sample_y = 0.0;
-  int x1 = 0, y1 = 0, sample_step = 0, pattern_size = 0;
-  int x2 = 0, y2 = 0, kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
-  float fx = 0.0, fy = 0.0, ratio = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
-  int scale = 0, dsize = 0, level = 0;
-
-  // Subregion centers for the 4x4 gaussian weighting
-  float cx = -0.5, cy = 0.5;
-
-  // Set the descriptor size and the sample and pattern sizes
-  dsize = 64;
-  sample_step = 5;
-  pattern_size = 12;
-
   // Get the information from the keypoint
-  ratio = (float)(1<<kpt.octave);
-  scale = fRound(0.5*kpt.size/ratio);
-  level = kpt.class_id;
-  yf = kpt.pt.y/ratio;
-  xf = kpt.pt.x/ratio;
-
-  i = -8;
-
-  // Calculate descriptor for this interest point
-  // Area of size 24 s x 24 s
-  while (i < pattern_size) {
-    j = -8;
-    i = i-4;
-
-    cx += 1.0;
-    cy = -0.5;
-
-    while (j < pattern_size) {
-      dx=dy=mdx=mdy=0.0;
-      cy += 1.0;
-      j = j-4;
-
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      ys = yf + (ky*scale);
-      xs = xf + (kx*scale);
-
-      for (int k = i; k < i+9; k++) {
-        for (int l = j; l < j+9; l++) {
-          sample_y = k*scale + yf;
-          sample_x = l*scale + xf;
-
-          //Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.50*scale);
-
-          y1 = (int)(sample_y-.5);
-          x1 = (int)(sample_x-.5);
-
-          y2 = (int)(sample_y+.5);
-          x2 = (int)(sample_x+.5);
-
-          fx = sample_x-x1;
-          fy = sample_y-y1;
-
-          res1 = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Lx.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Lx.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Lx.ptr<float>(y2)+x2);
-          rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          res1 = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Ly.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Ly.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Ly.ptr<float>(y2)+x2);
-          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          rx = gauss_s1*rx;
-          ry = gauss_s1*ry;
-
-          // Sum the derivatives to the cumulative descriptor
-          dx += rx;
-          dy += ry;
-          mdx += fabs(rx);
-          mdy += fabs(ry);
-        }
-      }
-
-      // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
-
-      desc[dcount++] = dx*gauss_s2;
-      desc[dcount++] = dy*gauss_s2;
-      desc[dcount++] = mdx*gauss_s2;
-      desc[dcount++] = mdy*gauss_s2;
-
-      len += (dx*dx + dy*dy + mdx*mdx + mdy*mdy)*gauss_s2*gauss_s2;
-
-      j += 9;
-    }
-
-    i += 9;
-  }
-
-  // convert to unit vector
-  len = sqrt(len);
-
-  for (int i = 0; i < dsize; i++)
-    desc[i] /= len;
+  const float ratio = (float)(1<<kpt.octave);
+  const int scale = fRound(0.5*kpt.size/ratio);
+  const float yf = kpt.pt.y/ratio;
+  const float xf = kpt.pt.x/ratio;
+
+  // Area of size 24 s x 24 s, sampled by the kernels with the precomputed Gaussian weights
+  msurf_upright_kernel msurf = (options_.storage == STORAGE_FP16 ? kernels_->msurf_upright_descriptor_half :
+                                                                   kernels_->msurf_upright_descriptor);
+  msurf(evolution_[kpt.class_id], desc, xf, yf, scale);
 }
 
 /* ************************************************************************* */
 void AKAZE::Get_MSURF_Descriptor_64(const cv::KeyPoint& kpt, float *desc) const {
 
-  float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
-  float sample_x = 0.0, sample_y = 0.0, co = 0.0, si = 0.0, angle = 0.0;
-  float fx = 0.0, fy = 0.0, ratio = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
-  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 0, pattern_size = 0;
-  int kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
-  int scale = 0, dsize = 0, level = 0;
-
-  // Subregion centers for the 4x4 gaussian weighting
-  float cx = -0.5, cy = 0.5;
-
-  // Set the descriptor size and the sample and pattern sizes
-  dsize = 64;
-  sample_step = 5;
-  pattern_size = 12;
-
   // Get the information from the keypoint
-  ratio = (float)(1<<kpt.octave);
-  scale = fRound(0.5*kpt.size/ratio);
-  angle = kpt.angle;
-  level = kpt.class_id;
-  yf = kpt.pt.y/ratio;
-  xf = kpt.pt.x/ratio;
-  co = cos(angle);
-  si = sin(angle);
-
-  i = -8;
-
-  // Calculate descriptor for this interest point
-  // Area of size 24 s x 24 s
-  while (i < pattern_size) {
-    j = -8;
-    i = i-4;
-
-    cx += 1.0;
-    cy = -0.5;
-
-    while (j < pattern_size) {
-      dx=dy=mdx=mdy=0.0;
-      cy += 1.0;
-      j = j - 4;
-
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      xs = xf + (-kx*scale*si + ky*scale*co);
-      ys = yf + (kx*scale*co + ky*scale*si);
-
-      for (int k = i; k < i + 9; ++k) {
-        for (int l = j; l < j + 9; ++l) {
-          // Get coords of sample point on the rotated axis
-          sample_y = yf + (l*scale*co + k*scale*si);
-          sample_x = xf + (-l*scale*si + k*scale*co);
-
-          // Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.5*scale);
-
-          y1 = fRound(sample_y-.5);
-          x1 = fRound(sample_x-.5);
-
-          y2 = fRound(sample_y+.5);
-          x2 = fRound(sample_x+.5);
-
-          fx = sample_x-x1;
-          fy = sample_y-y1;
-
-          res1 = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Lx.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Lx.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Lx.ptr<float>(y2)+x2);
-          rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          res1 = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-          res2 = *(evolution_[level].Ly.ptr<float>(y1)+x2);
-          res3 = *(evolution_[level].Ly.ptr<float>(y2)+x1);
-          res4 = *(evolution_[level].Ly.ptr<float>(y2)+x2);
-          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
-
-          // Get the x and y derivatives on the rotated axis
-          rry = gauss_s1*(rx*co + ry*si);
-          rrx = gauss_s1*(-rx*si + ry*co);
-
-          // Sum the derivatives to the cumulative descriptor
-          dx += rrx;
-          dy += rry;
-          mdx += fabs(rrx);
-          mdy += fabs(rry);
-        }
-      }
-
-      // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
-      desc[dcount++] = dx*gauss_s2;
-      desc[dcount++] = dy*gauss_s2;
-      desc[dcount++] = mdx*gauss_s2;
-      desc[dcount++] = mdy*gauss_s2;
-
-      len += (dx*dx + dy*dy + mdx*mdx + mdy*mdy)*gauss_s2*gauss_s2;
-
-      j += 9;
-    }
-
-    i += 9;
-  }
-
-  // convert to unit vector
-  len = sqrt(len);
-
-  for (int i = 0; i < dsize; i++)
-    desc[i] /= len;
+  const float ratio = (float)(1<<kpt.octave);
+  const int scale = fRound(0.5*kpt.size/ratio);
+  const float yf = kpt.pt.y/ratio;
+  const float xf = kpt.pt.x/ratio;
+  const float co = cos(kpt.angle);
+  const float si = sin(kpt.angle);
+
+  // Area of size 24 s x 24 s, sampled by the kernels with the precomputed Gaussian weights
+  msurf_kernel msurf = (options_.storage == STORAGE_FP16 ? kernels_->msurf_descriptor_half :
+                                                           kernels_->msurf_descriptor);
+  msurf(evolution_[kpt.class_id], desc, xf, yf, co, si, scale);
 }
 
 /* ************************************************************************* */
@@ -1029,6 +2549,30 @@ void AKAZE::Get_MLDB_Full_Descriptor(const cv::KeyPoint& kpt, unsigned char* des
   float si = sin(kpt.angle);
   int pattern_size = options_.descriptor_pattern_size;
 
+  // Samples at the precomputed offsets of the closest angle bin, around the closest pixel
+  const int nbins = options_.mldb_angle_bins;
+  const int iscale = (int)scale;
+  if (nbins > 0 && iscale >= 1 && iscale <= mldb_table_scales_) {
+    int bin = fRound(kpt.angle*nbins/(2.0*CV_PI)) % nbins;
+    if (bin < 0)
+      bin += nbins;
+    float angle = 2.0*CV_PI*bin/nbins;
+    co = cos(angle);
+    si = sin(angle);
+
+    const short* offsets = &mldb_offsets_[(bin*mldb_table_scales_ + iscale-1)*mldb_table_size_];
+    int dpos = 0;
+    for (int lvl = 0; lvl < 3; lvl++) {
+      int val_count = (lvl + 2) * (lvl + 2);
+      int sample_step = static_cast<int>(ceil(pattern_size * size_mult[lvl]));
+      MLDB_Gather_Values(values, offsets, val_count, sample_step*sample_step, kpt.class_id,
+                         fRound(xf), fRound(yf), co, si);
+      MLDB_Binary_Comparisons(values, desc, val_count, dpos);
+      offsets += 2*val_count*sample_step*sample_step;
+    }
+    return;
+  }
+
   int dpos = 0;
   for(int lvl = 0; lvl < 3; lvl++) {
     int val_count = (lvl + 2) * (lvl + 2);
@@ -1064,138 +2608,37 @@ void AKAZE::Get_Upright_MLDB_Full_Descriptor(const cv::KeyPoint& kpt, unsigned c
 /* ************************************************************************* */
 void AKAZE::MLDB_Fill_Values(float* values, int sample_step, int level,
                              float xf, float yf, float co, float si, float scale) const {
-
-  int pattern_size = options_.descriptor_pattern_size;
-  int nr_channels = options_.descriptor_channels;
-  int valpos = 0;
-
-  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
-    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
-
-      float di = 0.0, dx = 0.0, dy = 0.0;
-      int nsamples = 0;
-
-      for (int k = i; k < i + sample_step; k++) {
-        for (int l = j; l < j + sample_step; l++) {
-
-          float sample_y = yf + (l*co*scale + k*si*scale);
-          float sample_x = xf + (-l*si*scale + k*co*scale);
-
-          int y1 = fRound(sample_y);
-          int x1 = fRound(sample_x);
-
-          float ri = *(evolution_[level].Lt.ptr<float>(y1)+x1);
-          di += ri;
-
-          if(nr_channels > 1) {
-            float rx = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-            float ry = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-            if (nr_channels == 2) {
-              dx += sqrtf(rx*rx + ry*ry);
-            }
-            else {
-              float rry = rx*co + ry*si;
-              float rrx = -rx*si + ry*co;
-              dx += rrx;
-              dy += rry;
-            }
-          }
-          nsamples++;
-        }
-      }
-
-      di /= nsamples;
-      dx /= nsamples;
-      dy /= nsamples;
-
-      values[valpos] = di;
-
-      if (nr_channels > 1)
-        values[valpos + 1] = dx;
-
-      if (nr_channels > 2)
-        values[valpos + 2] = dy;
-
-      valpos += nr_channels;
-    }
-  }
+  mldb_fill_kernel fill = (options_.descriptor_plane == true ? kernels_->mldb_fill_values_plane :
+                           options_.storage == STORAGE_FP16 ? kernels_->mldb_fill_values_half :
+                                                              kernels_->mldb_fill_values);
+  fill(evolution_[level], values, sample_step, options_.descriptor_pattern_size,
+       options_.descriptor_channels, xf, yf, co, si, scale);
 }
 
+/* ************************************************************************* */
+void AKAZE::MLDB_Gather_Values(float* values, const short* offsets, int ncells, int nsamples, int level,
+                               int x0, int y0, float co, float si) const {
+  mldb_gather_kernel gather = (options_.descriptor_plane == true ? kernels_->mldb_gather_values_plane :
+                               options_.storage == STORAGE_FP16 ? kernels_->mldb_gather_values_half :
+                                                                  kernels_->mldb_gather_values);
+  gather(evolution_[level], values, offsets, ncells, nsamples, options_.descriptor_channels,
+         x0, y0, co, si);
+}
 
 /* ************************************************************************* */
 void AKAZE::MLDB_Fill_Upright_Values(float* values, int sample_step, int level,
                                      float xf, float yf, float scale) const {
-
-  int pattern_size = options_.descriptor_pattern_size;
-  int nr_channels = options_.descriptor_channels;
-  int valpos = 0;
-
-  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
-    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
-
-      float di = 0.0, dx = 0.0, dy = 0.0;
-      int nsamples = 0;
-
-      for (int k = i; k < i + sample_step; k++) {
-        for (int l = j; l < j + sample_step; l++) {
-
-          float sample_y = yf + l*scale;
-          float sample_x = xf + k*scale;
-
-          int y1 = fRound(sample_y);
-          int x1 = fRound(sample_x);
-
-          float ri = *(evolution_[level].Lt.ptr<float>(y1)+x1);
-          di += ri;
-
-          if(nr_channels > 1) {
-            float rx = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-            float ry = *(evolution_[level].Ly.ptr<float>(y1)+x1);
-            if (nr_channels == 2) {
-              dx += sqrtf(rx*rx + ry*ry);
-            }
-            else {
-              dx += rx;
-              dy += ry;
-            }
-          }
-          nsamples++;
-        }
-      }
-
-      di /= nsamples;
-      dx /= nsamples;
-      dy /= nsamples;
-
-      values[valpos] = di;
-
-      if (nr_channels > 1)
-        values[valpos + 1] = dx;
-
-      if (nr_channels > 2)
-        values[valpos + 2] = dy;
-
-      valpos += nr_channels;
-    }
-  }
+  mldb_fill_upright_kernel fill = (options_.descriptor_plane == true ? kernels_->mldb_fill_upright_values_plane :
+                                   options_.storage == STORAGE_FP16 ? kernels_->mldb_fill_upright_values_half :
+                                                                      kernels_->mldb_fill_upright_values);
+  fill(evolution_[level], values, sample_step, options_.descriptor_pattern_size,
+       options_.descriptor_channels, xf, yf, scale);
 }
 
 /* ************************************************************************* */
 void AKAZE::MLDB_Binary_Comparisons(float* values, unsigned char* desc,
                                     int count, int& dpos) const {
-
-  int nr_channels = options_.descriptor_channels;
-
-  for(int pos = 0; pos < nr_channels; pos++) {
-    for (int i = 0; i < count; i++) {
-      float ival = values[nr_channels * i + pos];
-      for (int j = i + 1; j < count; j++) {
-        int res = ival > values[nr_channels * j + pos];
-        desc[dpos >> 3] |= (res << (dpos & 7));
-        dpos++;
-      }
-    }
-  }
+  kernels_->mldb_binary_comparisons(values, desc, count, options_.descriptor_channels, dpos);
 }
 
 /* ************************************************************************* */
@@ -1205,6 +2648,7 @@ void AKAZE::Get_MLDB_Descriptor_Subset(const cv::KeyPoint& kpt, unsigned char* d
   float rx = 0.f, ry = 0.f;
   float sample_x = 0.f, sample_y = 0.f;
   int x1 = 0, y1 = 0;
+  const SAMPLE_PLANES planes = sample_planes(options_);
 
   // Get the information from the keypoint
   float ratio = (float)(1<<kpt.octave);
@@ -1242,19 +2686,21 @@ void AKAZE::Get_MLDB_Descriptor_Subset(const cv::KeyPoint& kpt, unsigned char* d
         y1 = fRound(sample_y);
         x1 = fRound(sample_x);
 
-        di += *(evolution_[level].Lt.ptr<float>(y1)+x1);
+        di += load_intensity(evolution_[level], planes, x1, y1);
 
         if (options_.descriptor_channels > 1) {
-          rx = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          ry = *(evolution_[level].Ly.ptr<float>(y1)+x1);
+          load_derivatives(evolution_[level], planes, x1, y1, rx, ry);
 
           if (options_.descriptor_channels == 2) {
             dx += sqrtf(rx*rx + ry*ry);
           }
           else if (options_.descriptor_channels == 3) {
-            // Get the x and y derivatives on the rotated axis
-            dx += rx*co + ry*si;
-            dy += -rx*si + ry*co;
+            // Get the x and y derivatives on the rotated axis, in the channel order of
+            // the full length descriptor, so that the trained bits compare the same values
+            float rdx = 0.f, rdy = 0.f;
+            mldb_rotate_gradient(rx, ry, co, si, rdx, rdy);
+            dx += rdx;
+            dy += rdy;
           }
         }
       }
@@ -1289,6 +2735,7 @@ void AKAZE::Get_Upright_MLDB_Descriptor_Subset(const cv::KeyPoint& kpt, unsigned
   float rx = 0.0f, ry = 0.0f;
   float sample_x = 0.0f, sample_y = 0.0f;
   int x1 = 0, y1 = 0;
+  const SAMPLE_PLANES planes = sample_planes(options_);
 
   // Get the information from the keypoint
   float ratio = (float)(1<<kpt.octave);
@@ -1319,11 +2766,10 @@ void AKAZE::Get_Upright_MLDB_Descriptor_Subset(const cv::KeyPoint& kpt, unsigned
 
         y1 = fRound(sample_y);
         x1 = fRound(sample_x);
-        di += *(evolution_[level].Lt.ptr<float>(y1)+x1);
+        di += load_intensity(evolution_[level], planes, x1, y1);
 
         if (options_.descriptor_channels > 1) {
-          rx = *(evolution_[level].Lx.ptr<float>(y1)+x1);
-          ry = *(evolution_[level].Ly.ptr<float>(y1)+x1);
+          load_derivatives(evolution_[level], planes, x1, y1, rx, ry);
 
           if (options_.descriptor_channels == 2) {
             dx += sqrtf(rx*rx + ry*ry);
@@ -1364,8 +2810,9 @@ void AKAZE::Save_Scale_Space() {
   string outputFile;
 
   for (size_t i = 0; i < evolution_.size(); i++) {
-    convert_scale(evolution_[i].Lt);
-    evolution_[i].Lt.convertTo(img_aux,CV_8U,255.0,0);
+    cv::Mat Lt = float_image(*kernels_, evolution_[i].Lt, evolution_[i].Lt16, options_.storage == STORAGE_FP16);
+    convert_scale(Lt);
+    Lt.convertTo(img_aux,CV_8U,255.0,0);
     outputFile = "../output/evolution_" + to_formatted_string(i, 2) + ".jpg";
     cv::imwrite(outputFile, img_aux);
   }
@@ -1382,8 +2829,10 @@ void AKAZE::Save_Detector_Responses() {
   for (size_t i = 0; i < evolution_.size(); i++) {
     ttime = evolution_[i+1].etime-evolution_[i].etime;
     if (ttime > 0) {
-      convert_scale(evolution_[i].Ldet);
-      evolution_[i].Ldet.convertTo(img_aux,CV_8U,255.0,0);
+      cv::Mat Ldet = float_image(*kernels_, evolution_[i].Ldet, evolution_[i].Ldet16,
+                                 options_.storage == STORAGE_FP16);
+      convert_scale(Ldet);
+      Ldet.convertTo(img_aux,CV_8U,255.0,0);
       outputFile = "../output/images/detector_" + to_formatted_string(nimgs, 2) + ".jpg";
       imwrite(outputFile.c_str(), img_aux);
       nimgs++;
@@ -1506,6 +2955,93 @@ void libAKAZE::generateDescriptorSubsample(cv::Mat& sampleList, cv::Mat& compari
   comparisons = comps.rowRange(0,nbits).clone();
 }
 
+/* ************************************************************************* */
+void libAKAZE::selectDescriptorSubsample(cv::Mat& sampleList, cv::Mat& comparisons, const std::vector<int>& bits,
+                                         int nbits, int pattern_size, int nchannels) {
+
+  CV_Assert(nbits <= (int)bits.size() && "descriptor size can't be bigger than the bit selection table");
+
+  // The full length descriptor has the comparisons of every grid for every channel in turn,
+  // and the cells of a grid are ordered along x and then along y, as in the fill functions
+  vector<int> samples;
+  cv::Mat_<int> comps(nbits, 2);
+
+  for (int b = 0; b < nbits; b++) {
+    int r = bits[b], grid = 0;
+    int gdiv = 2, gsz = 4, npairs = 6;
+
+    while (r >= nchannels*npairs && grid < 2) {
+      r -= nchannels*npairs;
+      grid++;
+      gdiv = grid+2;
+      gsz = gdiv*gdiv;
+      npairs = gsz*(gsz-1)/2;
+    }
+
+    CV_Assert(r < nchannels*npairs && "bit index out of the full descriptor");
+
+    const int channel = r / npairs;
+    int pair = r % npairs, cell1 = 0;
+    while (pair >= gsz-1-cell1) {
+      pair -= gsz-1-cell1;
+      cell1++;
+    }
+    const int cell2 = cell1+1+pair;
+
+    const int psz = ceil(2.*pattern_size/(float)gdiv);
+    const int cells[2] = {cell1, cell2};
+
+    // Samples (grid, x, y) shared by the comparisons
+    for (int c = 0; c < 2; c++) {
+      const int x = psz*(cells[c] / gdiv) - pattern_size, y = psz*(cells[c] % gdiv) - pattern_size;
+      int s = 0;
+      while (3*s < (int)samples.size() &&
+             (samples[3*s] != grid || samples[3*s+1] != x || samples[3*s+2] != y))
+        s++;
+
+      if (3*s == (int)samples.size()) {
+        samples.push_back(grid);
+        samples.push_back(x);
+        samples.push_back(y);
+      }
+
+      comps(b, c) = nchannels*s + channel;
+    }
+  }
+
+  cv::Mat_<int> samplesM((int)samples.size()/3, 3);
+  for (int s = 0; s < samplesM.rows; s++) {
+    samplesM(s, 0) = samples[3*s];
+    samplesM(s, 1) = samples[3*s+1];
+    samplesM(s, 2) = samples[3*s+2];
+  }
+
+  sampleList = samplesM;
+  comparisons = comps;
+}
+
+/* ************************************************************************* */
+void libAKAZE::compute_mldb_sampling_offsets(std::vector<short>& offsets, int pattern_size,
+                                             float co, float si, int scale) {
+
+  const double size_mult[3] = {1, 2.0/3.0, 1.0/2.0};
+
+  for (int lvl = 0; lvl < 3; lvl++) {
+    int sample_step = static_cast<int>(ceil(pattern_size * size_mult[lvl]));
+
+    for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+      for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+        for (int k = i; k < i + sample_step; k++) {
+          for (int l = j; l < j + sample_step; l++) {
+            offsets.push_back((short)floor(-l*si*scale + k*co*scale + 0.5f));
+            offsets.push_back((short)floor(l*co*scale + k*si*scale + 0.5f));
+          }
+        }
+      }
+    }
+  }
+}
+
 /* ************************************************************************* */
 void libAKAZE::check_descriptor_limits(int &x, int &y, int width, int height) {
 
@@ -10,6 +10,7 @@
 
 /* ************************************************************************* */
 #include "AKAZEConfig.h"
+#include "kernels.h"
 #include "fed.h"
 #include "utils.h"
 #include "nldiffusion_functions.h"
@@ -38,9 +39,134 @@ namespace libAKAZE {
     cv::Mat descriptorBits_;
     cv::Mat bitMask_;
 
+    /// PCA basis of the SURF and M-SURF descriptors (pca_basis), one component per row
+    /// with the whitening applied, and the bias of the components (CV_32F)
+    cv::Mat pca_projection_;
+    cv::Mat pca_bias_;
+
+    /// Kernels used for the computations
+    const AKAZEKernels* kernels_;
+
+    /// Single allocation that holds all the matrices of the evolution. The matrices of
+    /// evolution_ do not own their data, see Get_Evolution
+    unsigned char* arena_;
+    size_t arena_size_;
+
+    /// Threads of the teams of the diffusion and of the detection kernels. Both are OMP_MAX_THREADS,
+    /// except in the pipelined scale space, where the two run together and share the budget
+    int diffusion_threads_;
+    int detection_threads_;
+
+    /// Conductance lookup table of the fixed point engine for the current octave
+    std::vector<unsigned short> fixed_lut_;
+
+    /// Candidate extrema of every level, in pixels of the level
+    std::vector<std::vector<cv::KeyPoint> > level_extrema_;
+
+    /// Levels whose data only read by the descriptors (float derivatives of the fixed point
+    /// engine) are not computed on the whole level yet, but around the keypoints
+    std::vector<char> descriptor_data_pending_;
+
+    /// Levels whose interleaved descriptor plane is not built on the whole level yet, with descriptor_plane
+    std::vector<char> descriptor_plane_pending_;
+
+    /// Tiles of every pending level whose descriptor data (bit 0) or plane (bit 1) are already
+    /// computed, so that later keypoints on other tiles compute them too
+    std::vector<std::vector<char> > descriptor_tiles_;
+
+    /// Integer sampling offsets (dx,dy) of the rotated M-LDB grids for every angle bin and
+    /// integer scale from 1 to mldb_table_scales_, with mldb_angle_bins > 0
+    std::vector<short> mldb_offsets_;
+    int mldb_table_scales_;                     ///< Largest integer scale of the offsets table
+    int mldb_table_size_;                       ///< Number of offsets of one angle bin and scale
+
     /// Computation times variables in ms
     AKAZETiming timing_;
 
+    /// The evolution matrices point into the arena, so AKAZE objects cannot be copied
+    AKAZE(const AKAZE&);
+    AKAZE& operator=(const AKAZE&);
+
+    /// This method allocates the arena and sets the matrices of every level of the evolution
+    /// as headers into it. The rows of every matrix start at 64 byte boundaries and are padded.
+    /// Every matrix is the ROI of a larger one, with a guard band of at least one pixel that
+    /// AKAZE fills with the replicated borders for the guarded kernels (e.g. nld_step_guarded)
+    /// @param sizes Size of every level of the evolution
+    void Allocate_Evolution_Arena(const std::vector<cv::Size>& sizes);
+
+    /// This method frees the arena of the evolution
+    void Release_Evolution_Arena();
+
+    /// This method computes the sampling offsets of the rotated M-LDB descriptor for every
+    /// angle bin and for the integer scales of the levels, with mldb_angle_bins > 0
+    void Compute_MLDB_Sampling_Table();
+
+    /// This method computes level i of the nonlinear scale space from level i-1
+    void Compute_Nonlinear_Level(size_t i);
+
+    /// This method computes level i of the nonlinear scale space with the fixed point
+    /// kernels, and converts it to float
+    void Compute_Fixed_Nonlinear_Level(size_t i);
+
+    /// This method computes the levels of the nonlinear scale space in one task, while
+    /// the derivatives, the detector response and the candidate extrema of every level
+    /// are computed in another one as soon as it is diffused
+    void Create_Pipelined_Scale_Space();
+
+    /// This method computes the levels of the nonlinear scale space as a graph of tasks
+    /// over bands of rows, so the next level of an octave starts on a band as soon as the
+    /// rows it reads are final in the previous one
+    void Create_Wavefront_Scale_Space();
+
+    /// This method computes the diffusivity of the rows [y0, y1) of level i from its
+    /// evolution image, which must be final in the rows [y0-3, y1+3)
+    void Compute_Conductivity_Rows(size_t i, int y0, int y1, float kcontrast);
+
+    /// This method computes the diffusivity image for the given contrast factor
+    void Compute_Diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& Lflow, float kcontrast);
+
+    /// This method computes the multiscale derivatives of level i
+    void Compute_Level_Derivatives(size_t i);
+
+    /// This method computes the first order multiscale derivatives Lx and Ly of level i,
+    /// the only ones read by the orientation and the descriptors
+    void Compute_Level_First_Derivatives(size_t i);
+
+    /// This method computes Lx and Ly of level i in the given rectangle only
+    void Compute_First_Derivatives_Rect(size_t i, const cv::Rect& rect);
+
+    /// This method converts the fixed point derivatives of level i to float in the given rectangle
+    void Convert_Fixed_Derivatives(size_t i, const cv::Rect& rect);
+
+    /// This method converts Lt, Lx and Ly of level i to half precision in the given rectangle
+    void Convert_To_Half_Storage(size_t i, const cv::Rect& rect);
+
+    /// This method packs Lt, Lx and Ly of level i into its interleaved descriptor plane in the given rectangle
+    void Pack_Descriptor_Plane(size_t i, const cv::Rect& rect);
+
+    /// This method computes the data read by the descriptors of the keypoints in the given levels:
+    /// the first order derivatives if requested, their float copies and the interleaved planes.
+    /// Only the tiles under the descriptors of the keypoints are computed when they cover at most
+    /// half of the level, unless the whole levels are needed. The computed tiles are recorded, and
+    /// the flags of a level are only cleared when the whole level is computed
+    void Compute_Descriptor_Data(const std::vector<cv::KeyPoint>& kpts,
+                                 const std::vector<char>& levels, bool derivatives);
+
+    /// This method computes the detector response of level i, and its half precision copies
+    void Compute_Level_Hessian_Response(size_t i);
+
+    /// This method computes the detector response of level i only on the tiles where a bound
+    /// from the first order derivatives can be over the detector threshold. The rest is zero
+    void Compute_Sparse_Hessian_Response(size_t i, float scale);
+
+    /// This method computes the detector response of level i in the given rectangle
+    void Compute_Hessian_Rect(size_t i, const cv::Rect& rect, float scale, cv::Mat& Ldet);
+
+    /// This method finds the candidate extrema of level i: maxima of the detector response in
+    /// their 3x3 neighbourhood, over the threshold and far enough from the borders for the
+    /// descriptors. The comparisons with the other levels are done in Find_Scale_Space_Extrema
+    void Find_Level_Extrema(size_t i);
+
   public:
 
     /// AKAZE constructor with input options
@@ -52,10 +178,31 @@ namespace libAKAZE {
     ~AKAZE();
 
     /// Allocate the memory for the nonlinear scale space
+    /// @note All the matrices of the evolution are stored in a single 64 byte aligned arena
     void Allocate_Memory_Evolution();
 
+    /// Returns the size in bytes of the arena that an AKAZE instance allocates for the
+    /// given options, without allocating it
+    static size_t Evolution_Memory_Size(const AKAZEOptions& options);
+
+    /// Returns the size in bytes of the arena of the nonlinear scale space
+    size_t Get_Evolution_Memory_Size() const {
+      return arena_size_;
+    }
+
+    /// This method pins every OpenMP thread to one of the CPUs where the process can run
+    /// @note Only supported on Linux. The calling thread is pinned too
+    void Pin_Threads();
+
+    /// This method writes the matrices of the nonlinear scale space for the first time from the
+    /// threads that process them later, so that the pages are placed in their NUMA nodes
+    /// @note The rows of Lt, Lflow and Lstep are touched as in the FED steps and the
+    /// derivatives of every level by the thread that computes them
+    void First_Touch_Evolution();
+
     /// This method creates the nonlinear scale space for a given image
-    /// @param img Input image for which the nonlinear scale space needs to be created
+    /// @param img Input image for which the nonlinear scale space needs to be created, CV_32F
+    /// of options.img_width x options.img_height pixels
     /// @return 0 if the nonlinear scale space was created successfully, -1 otherwise
     int Create_Nonlinear_Scale_Space(const cv::Mat& img);
 
@@ -76,9 +223,55 @@ namespace libAKAZE {
     /// This method performs subpixel refinement of the detected keypoints fitting a quadratic
     void Do_Subpixel_Refinement(std::vector<cv::KeyPoint>& kpts);
 
-    /// Feature description methods
+    /// Feature description methods. With orientation_ratio > 0 the keypoints with secondary
+    /// orientations are duplicated after them, with one descriptor per copy
     void Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, cv::Mat& desc);
 
+    /// This method computes the descriptor and the extra_descriptors of the options in one
+    /// pass over the keypoints, with the orientation of every keypoint computed once
+    /// @param kpts Keypoints, with their orientation when a descriptor is rotation invariant
+    /// @param descs Matrices of the descriptors, descriptor first and then the types of
+    /// extra_descriptors in increasing order
+    void Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, std::vector<cv::Mat>& descs);
+
+    /// This method computes the descriptors of the given types for every keypoint in turn
+    void Compute_Descriptor_Set(std::vector<cv::KeyPoint>& kpts, const std::vector<DESCRIPTOR_TYPE>& types,
+                                std::vector<cv::Mat>& descs);
+
+    /// This method computes the descriptor of the given type for one keypoint
+    /// @param desc Row of the descriptor, of floats for the SURF types
+    void Get_Descriptor(const cv::KeyPoint& kpt, DESCRIPTOR_TYPE type, unsigned char* desc);
+
+    /// This method computes the descriptors of keypoints from another source, e.g. tracked
+    /// points or another detector, without the detector response and the extrema search
+    /// @param kpts Keypoints in pixels of the input image, with their size as a diameter as in
+    /// OpenCV. Every keypoint is assigned to the level of the closest scale, and the keypoints
+    /// whose descriptor does not fit in that level are removed
+    /// @param desc Matrix to store the descriptors
+    /// @note Only the first order derivatives of the levels with keypoints are computed.
+    /// Create_Nonlinear_Scale_Space must be called before
+    void Compute_External_Descriptors(std::vector<cv::KeyPoint>& kpts, cv::Mat& desc);
+
+    /// This method computes the descriptors on a regular grid of one level of the nonlinear
+    /// scale space, e.g. for image retrieval or dense matching, instead of at the extrema
+    /// @param level Level of the nonlinear scale space
+    /// @param stride Distance between the grid sites in pixels of the level
+    /// @param kpts Keypoints of the grid sites where the descriptor fits in the level, in pixels
+    /// of the input image and with the scale of the level
+    /// @param desc Matrix to store the descriptors
+    /// @note The full length upright M-LDB and the upright M-SURF descriptors share the sums of
+    /// the cells between neighbouring sites. The other descriptors are computed at the sites as
+    /// keypoints. Create_Nonlinear_Scale_Space must be called before
+    void Compute_Dense_Descriptors(size_t level, int stride, std::vector<cv::KeyPoint>& kpts, cv::Mat& desc);
+
+    /// This method computes the full length upright M-LDB descriptors of the grid sites of
+    /// a level from the cell sums of the whole level
+    void Compute_Dense_Upright_MLDB(size_t level, const std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) const;
+
+    /// This method computes the upright M-SURF descriptors of the grid sites of a level from
+    /// the Gaussian weighted subregion sums of the whole level
+    void Compute_Dense_Upright_MSURF(size_t level, const std::vector<cv::KeyPoint>& kpts, cv::Mat& desc) const;
+
     /// This method computes the main orientation for a given keypoint
     /// @param kpt Input keypoint
     /// @note The orientation is computed using a similar approach as described in the original SURF method.
@@ -86,6 +279,13 @@ namespace libAKAZE {
     /// A-KAZE uses first order derivatives computed from the nonlinear scale space in contrast to Haar wavelets
     void Compute_Main_Orientation(cv::KeyPoint& kpt) const;
 
+    /// This method computes the main orientation of the keypoint, and the secondary orientations
+    /// of the other local maxima of the sliding window, in the same pass over the samples
+    /// @param kpt Input keypoint, with the main orientation
+    /// @param secondary_ratio Minimum length of a secondary window relative to the main one
+    /// @param angles Secondary orientations in radians, by increasing window angle
+    void Compute_Orientations(cv::KeyPoint& kpt, float secondary_ratio, std::vector<float>& angles) const;
+
     /// Compute the upright descriptor (not rotation invariant) for the provided keypoint using a
     /// rectangular grid similar as the one used in SURF
     /// @param kpt Input keypoint
@@ -146,6 +346,10 @@ namespace libAKAZE {
     void MLDB_Fill_Values(float* values, int sample_step, int level,
                           float xf, float yf, float co, float si, float scale) const;
 
+    /// Fill the comparison values for the MLDB rotation invariant descriptor at precomputed offsets
+    void MLDB_Gather_Values(float* values, const short* offsets, int ncells, int nsamples, int level,
+                            int x0, int y0, float co, float si) const;
+
     /// Fill the comparison values for the MLDB upright descriptor
     void MLDB_Fill_Upright_Values(float* values, int sample_step, int level,
                                   float xf, float yf, float scale) const;
@@ -166,6 +370,24 @@ namespace libAKAZE {
     AKAZETiming Get_Computation_Times() const {
       return timing_;
     }
+
+    /// Set the kernels used for the computations
+    /// @note By default the AKAZE instance uses active_kernels()
+    void Set_Kernels(const AKAZEKernels& kernels) {
+      kernels_ = &kernels;
+    }
+
+    /// Return the nonlinear scale space
+    /// @note The matrices are headers into the arena of the AKAZE instance, not reference
+    /// counted copies. They are only valid until the instance is destroyed, and they are
+    /// overwritten by the next image. Use Clone_Evolution to keep the scale space
+    const std::vector<TEvolution>& Get_Evolution() const {
+      return evolution_;
+    }
+
+    /// This method copies the nonlinear scale space into matrices that own their data
+    /// @param evolution Deep copy of the evolution, valid after the AKAZE instance is destroyed
+    void Clone_Evolution(std::vector<TEvolution>& evolution) const;
   };
 
   /* ************************************************************************* */
@@ -188,6 +410,29 @@ namespace libAKAZE {
   void generateDescriptorSubsample(cv::Mat& sampleList, cv::Mat& comparisons,
                                    int nbits, int pattern_size, int nchannels);
 
+  /// This function computes the list of samples and comparisons of a bit selection table,
+  /// in the format of generateDescriptorSubsample. Bit i of the descriptor is the comparison
+  /// of bit bits[i] of the full length descriptor
+  /// @param sampleList
+  /// @param comparisons The matrix with the binary comparisons
+  /// @param bits Indices of the selected bits in the full length descriptor, e.g. trained by akaze_train
+  /// @param nbits The number of bits of the descriptor, at most the size of the table
+  /// @param pattern_size The pattern size for the binary descriptor
+  /// @param nchannels Number of channels to consider in the descriptor (1-3)
+  void selectDescriptorSubsample(cv::Mat& sampleList, cv::Mat& comparisons, const std::vector<int>& bits,
+                                 int nbits, int pattern_size, int nchannels);
+
+  /// This function appends the integer sampling offsets (dx,dy) of the three rotated grids of
+  /// the M-LDB descriptor for the angle (co,si) and an integer scale, in the order of the samples
+  /// of the mldb_fill_values kernels
+  /// @param offsets Vector of offsets, two per sample
+  /// @param pattern_size The pattern size for the binary descriptor
+  /// @param co Cosine of the angle
+  /// @param si Sine of the angle
+  /// @param scale Integer scale of the keypoint in pixels of its level
+  void compute_mldb_sampling_offsets(std::vector<short>& offsets, int pattern_size,
+                                     float co, float si, int scale);
+
   /// This function checks descriptor limits for a given keypoint
   inline void check_descriptor_limits(int& x, int& y, int width, int height);
 
@@ -56,6 +56,25 @@ enum DIFFUSIVITY_TYPE {
   CHARBONNIER = 3
 };
 
+/* ************************************************************************* */
+/// Storage of the nonlinear scale space used by the detector and the M-LDB descriptors
+enum EVOLUTION_STORAGE {
+  STORAGE_FP32 = 0,
+  STORAGE_FP16 = 1  ///< Lt, Lx, Ly and Ldet kept only in half precision. Computations are done in float
+};
+
+/* ************************************************************************* */
+/// Arithmetic of the nonlinear scale space, the derivatives and the detector response
+enum EVOLUTION_ENGINE {
+  ENGINE_FLOAT = 0,
+  ENGINE_FIXED = 1  ///< int16 images and int32 accumulators. Lt, Lx, Ly and Ldet are converted to float
+};
+
+/* ************************************************************************* */
+/// Bytes of the SURF and M-SURF descriptors quantized to int8 (descriptor_int8 option):
+/// the 64 values in [-127, 127], followed by the float factor that converts them back
+const int int8_descriptor_bytes = 64 + sizeof(float);
+
 /* ************************************************************************* */
 /// AKAZE Timing structure
 struct AKAZETiming {
@@ -86,6 +105,7 @@ struct AKAZEOptions {
   AKAZEOptions() {
     soffset = 1.6f;
     derivative_factor = 1.5f;
+    omin = 0;
     omax = 4;
     nsublevels = 4;
     dthreshold = 0.001f;
@@ -102,17 +122,35 @@ struct AKAZEOptions {
     kcontrast_percentile = 0.7f;
     kcontrast_nbins = 300;
 
+    pin_threads = false;
+    first_touch = false;
+    huge_pages = false;
+    storage = STORAGE_FP32;
+    engine = ENGINE_FLOAT;
+    pipeline = false;
+    wavefront = false;
+    sparse_derivatives = false;
+    sparse_detector = false;
+    descriptor_plane = false;
+    mldb_angle_bins = 0;
+    extra_descriptors = 0;
+    descriptor_bits = "";
+    descriptor_padding = false;
+    descriptor_int8 = false;
+    pca_basis = "";
+    orientation_ratio = 0.0f;
+
     save_scale_space = false;
     save_keypoints = false;
     show_results = true;
     verbosity = false;
   }
 
-  int omin;                       ///< Initial octave level (-1 means that the size of the input image is duplicated)
+  int omin;                       ///< Initial octave level. For omin > 0 the input image is the original one reduced by 2^omin
   int omax;                       ///< Maximum octave evolution of the image 2^sigma (coarsest scale sigma units)
   int nsublevels;                 ///< Default number of sublevels per scale level
-  int img_width;                  ///< Width of the input image
-  int img_height;                 ///< Height of the input image
+  int img_width;                  ///< Width of the input image (at octave omin)
+  int img_height;                 ///< Height of the input image (at octave omin)
   float soffset;                  ///< Base scale offset (sigma units)
   float derivative_factor;        ///< Factor for the multiscale derivatives
   float sderivatives;             ///< Smoothing factor for the derivatives
@@ -130,6 +168,25 @@ struct AKAZEOptions {
   float kcontrast_percentile;     ///< Percentile level for the contrast factor
   size_t kcontrast_nbins;         ///< Number of bins for the contrast factor histogram
 
+  bool pin_threads;               ///< Set to true for pinning the OpenMP threads to the CPUs (Linux only)
+  bool first_touch;               ///< Set to true for first touching the evolution from the threads that process it
+  bool huge_pages;                ///< Set to true for allocating the evolution on transparent huge pages (Linux only)
+  EVOLUTION_STORAGE storage;      ///< Storage of the evolution read by the detector and the M-LDB descriptors
+  EVOLUTION_ENGINE engine;        ///< Arithmetic of the nonlinear scale space and the detector response
+  bool pipeline;                  ///< Set to true for computing the detector response of every level while the next ones are diffused
+  bool wavefront;                 ///< Set to true for diffusing the levels of an octave by bands of rows as soon as their inputs are final
+  bool sparse_derivatives;        ///< Set to true for computing the data only read by the descriptors around the keypoints
+                                  ///< (fixed point engine with float storage, and the external descriptors)
+  bool sparse_detector;           ///< Set to true for computing the detector response only on the tiles that can have keypoints (float engine)
+  bool descriptor_plane;          ///< Set to true for sampling the descriptors from an interleaved (Lt, Lx, Ly, 0) plane per level
+  int mldb_angle_bins;            ///< Number of angle bins of the precomputed rotated M-LDB sampling offsets. 0 samples at the exact angle
+  int extra_descriptors;          ///< Bit mask (1 << DESCRIPTOR_TYPE) of the descriptors computed together with descriptor, sharing the orientation
+  std::string descriptor_bits;    ///< Bit selection table trained by akaze_train for the M-LDB descriptors with descriptor_size > 0. Empty for the random selection
+  bool descriptor_padding;        ///< Set to true for padding the rows of the binary descriptors with zeros to a multiple of 64 bytes, 64 byte aligned
+  bool descriptor_int8;           ///< Set to true for quantizing the SURF and M-SURF descriptors to int8 values with a scale per descriptor
+  std::string pca_basis;          ///< PCA basis trained by akaze_train that projects the SURF and M-SURF descriptors. Empty for the 64 values
+  float orientation_ratio;        ///< Secondary orientations whose window is longer than this ratio of the main one give duplicated keypoints. 0 for the main orientation only
+
   bool save_scale_space;          ///< Set to true for saving the scale space images
   bool save_keypoints;            ///< Set to true for saving the detected keypoints and descriptors
   bool show_results;              ///< Set to true for displaying results
@@ -143,6 +200,7 @@ struct AKAZEOptions {
   os << std::setw(33) << #option << " =  " << option << std::endl
 
     // Scale-space parameters.
+    CHECK_AKAZE_OPTION(akaze_options.omin);
     CHECK_AKAZE_OPTION(akaze_options.omax);
     CHECK_AKAZE_OPTION(akaze_options.nsublevels);
     CHECK_AKAZE_OPTION(akaze_options.soffset);
@@ -154,6 +212,24 @@ struct AKAZEOptions {
     CHECK_AKAZE_OPTION(akaze_options.descriptor);
     CHECK_AKAZE_OPTION(akaze_options.descriptor_channels);
     CHECK_AKAZE_OPTION(akaze_options.descriptor_size);
+    // Threading parameters.
+    CHECK_AKAZE_OPTION(akaze_options.pin_threads);
+    CHECK_AKAZE_OPTION(akaze_options.first_touch);
+    CHECK_AKAZE_OPTION(akaze_options.huge_pages);
+    CHECK_AKAZE_OPTION(akaze_options.storage);
+    CHECK_AKAZE_OPTION(akaze_options.engine);
+    CHECK_AKAZE_OPTION(akaze_options.pipeline);
+    CHECK_AKAZE_OPTION(akaze_options.wavefront);
+    CHECK_AKAZE_OPTION(akaze_options.sparse_derivatives);
+    CHECK_AKAZE_OPTION(akaze_options.sparse_detector);
+    CHECK_AKAZE_OPTION(akaze_options.descriptor_plane);
+    CHECK_AKAZE_OPTION(akaze_options.mldb_angle_bins);
+    CHECK_AKAZE_OPTION(akaze_options.extra_descriptors);
+    CHECK_AKAZE_OPTION(akaze_options.descriptor_bits);
+    CHECK_AKAZE_OPTION(akaze_options.descriptor_padding);
+    CHECK_AKAZE_OPTION(akaze_options.descriptor_int8);
+    CHECK_AKAZE_OPTION(akaze_options.pca_basis);
+    CHECK_AKAZE_OPTION(akaze_options.orientation_ratio);
     // Save scale-space
     CHECK_AKAZE_OPTION(akaze_options.save_scale_space);
     // Verbose option for debug.
@@ -166,6 +242,8 @@ struct AKAZEOptions {
 
 /* ************************************************************************* */
 /// AKAZE nonlinear diffusion filtering evolution
+/// @note The matrices allocated by the AKAZE class are ROIs with a guard band of at least
+/// one pixel around them. The OpenCV filters are applied with BORDER_ISOLATED
 struct TEvolution {
 
   TEvolution() {
@@ -183,6 +261,13 @@ struct TEvolution {
   cv::Mat Lsmooth;                  ///< Smoothed image
   cv::Mat Lstep;                    ///< Evolution step update
   cv::Mat Ldet;                     ///< Detector response
+  cv::Mat Lt16, Lx16, Ly16, Ldet16; ///< Half precision (CV_16U) levels for STORAGE_FP16. The float
+                                    ///< planes are then shared working sets, valid only while the level is computed
+  cv::Mat Ldesc;                    ///< Interleaved (Lt, Lx, Ly, 0) samples (CV_32FC4) read by the descriptors
+  cv::Mat Lt_q, Lsmooth_q;          ///< Fixed point (CV_16S) evolution and smoothed images for ENGINE_FIXED
+  cv::Mat Lflow_q, Lstep_q;         ///< Fixed point diffusivity and evolution step update
+  cv::Mat Lx_q, Ly_q;               ///< Fixed point first order derivatives
+  cv::Mat Lxx_q, Lxy_q, Lyy_q;      ///< Fixed point second order derivatives
   float etime;                      ///< Evolution time
   float esigma;                     ///< Evolution sigma. For linear diffusion t = sigma^2 / 2
   size_t octave;                    ///< Image octave
@@ -0,0 +1,207 @@
+//=============================================================================
+//
+// kernels.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file kernels.cpp
+ * @brief Table of the hot kernels of the library
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "AKAZE.h"
+
+#include <cstdlib>
+
+#ifdef AKAZE_KERNELS_X86
+#include <cpuid.h>
+#endif
+
+using namespace std;
+using namespace libAKAZE;
+
+/* ************************************************************************* */
+/// The reference kernels do not split the thread budget, they keep their own teams
+static void reference_fixed_sep_filter(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kx,
+                                       const cv::Mat& ky, int shift, int border, int) {
+  reference::fixed_sep_filter(src, dst, kx, ky, shift, border);
+}
+
+/* ************************************************************************* */
+static void reference_nld_step_guarded(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                                       const float stepsize, int) {
+  reference::nld_step_scalar(Ld, c, Lstep, stepsize);
+}
+
+/* ************************************************************************* */
+static void reference_nld_step_fixed_guarded(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                                             const float stepsize, int) {
+  reference::nld_step_fixed(Ld, c, Lstep, stepsize);
+}
+
+/* ************************************************************************* */
+static const AKAZEKernels reference_kernels_ = {
+  "reference",
+  reference::pm_g1,
+  reference::pm_g2,
+  reference::weickert_diffusivity,
+  reference::charbonnier_diffusivity,
+  reference::compute_scharr_derivatives,
+  reference::nld_step_scalar,
+  reference::compute_determinant_hessian,
+  reference::mldb_fill_values,
+  reference::mldb_fill_upright_values,
+  reference::mldb_binary_comparisons,
+  reference::convert_to_half,
+  reference::convert_from_half,
+  reference::mldb_fill_values_half,
+  reference::mldb_fill_upright_values_half,
+  reference::fixed_diffusivity,
+  reference_fixed_sep_filter,
+  reference::nld_step_fixed,
+  reference::fixed_determinant_hessian,
+  reference::nld_flux_rows,
+  reference::pack_descriptor_plane,
+  reference::mldb_fill_values_plane,
+  reference::mldb_fill_upright_values_plane,
+  reference::mldb_gather_values,
+  reference::mldb_gather_values_half,
+  reference::mldb_gather_values_plane,
+  reference::msurf_descriptor,
+  reference::msurf_upright_descriptor,
+  reference::hamming_distances,
+  reference::int8_dot_products,
+  reference::pca_projection,
+  reference_nld_step_guarded,
+  reference_nld_step_fixed_guarded,
+  reference::msurf_descriptor_half,
+  reference::msurf_upright_descriptor_half
+};
+
+static const AKAZEKernels* active_kernels_ = NULL;
+
+/* ************************************************************************* */
+const AKAZEKernels& libAKAZE::reference_kernels() {
+  return reference_kernels_;
+}
+
+#ifdef AKAZE_KERNELS_X86
+/* ************************************************************************* */
+/// Returns true if the OS saves the given state components (XCR0 bits) on context
+/// switches. Without them the AVX registers are not usable even if the CPU has them
+static bool os_saves_state(unsigned int mask) {
+
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & bit_OSXSAVE) == 0)
+    return false;
+
+  unsigned int xcr0_lo = 0, xcr0_hi = 0;
+  __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  return (xcr0_lo & mask) == mask;
+}
+
+/* ************************************************************************* */
+static bool cpu_supports_avx2() {
+  __builtin_cpu_init();
+
+  // SSE and AVX state
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+      __builtin_cpu_supports("f16c") && os_saves_state(0x6);
+}
+
+/* ************************************************************************* */
+static bool cpu_supports_avx512() {
+  __builtin_cpu_init();
+
+  // Opmask and upper ZMM state
+  return cpu_supports_avx2() && os_saves_state(0xe0) &&
+      __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+}
+
+/* ************************************************************************* */
+static bool cpu_supports_avx512vnni() {
+  __builtin_cpu_init();
+  return cpu_supports_avx512() && __builtin_cpu_supports("avx512vnni");
+}
+#endif
+
+/* ************************************************************************* */
+static const AKAZEKernels& select_default_kernels() {
+
+  const char* name = getenv("AKAZE_KERNELS");
+  if (name != NULL && *name != '\0') {
+    const AKAZEKernels* kernels = find_kernels(name);
+    if (kernels != NULL)
+      return *kernels;
+
+    cerr << "Warning: AKAZE_KERNELS=" << name << " is not available in this CPU. "
+         << "Selecting the kernels automatically" << endl;
+  }
+
+  vector<const AKAZEKernels*> kernels;
+  available_kernels(kernels);
+  return *kernels.back();
+}
+
+/* ************************************************************************* */
+const AKAZEKernels& libAKAZE::default_kernels() {
+  static const AKAZEKernels& kernels = select_default_kernels();
+  return kernels;
+}
+
+/* ************************************************************************* */
+const AKAZEKernels* libAKAZE::find_kernels(const std::string& name) {
+
+  if (name == "reference")
+    return &reference_kernels();
+  else if (name == "baseline")
+    return &baseline::kernels();
+#ifdef AKAZE_KERNELS_X86
+  else if (name == "avx2" && cpu_supports_avx2())
+    return &avx2::kernels();
+  else if (name == "avx512" && cpu_supports_avx512())
+    return &avx512::kernels();
+  else if (name == "avx512vnni" && cpu_supports_avx512vnni())
+    return &avx512vnni::kernels();
+#endif
+
+  return NULL;
+}
+
+/* ************************************************************************* */
+void libAKAZE::available_kernels(std::vector<const AKAZEKernels*>& kernels) {
+
+  kernels.clear();
+  kernels.push_back(&baseline::kernels());
+#ifdef AKAZE_KERNELS_X86
+  if (cpu_supports_avx2())
+    kernels.push_back(&avx2::kernels());
+  if (cpu_supports_avx512())
+    kernels.push_back(&avx512::kernels());
+  if (cpu_supports_avx512vnni())
+    kernels.push_back(&avx512vnni::kernels());
+#endif
+}
+
+/* ************************************************************************* */
+const AKAZEKernels& libAKAZE::active_kernels() {
+  if (active_kernels_ == NULL)
+    active_kernels_ = &default_kernels();
+  return *active_kernels_;
+}
+
+/* ************************************************************************* */
+void libAKAZE::set_active_kernels(const AKAZEKernels& kernels) {
+  active_kernels_ = &kernels;
+}
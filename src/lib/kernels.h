@@ -0,0 +1,421 @@
+/**
+ * @file kernels.h
+ * @brief Table of the hot kernels of the library and the scalar reference backend
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#pragma once
+
+/* ************************************************************************* */
+#include "AKAZEConfig.h"
+
+#include <cstring>
+
+/* ************************************************************************* */
+// The AVX2 and AVX-512 kernels are compiled with function target attributes,
+// which are available in GCC (>= 4.9) and Clang for x86 processors
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define AKAZE_KERNELS_X86
+#endif
+
+/* ************************************************************************* */
+namespace libAKAZE {
+
+  /// Conductivity kernel: dst = g(|(Lx,Ly)|, k)
+  typedef void (*diffusivity_kernel)(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k);
+
+  /// Scharr derivatives kernel of a given order and scale
+  typedef void (*scharr_kernel)(const cv::Mat& src, cv::Mat& dst, const size_t xorder,
+                                const size_t yorder, const size_t scale);
+
+  /// Explicit nonlinear diffusion step kernel
+  typedef void (*nld_step_kernel)(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize);
+
+  /// Explicit nonlinear diffusion step kernel of images with a guard band. It reads the one
+  /// pixel guard band around Ld and c, which must already hold their replicated borders, and
+  /// only writes Ld and Lstep. It is meant for the evolution arena (see AKAZE::Allocate_Evolution_Arena).
+  /// The rows are split among nthreads threads
+  typedef void (*nld_step_guarded_kernel)(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                                          const float stepsize, int nthreads);
+
+  /// Explicit nonlinear diffusion flux kernel of the rows [y0, y1) of Lstep. Ld is not updated,
+  /// and Ld and c must have a one pixel guard band with their replicated borders around those rows
+  typedef void (*nld_flux_kernel)(const cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                                  const float stepsize, int y0, int y1);
+
+  /// Determinant of the Hessian kernel: Ldet = (Lxx*Lyy - Lxy*Lxy)*scale
+  typedef void (*hessian_kernel)(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                 cv::Mat& Ldet, const float scale);
+
+  /// M-LDB rotated grid sampling kernel. Fills nchannels values per grid cell with the mean
+  /// of the samples taken every scale pixels around (xf,yf), rotated by the angle (co,si)
+  typedef void (*mldb_fill_kernel)(const TEvolution& e, float* values, int sample_step,
+                                   int pattern_size, int nchannels, float xf, float yf,
+                                   float co, float si, float scale);
+
+  /// M-LDB upright grid sampling kernel
+  typedef void (*mldb_fill_upright_kernel)(const TEvolution& e, float* values, int sample_step,
+                                           int pattern_size, int nchannels, float xf, float yf,
+                                           float scale);
+
+  /// M-LDB binary comparisons kernel between all the pairs of count grid cells. dpos is
+  /// the current bit position in the descriptor and it is updated
+  typedef void (*mldb_comparisons_kernel)(const float* values, unsigned char* desc,
+                                          int count, int nchannels, int& dpos);
+
+  /// Conversion kernel of a float image to half precision (IEEE 754 binary16 values in a CV_16U image)
+  typedef void (*half_store_kernel)(const cv::Mat& src, cv::Mat& dst);
+
+  /// Conversion kernel of n half precision values to float
+  typedef void (*half_load_kernel)(const unsigned short* src, float* dst, int n);
+
+  /// Fixed point conductivity kernel: dst = lut[fixed_lut_index(Lx^2 + Ly^2)]. The derivatives
+  /// have fixed_derivative_bits fractional bits, see compute_fixed_diffusivity_lut
+  typedef void (*fixed_diffusivity_kernel)(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
+                                           const unsigned short* lut);
+
+  /// Fixed point separable filter kernel of CV_16S images. The taps are CV_32S with fixed_tap_bits
+  /// fractional bits, and the product of the L1 norms of kx and ky must not exceed 1. The vertical
+  /// pass keeps 2 more fractional bits than src and the horizontal pass is shifted right by shift bits.
+  /// The rows are split among nthreads threads
+  typedef void (*fixed_filter_kernel)(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kx,
+                                      const cv::Mat& ky, int shift, int border, int nthreads);
+
+  /// Packing kernel of the evolution and its first order derivatives into the interleaved
+  /// (Lt, Lx, Ly, 0) samples of dst, a CV_32FC4 image of the same size
+  typedef void (*plane_pack_kernel)(const cv::Mat& Lt, const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst);
+
+  /// M-LDB table driven sampling kernel. Fills nchannels values for each of the ncells grid cells
+  /// with the mean of its nsamples samples, taken at the integer (dx,dy) offsets around (x0,y0).
+  /// The derivatives are rotated by the angle (co,si) the offsets were computed for
+  typedef void (*mldb_gather_kernel)(const TEvolution& e, float* values, const short* offsets,
+                                     int ncells, int nsamples, int nchannels, int x0, int y0,
+                                     float co, float si);
+
+  /// M-SURF descriptor kernel. Computes the 64 values of the descriptor of the keypoint at (xf,yf)
+  /// of the level, with the integer scale and the orientation (co,si), from the float derivatives
+  /// or from their half precision storage
+  typedef void (*msurf_kernel)(const TEvolution& e, float* desc, float xf, float yf,
+                               float co, float si, int scale);
+
+  /// Upright M-SURF descriptor kernel
+  typedef void (*msurf_upright_kernel)(const TEvolution& e, float* desc, float xf, float yf, int scale);
+
+  /// Hamming distance kernel between the binary descriptor query and every row of train (CV_8U),
+  /// stored in dist. Rows padded with zeros to a multiple of 64 bytes are read with full width loads
+  typedef void (*hamming_kernel)(const unsigned char* query, const cv::Mat& train, int* dist);
+
+  /// Dot product kernel between the 64 int8 values of the descriptor query and the first 64
+  /// values of every row of train (CV_8S), stored in dot. The values must be in [-127, 127]
+  typedef void (*int8_dot_kernel)(const signed char* query, const cv::Mat& train, int* dot);
+
+  /// PCA projection kernel of the 64 values of a float descriptor: dst = projection*src + bias,
+  /// with the ncomponents x 64 projection matrix stored by rows
+  typedef void (*pca_kernel)(const float* src, const float* projection, const float* bias,
+                             int ncomponents, float* dst);
+
+  /// Set of kernels used by the AKAZE class. Every backend provides the same
+  /// functions, so that optimized backends can be checked against the reference one
+  struct AKAZEKernels {
+    const char* name;                                   ///< Name of the backend
+    diffusivity_kernel pm_g1;                           ///< Perona-Malik g1 conductivity
+    diffusivity_kernel pm_g2;                           ///< Perona-Malik g2 conductivity
+    diffusivity_kernel weickert_diffusivity;            ///< Weickert conductivity
+    diffusivity_kernel charbonnier_diffusivity;         ///< Charbonnier conductivity
+    scharr_kernel compute_scharr_derivatives;           ///< Multiscale Scharr derivatives
+    nld_step_kernel nld_step_scalar;                    ///< FED inner step
+    hessian_kernel compute_determinant_hessian;         ///< Detector response
+    mldb_fill_kernel mldb_fill_values;                  ///< M-LDB rotated sampling
+    mldb_fill_upright_kernel mldb_fill_upright_values;  ///< M-LDB upright sampling
+    mldb_comparisons_kernel mldb_binary_comparisons;    ///< M-LDB binary comparisons
+    half_store_kernel convert_to_half;                  ///< Half precision storage
+    half_load_kernel convert_from_half;                 ///< Half precision loads
+    mldb_fill_kernel mldb_fill_values_half;             ///< M-LDB rotated sampling of the half precision planes
+    mldb_fill_upright_kernel mldb_fill_upright_values_half; ///< M-LDB upright sampling of the half precision planes
+    fixed_diffusivity_kernel fixed_diffusivity;         ///< Fixed point conductivity lookup
+    fixed_filter_kernel fixed_sep_filter;               ///< Fixed point Gaussian and Scharr filters
+    nld_step_kernel nld_step_fixed;                     ///< Fixed point FED inner step (CV_16S Ld, c and Lstep)
+    hessian_kernel fixed_determinant_hessian;           ///< Detector response from CV_16S derivatives
+    nld_flux_kernel nld_flux_rows;                      ///< FED inner step of a band of rows, without the update
+    plane_pack_kernel pack_descriptor_plane;            ///< Interleaved descriptor plane
+    mldb_fill_kernel mldb_fill_values_plane;            ///< M-LDB rotated sampling of the interleaved plane
+    mldb_fill_upright_kernel mldb_fill_upright_values_plane; ///< M-LDB upright sampling of the interleaved plane
+    mldb_gather_kernel mldb_gather_values;              ///< M-LDB sampling at precomputed offsets
+    mldb_gather_kernel mldb_gather_values_half;         ///< M-LDB sampling at precomputed offsets of the half precision planes
+    mldb_gather_kernel mldb_gather_values_plane;        ///< M-LDB sampling at precomputed offsets of the interleaved plane
+    msurf_kernel msurf_descriptor;                      ///< M-SURF descriptor
+    msurf_upright_kernel msurf_upright_descriptor;      ///< Upright M-SURF descriptor
+    hamming_kernel hamming_distances;                   ///< Hamming distances of the binary descriptors
+    int8_dot_kernel int8_dot_products;                  ///< Dot products of the int8 descriptors
+    pca_kernel pca_projection;                          ///< PCA projection of the float descriptors
+    nld_step_guarded_kernel nld_step_guarded;           ///< FED inner step of images with a replicated guard band
+    nld_step_guarded_kernel nld_step_fixed_guarded;     ///< Fixed point FED inner step of images with a replicated guard band
+    msurf_kernel msurf_descriptor_half;                 ///< M-SURF descriptor of the half precision derivatives
+    msurf_upright_kernel msurf_upright_descriptor_half; ///< Upright M-SURF descriptor of the half precision derivatives
+  };
+
+  /* ************************************************************************* */
+  /// Portable conversion of a float to half precision, rounding to the nearest even value
+  inline unsigned short float_to_half(float value) {
+
+    unsigned int f = 0;
+    memcpy(&f, &value, sizeof(float));
+    unsigned int sign = f & 0x80000000u;
+    f ^= sign;
+
+    unsigned short h = 0;
+    if (f >= (127u + 16u) << 23) {
+      // Overflow to infinity, or NaN
+      h = (f > (255u << 23) ? 0x7e00 : 0x7c00);
+    }
+    else if (f < (113u << 23)) {
+      // Subnormal or zero. The float addition does the rounding
+      const unsigned int magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+      float fv = 0.0f, magic = 0.0f;
+      memcpy(&fv, &f, sizeof(float));
+      memcpy(&magic, &magic_bits, sizeof(float));
+      fv += magic;
+      memcpy(&f, &fv, sizeof(float));
+      h = (unsigned short)(f - magic_bits);
+    }
+    else {
+      unsigned int mant_odd = (f >> 13) & 1;
+      f += ((unsigned int)(15 - 127) << 23) + 0xfff;
+      f += mant_odd;
+      h = (unsigned short)(f >> 13);
+    }
+
+    return h | (unsigned short)(sign >> 16);
+  }
+
+  /// Portable conversion of a half precision value to float
+  inline float half_to_float(unsigned short h) {
+
+    const unsigned int shifted_exp = 0x7c00u << 13;
+    unsigned int f = (h & 0x7fffu) << 13;
+    unsigned int exp = shifted_exp & f;
+    f += (127u - 15u) << 23;
+
+    if (exp == shifted_exp) {
+      // Infinity or NaN
+      f += (128u - 16u) << 23;
+    }
+    else if (exp == 0) {
+      // Subnormal or zero, renormalized with a float subtraction
+      const unsigned int magic_bits = 113u << 23;
+      float fv = 0.0f, magic = 0.0f;
+      f += 1u << 23;
+      memcpy(&fv, &f, sizeof(float));
+      memcpy(&magic, &magic_bits, sizeof(float));
+      fv -= magic;
+      memcpy(&f, &fv, sizeof(float));
+    }
+
+    f |= (unsigned int)(h & 0x8000u) << 16;
+
+    float value = 0.0f;
+    memcpy(&value, &f, sizeof(float));
+    return value;
+  }
+
+  /* ************************************************************************* */
+  /// Fractional bits of the CV_16S images of the fixed point engine (ENGINE_FIXED)
+  const int fixed_image_bits = 12;        ///< Lt and Lsmooth, range [-8, 8)
+  const int fixed_derivative_bits = 14;   ///< Lx, Ly, Lxx, Lxy and Lyy, range [-2, 2)
+  const int fixed_diffusivity_bits = 12;  ///< Lflow, range [0, 1]
+  const int fixed_tap_bits = 13;          ///< Taps of the separable filters
+
+  /// Number of entries of the diffusivity lookup tables
+  const int fixed_lut_size = 27*64;
+
+  /// Index in the diffusivity lookup tables of the squared gradient v = Lx^2 + Ly^2, with
+  /// 2*fixed_derivative_bits fractional bits. The index is a small float with the exponent
+  /// of v and 6 bits of mantissa, so the bins are never wider than 1/64 of their value
+  inline int fixed_lut_index(unsigned int v) {
+
+    if (v < 64)
+      return (int)v;
+
+#if defined(__GNUC__) || defined(__clang__)
+    int e = 31 - __builtin_clz(v);
+#else
+    int e = 6;
+    while ((v >> (e+1)) != 0)
+      e++;
+#endif
+
+    return ((e - 5) << 6) + (int)((v >> (e - 6)) & 63);
+  }
+
+  /// Rotates the gradient (rx, ry) to the axes of a rotated M-LDB grid of orientation (co, si).
+  /// Channel 1 of the rotated M-LDB values holds dx and channel 2 dy, in every sampler
+  inline void mldb_rotate_gradient(float rx, float ry, float co, float si, float& dx, float& dy) {
+    dx = -rx*si + ry*co;
+    dy = rx*co + ry*si;
+  }
+
+  /// Splits the half step size of a fixed point FED step as 0.5*stepsize = m*2^-shift, with m in
+  /// [2^14, 2^15). The flux sum is rounded to fixed_image_bits + bits fractional bits before the
+  /// product by m, with bits = floor(log2(0.5*stepsize)) in [0, fixed_image_bits], so that its
+  /// rounding error is not amplified by large steps. Negligible steps give m = 0
+  inline void fixed_step_parameters(float stepsize, int& m, int& shift, int& bits) {
+
+    int e = 0;
+    double f = frexp(0.5*(double)stepsize, &e);
+    m = (int)floor(ldexp(f, 15) + 0.5);
+    if (m >= (1 << 15)) {
+      m >>= 1;
+      e++;
+    }
+
+    shift = 15 - e;
+    bits = (e - 1 < 0 ? 0 : (e - 1 > fixed_image_bits ? fixed_image_bits : e - 1));
+
+    if (stepsize <= 0.0f || bits + shift > 30) {
+      m = 0;
+      shift = 0;
+      bits = 0;
+    }
+  }
+
+  /// Returns the scalar reference kernels. These are the original implementations
+  /// of the library and must not be modified or optimized
+  const AKAZEKernels& reference_kernels();
+
+  /// Returns the kernels of the library that are used by default. The fastest kernels
+  /// supported by the CPU are selected the first time, unless the environment variable
+  /// AKAZE_KERNELS is set to reference, baseline, avx2, avx512 or avx512vnni
+  const AKAZEKernels& default_kernels();
+
+  /// Returns the kernels with the given name, or NULL if they were not compiled
+  /// or they are not supported by the CPU
+  const AKAZEKernels* find_kernels(const std::string& name);
+
+  /// Returns the optimized kernels supported by the CPU, from the slowest to the fastest one
+  void available_kernels(std::vector<const AKAZEKernels*>& kernels);
+
+  /// Returns the kernels used by the AKAZE instances created from now on
+  const AKAZEKernels& active_kernels();
+
+  /// Sets the kernels used by the AKAZE instances created from now on
+  /// @note The table is not copied, it must remain valid while it is active
+  void set_active_kernels(const AKAZEKernels& kernels);
+
+  /// Kernels compiled for every instruction set, see kernels_impl.h
+  namespace baseline {
+    const AKAZEKernels& kernels();
+  }
+
+#ifdef AKAZE_KERNELS_X86
+  namespace avx2 {
+    const AKAZEKernels& kernels();
+  }
+
+  namespace avx512 {
+    const AKAZEKernels& kernels();
+  }
+
+  namespace avx512vnni {
+    const AKAZEKernels& kernels();
+  }
+#endif
+
+  /* ************************************************************************* */
+  /// Scalar reference implementations. See nldiffusion_functions.h and
+  /// the kernel types above for the description of every function
+  namespace reference {
+
+    void pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k);
+
+    void pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k);
+
+    void weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k);
+
+    void charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k);
+
+    void compute_scharr_derivatives(const cv::Mat& src, cv::Mat& dst, const size_t xorder,
+                                    const size_t yorder, const size_t scale);
+
+    void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize);
+
+    void compute_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                     cv::Mat& Ldet, const float scale);
+
+    void mldb_fill_values(const TEvolution& e, float* values, int sample_step,
+                          int pattern_size, int nchannels, float xf, float yf,
+                          float co, float si, float scale);
+
+    void mldb_fill_upright_values(const TEvolution& e, float* values, int sample_step,
+                                  int pattern_size, int nchannels, float xf, float yf,
+                                  float scale);
+
+    void mldb_binary_comparisons(const float* values, unsigned char* desc,
+                                 int count, int nchannels, int& dpos);
+
+    void convert_to_half(const cv::Mat& src, cv::Mat& dst);
+
+    void convert_from_half(const unsigned short* src, float* dst, int n);
+
+    void mldb_fill_values_half(const TEvolution& e, float* values, int sample_step,
+                               int pattern_size, int nchannels, float xf, float yf,
+                               float co, float si, float scale);
+
+    void mldb_fill_upright_values_half(const TEvolution& e, float* values, int sample_step,
+                                       int pattern_size, int nchannels, float xf, float yf,
+                                       float scale);
+
+    void fixed_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const unsigned short* lut);
+
+    void fixed_sep_filter(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kx, const cv::Mat& ky,
+                          int shift, int border);
+
+    void nld_step_fixed(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize);
+
+    void fixed_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                   cv::Mat& Ldet, const float scale);
+
+    void nld_flux_rows(const cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                       const float stepsize, int y0, int y1);
+
+    void pack_descriptor_plane(const cv::Mat& Lt, const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst);
+
+    void mldb_fill_values_plane(const TEvolution& e, float* values, int sample_step,
+                                int pattern_size, int nchannels, float xf, float yf,
+                                float co, float si, float scale);
+
+    void mldb_fill_upright_values_plane(const TEvolution& e, float* values, int sample_step,
+                                        int pattern_size, int nchannels, float xf, float yf,
+                                        float scale);
+
+    void mldb_gather_values(const TEvolution& e, float* values, const short* offsets,
+                            int ncells, int nsamples, int nchannels, int x0, int y0,
+                            float co, float si);
+
+    void mldb_gather_values_half(const TEvolution& e, float* values, const short* offsets,
+                                 int ncells, int nsamples, int nchannels, int x0, int y0,
+                                 float co, float si);
+
+    void mldb_gather_values_plane(const TEvolution& e, float* values, const short* offsets,
+                                  int ncells, int nsamples, int nchannels, int x0, int y0,
+                                  float co, float si);
+
+    void msurf_descriptor(const TEvolution& e, float* desc, float xf, float yf,
+                          float co, float si, int scale);
+
+    void msurf_upright_descriptor(const TEvolution& e, float* desc, float xf, float yf, int scale);
+
+    void hamming_distances(const unsigned char* query, const cv::Mat& train, int* dist);
+
+    void int8_dot_products(const signed char* query, const cv::Mat& train, int* dot);
+
+    void pca_projection(const float* src, const float* projection, const float* bias,
+                        int ncomponents, float* dst);
+
+    void msurf_descriptor_half(const TEvolution& e, float* desc, float xf, float yf,
+                               float co, float si, int scale);
+
+    void msurf_upright_descriptor_half(const TEvolution& e, float* desc, float xf, float yf, int scale);
+  }
+}
@@ -0,0 +1,37 @@
+//=============================================================================
+//
+// kernels_avx2.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file kernels_avx2.cpp
+ * @brief Kernels compiled for AVX2 and FMA capable processors
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "AKAZE.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstring>
+
+#ifdef AKAZE_KERNELS_X86
+#include <immintrin.h>
+
+#define AKAZE_KERNELS_ISA avx2
+#define AKAZE_KERNELS_TARGET __attribute__((target("avx2,fma,f16c")))
+#define AKAZE_KERNELS_F16C
+#define AKAZE_KERNELS_SSE2
+#define AKAZE_KERNELS_AVX2
+#include "kernels_impl.h"
+#endif
@@ -0,0 +1,83 @@
+//=============================================================================
+//
+// kernels_avx512.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file kernels_avx512.cpp
+ * @brief Kernels compiled for AVX-512 (F, BW, DQ, VL) capable processors. The avx512vnni
+ * kernels are the same, with the int8 dot products of AVX-512 VNNI
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "AKAZE.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstring>
+
+#ifdef AKAZE_KERNELS_X86
+#include <immintrin.h>
+
+#define AKAZE_KERNELS_ISA avx512
+#define AKAZE_KERNELS_TARGET __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,f16c")))
+#define AKAZE_KERNELS_F16C
+#define AKAZE_KERNELS_SSE2
+#define AKAZE_KERNELS_AVX2
+#define AKAZE_KERNELS_AVX512
+#include "kernels_impl.h"
+
+namespace libAKAZE {
+namespace avx512vnni {
+
+/* ************************************************************************* */
+/// Dot products of the int8 descriptors with vpdpbusd, which accumulates the four unsigned by
+/// signed products of every 32 bit lane without the int16 step of pmaddubsw and pmaddwd
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void int8_dot_products(const signed char* query, const cv::Mat& train, int* dot) {
+
+  // The signs of the query are moved to the row as in the AVX-512 kernel
+  const __m512i q = _mm512_loadu_si512(query);
+  const __m512i qabs = _mm512_abs_epi8(q);
+  const __mmask64 qneg = _mm512_movepi8_mask(q);
+
+  for (int i = 0; i < train.rows; i++) {
+    __m512i d = _mm512_loadu_si512(train.ptr<signed char>(i));
+    d = _mm512_mask_sub_epi8(d, qneg, _mm512_setzero_si512(), d);
+    __m512i sums = _mm512_dpbusd_epi32(_mm512_setzero_si512(), qabs, d);
+    int lanes[16];
+    _mm512_storeu_si512(lanes, sums);
+    int s = 0;
+    for (int k = 0; k < 16; k++)
+      s += lanes[k];
+    dot[i] = s;
+  }
+}
+
+/* ************************************************************************* */
+static AKAZEKernels vnni_kernels() {
+  AKAZEKernels table = avx512::kernels();
+  table.name = "avx512vnni";
+  table.int8_dot_products = int8_dot_products;
+  return table;
+}
+
+/* ************************************************************************* */
+const AKAZEKernels& kernels() {
+  static const AKAZEKernels table = vnni_kernels();
+  return table;
+}
+
+}
+}
+#endif
@@ -0,0 +1,35 @@
+//=============================================================================
+//
+// kernels_baseline.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file kernels_baseline.cpp
+ * @brief Kernels compiled for the baseline instruction set of the build
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "AKAZE.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AKAZE_KERNELS_SSE2
+#endif
+
+#define AKAZE_KERNELS_ISA baseline
+#define AKAZE_KERNELS_TARGET
+#include "kernels_impl.h"
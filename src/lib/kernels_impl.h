@@ -0,0 +1,1363 @@
+/**
+ * @file kernels_impl.h
+ * @brief Implementation of the kernels that is compiled for every instruction set
+ * @note This file is included at the end of kernels_baseline.cpp, kernels_avx2.cpp
+ * and kernels_avx512.cpp, after all the headers it needs, with AKAZE_KERNELS_ISA
+ * defined to the name of the variant and AKAZE_KERNELS_TARGET to its target attribute.
+ * Only the functions of this file get the target attribute, so the inline functions
+ * of OpenCV and the standard library are never compiled for a wider instruction set.
+ * AKAZE_KERNELS_F16C is defined when the target has the F16C conversions,
+ * AKAZE_KERNELS_SSE2 when it has the SSE2 integer instructions, AKAZE_KERNELS_AVX2
+ * when it has the AVX2 gathers and FMA, and AKAZE_KERNELS_AVX512 when it has the
+ * AVX-512 F and BW integer instructions
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+/* ************************************************************************* */
+namespace libAKAZE {
+namespace AKAZE_KERNELS_ISA {
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = (-inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+
+  cv::exp(dst, dst);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = 1.0f / (1.0f+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++) {
+      float dL = inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
+      dst_row[x] = -3.315f/(dL*dL*dL*dL);
+    }
+  }
+
+  cv::exp(dst, dst);
+  dst = 1.0 - dst;
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++) {
+      float den = sqrtf(1.0f+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+      dst_row[x] = 1.0f / den;
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void compute_scharr_derivatives(const cv::Mat& src, cv::Mat& dst, const size_t xorder,
+                                       const size_t yorder, const size_t scale) {
+
+  // OpenCV already dispatches the separable filter at runtime. The guard band
+  // of the evolution is not part of the image
+  cv::Mat kx, ky;
+  compute_derivative_kernels(kx, ky, xorder, yorder, scale);
+  cv::sepFilter2D(src, dst, CV_32F, kx, ky, cv::Point(-1,-1), 0,
+                  cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+}
+
+/* ************************************************************************* */
+/// FED flux of one row. The rows above and below and the pixels at x = -1 and x = cols are read
+AKAZE_KERNELS_TARGET
+static inline void nld_flux_row(const float* Ld_row, const float* Ld_row_m, const float* Ld_row_p,
+                                const float* c_row, const float* c_row_m, const float* c_row_p,
+                                float* Lstep_row, int cols, const float stepsize) {
+
+  for (int x = 0; x < cols; x++) {
+    float xpos =  (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+    float xneg =  (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+    float ypos =  (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+    float yneg =  (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
+    Lstep_row[x] = 0.5f*stepsize*(xpos-xneg + ypos-yneg);
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void nld_step_guarded(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize,
+                             int nthreads) {
+
+  // The replicated guard band gives zero flux across the borders, so all the
+  // pixels are diffused with the same stencil
+  const size_t Ld_step = Ld.step1(), c_step = c.step1();
+
+  // The static schedule keeps every row on the same thread in all the steps
+  // (see AKAZE::First_Touch_Evolution)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+#endif
+  for (int y = 0; y < Lstep.rows; y++) {
+    const float* c_row = c.ptr<float>(y);
+    const float* Ld_row = Ld.ptr<float>(y);
+    nld_flux_row(Ld_row, Ld_row - Ld_step, Ld_row + Ld_step, c_row, c_row - c_step, c_row + c_step,
+                 Lstep.ptr<float>(y), Lstep.cols, stepsize);
+  }
+
+  // Ld = Ld + Lstep
+  for (int y = 0; y < Lstep.rows; y++) {
+    float* Ld_row = Ld.ptr<float>(y);
+    const float* Lstep_row = Lstep.ptr<float>(y);
+    for (int x = 0; x < Lstep.cols; x++)
+      Ld_row[x] += Lstep_row[x];
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
+
+  // Images without a guard band: nothing outside Ld is read or written, so the
+  // first and last rows and columns have their own stencils. The interior is
+  // diffused as in nld_step_guarded
+  const size_t Ld_step = Ld.step1(), c_step = c.step1();
+
+#ifdef _OPENMP
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+  for (int y = 1; y < Lstep.rows-1; y++) {
+    const float* c_row = c.ptr<float>(y);
+    const float* Ld_row = Ld.ptr<float>(y);
+    nld_flux_row(Ld_row + 1, Ld_row - Ld_step + 1, Ld_row + Ld_step + 1, c_row + 1, c_row - c_step + 1,
+                 c_row + c_step + 1, Lstep.ptr<float>(y) + 1, Lstep.cols-2, stepsize);
+  }
+
+  // First and last rows. The missing neighbours have zero flux
+  for (int k = 0; k < 2; k++) {
+
+    int y = (k == 0 ? 0 : Lstep.rows-1);
+    int yn = (k == 0 ? 1 : Lstep.rows-2);
+    const float* c_row = c.ptr<float>(y);
+    const float* c_row_n = c.ptr<float>(yn);
+    const float* Ld_row = Ld.ptr<float>(y);
+    const float* Ld_row_n = Ld.ptr<float>(yn);
+    float* Lstep_row = Lstep.ptr<float>(y);
+
+    for (int x = 1; x < Lstep.cols-1; x++) {
+      float xpos = (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+      float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+      float ypos = (c_row[x]+c_row_n[x])*(Ld_row_n[x]-Ld_row[x]);
+      Lstep_row[x] = 0.5f*stepsize*(xpos-xneg + ypos);
+    }
+
+    float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
+    float ypos = (c_row[0]+c_row_n[0])*(Ld_row_n[0]-Ld_row[0]);
+    Lstep_row[0] = 0.5f*stepsize*(xpos + ypos);
+
+    int x = Lstep.cols-1;
+    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+    ypos = (c_row[x]+c_row_n[x])*(Ld_row_n[x]-Ld_row[x]);
+    Lstep_row[x] = 0.5f*stepsize*(-xneg + ypos);
+  }
+
+  // First and last columns
+  for (int i = 1; i < Lstep.rows-1; i++) {
+
+    const float* c_row = c.ptr<float>(i);
+    const float* c_row_m = c.ptr<float>(i-1);
+    const float* c_row_p = c.ptr<float>(i+1);
+    const float* Ld_row = Ld.ptr<float>(i);
+    const float* Ld_row_p = Ld.ptr<float>(i+1);
+    const float* Ld_row_m = Ld.ptr<float>(i-1);
+    float* Lstep_row = Lstep.ptr<float>(i);
+    int x = Lstep.cols-1;
+
+    float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
+    float ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
+    float yneg = (c_row_m[0]+c_row[0])*(Ld_row[0]-Ld_row_m[0]);
+    Lstep_row[0] = 0.5f*stepsize*(xpos+ypos-yneg);
+
+    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+    ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+    yneg = (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
+    Lstep_row[x] = 0.5f*stepsize*(-xneg+ypos-yneg);
+  }
+
+  // Ld = Ld + Lstep
+  for (int y = 0; y < Lstep.rows; y++) {
+    float* Ld_row = Ld.ptr<float>(y);
+    const float* Lstep_row = Lstep.ptr<float>(y);
+    for (int x = 0; x < Lstep.cols; x++)
+      Ld_row[x] += Lstep_row[x];
+  }
+}
+
+/* ************************************************************************* */
+/// Same arithmetic as nld_step_scalar, so the wavefront diffusion of the evolution
+/// gives the same images as the diffusion of whole levels
+AKAZE_KERNELS_TARGET
+static void nld_flux_rows(const cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                          const float stepsize, int y0, int y1) {
+
+  const size_t Ld_step = Ld.step1(), c_step = c.step1();
+
+  for (int y = y0; y < y1; y++) {
+    const float* c_row = c.ptr<float>(y);
+    const float* Ld_row = Ld.ptr<float>(y);
+    nld_flux_row(Ld_row, Ld_row - Ld_step, Ld_row + Ld_step, c_row, c_row - c_step, c_row + c_step,
+                 Lstep.ptr<float>(y), Lstep.cols, stepsize);
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void compute_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                        cv::Mat& Ldet, const float scale) {
+
+  for (int y = 0; y < Ldet.rows; y++) {
+    const float* lxx = Lxx.ptr<float>(y);
+    const float* lxy = Lxy.ptr<float>(y);
+    const float* lyy = Lyy.ptr<float>(y);
+    float* ldet = Ldet.ptr<float>(y);
+    for (int x = 0; x < Ldet.cols; x++)
+      ldet[x] = (lxx[x]*lyy[x]-lxy[x]*lxy[x])*scale;
+  }
+}
+
+/* ************************************************************************* */
+#ifdef AKAZE_KERNELS_F16C
+/// F16C conversions. They shadow the portable ones of kernels.h
+AKAZE_KERNELS_TARGET
+static inline unsigned short float_to_half(float value) {
+  return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+}
+
+AKAZE_KERNELS_TARGET
+static inline float half_to_float(unsigned short h) {
+  return _cvtsh_ss(h);
+}
+#endif
+
+/// Loads one value of a float or half precision plane
+AKAZE_KERNELS_TARGET
+static inline float load_value(const float* ptr) {
+  return *ptr;
+}
+
+AKAZE_KERNELS_TARGET
+static inline float load_value(const unsigned short* ptr) {
+  return half_to_float(*ptr);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void convert_to_half(const cv::Mat& src, cv::Mat& dst) {
+
+  dst.create(src.size(), CV_16U);
+
+  for (int y = 0; y < src.rows; y++) {
+    const float* src_row = src.ptr<float>(y);
+    unsigned short* dst_row = dst.ptr<unsigned short>(y);
+    int x = 0;
+#ifdef AKAZE_KERNELS_F16C
+    for (; x + 8 <= src.cols; x += 8) {
+      __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src_row + x), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128((__m128i*)(dst_row + x), h);
+    }
+#endif
+    for (; x < src.cols; x++)
+      dst_row[x] = float_to_half(src_row[x]);
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void convert_from_half(const unsigned short* src, float* dst, int n) {
+
+  int i = 0;
+#ifdef AKAZE_KERNELS_F16C
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+  for (; i < n; i++)
+    dst[i] = half_to_float(src[i]);
+}
+
+/* ************************************************************************* */
+/// Samples of the separate Lt, Lx and Ly planes, in float (T = float) or half precision (T = unsigned short)
+template <typename T>
+struct planar_samples {
+
+  AKAZE_KERNELS_TARGET
+  planar_samples(const cv::Mat& Lt_, const cv::Mat& Lx_, const cv::Mat& Ly_)
+    : Lt(Lt_), Lx(Lx_), Ly(Ly_) {
+  }
+
+  AKAZE_KERNELS_TARGET
+  float intensity(int y, int x) const {
+    return load_value(Lt.ptr<T>(y)+x);
+  }
+
+  AKAZE_KERNELS_TARGET
+  void gradient(int y, int x, float& rx, float& ry) const {
+    rx = load_value(Lx.ptr<T>(y)+x);
+    ry = load_value(Ly.ptr<T>(y)+x);
+  }
+
+  const cv::Mat& Lt;
+  const cv::Mat& Lx;
+  const cv::Mat& Ly;
+};
+
+/// Samples of the interleaved (Lt, Lx, Ly, 0) plane. The three values share a cache line
+struct interleaved_samples {
+
+  AKAZE_KERNELS_TARGET
+  explicit interleaved_samples(const cv::Mat& plane_) : plane(plane_) {
+  }
+
+  AKAZE_KERNELS_TARGET
+  float intensity(int y, int x) const {
+    return *(plane.ptr<float>(y) + 4*x);
+  }
+
+  AKAZE_KERNELS_TARGET
+  void gradient(int y, int x, float& rx, float& ry) const {
+    const float* p = plane.ptr<float>(y) + 4*x;
+    rx = p[1];
+    ry = p[2];
+  }
+
+  const cv::Mat& plane;
+};
+
+/* ************************************************************************* */
+/// M-LDB rotated sampling of the planes read by Samples
+template <typename Samples>
+AKAZE_KERNELS_TARGET
+static void mldb_fill_values_t(const Samples& samples, float* values, int sample_step,
+                               int pattern_size, int nchannels, float xf, float yf,
+                               float co, float si, float scale) {
+
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + (l*co*scale + k*si*scale);
+          float sample_x = xf + (-l*si*scale + k*co*scale);
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          di += samples.intensity(y1, x1);
+
+          if (nchannels > 1) {
+            float rx = 0.0, ry = 0.0;
+            samples.gradient(y1, x1, rx, ry);
+            if (nchannels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              float rdx = 0.0, rdy = 0.0;
+              mldb_rotate_gradient(rx, ry, co, si, rdx, rdy);
+              dx += rdx;
+              dy += rdy;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      values[valpos] = di / nsamples;
+
+      if (nchannels > 1)
+        values[valpos + 1] = dx / nsamples;
+
+      if (nchannels > 2)
+        values[valpos + 2] = dy / nsamples;
+
+      valpos += nchannels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+/// M-LDB upright sampling of the planes read by Samples
+template <typename Samples>
+AKAZE_KERNELS_TARGET
+static void mldb_fill_upright_values_t(const Samples& samples, float* values, int sample_step,
+                                       int pattern_size, int nchannels, float xf, float yf,
+                                       float scale) {
+
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+
+        int x1 = fRound(xf + k*scale);
+
+        for (int l = j; l < j + sample_step; l++) {
+
+          int y1 = fRound(yf + l*scale);
+
+          di += samples.intensity(y1, x1);
+
+          if (nchannels > 1) {
+            float rx = 0.0, ry = 0.0;
+            samples.gradient(y1, x1, rx, ry);
+            if (nchannels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              dx += rx;
+              dy += ry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      values[valpos] = di / nsamples;
+
+      if (nchannels > 1)
+        values[valpos + 1] = dx / nsamples;
+
+      if (nchannels > 2)
+        values[valpos + 2] = dy / nsamples;
+
+      valpos += nchannels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_values(const TEvolution& e, float* values, int sample_step,
+                             int pattern_size, int nchannels, float xf, float yf,
+                             float co, float si, float scale) {
+  mldb_fill_values_t(planar_samples<float>(e.Lt, e.Lx, e.Ly), values, sample_step, pattern_size,
+                     nchannels, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_upright_values(const TEvolution& e, float* values, int sample_step,
+                                     int pattern_size, int nchannels, float xf, float yf,
+                                     float scale) {
+  mldb_fill_upright_values_t(planar_samples<float>(e.Lt, e.Lx, e.Ly), values, sample_step,
+                             pattern_size, nchannels, xf, yf, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_values_half(const TEvolution& e, float* values, int sample_step,
+                                  int pattern_size, int nchannels, float xf, float yf,
+                                  float co, float si, float scale) {
+  mldb_fill_values_t(planar_samples<unsigned short>(e.Lt16, e.Lx16, e.Ly16), values, sample_step,
+                     pattern_size, nchannels, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_upright_values_half(const TEvolution& e, float* values, int sample_step,
+                                          int pattern_size, int nchannels, float xf, float yf,
+                                          float scale) {
+  mldb_fill_upright_values_t(planar_samples<unsigned short>(e.Lt16, e.Lx16, e.Ly16), values,
+                             sample_step, pattern_size, nchannels, xf, yf, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_values_plane(const TEvolution& e, float* values, int sample_step,
+                                   int pattern_size, int nchannels, float xf, float yf,
+                                   float co, float si, float scale) {
+  mldb_fill_values_t(interleaved_samples(e.Ldesc), values, sample_step, pattern_size,
+                     nchannels, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_fill_upright_values_plane(const TEvolution& e, float* values, int sample_step,
+                                           int pattern_size, int nchannels, float xf, float yf,
+                                           float scale) {
+  mldb_fill_upright_values_t(interleaved_samples(e.Ldesc), values, sample_step, pattern_size,
+                             nchannels, xf, yf, scale);
+}
+
+/* ************************************************************************* */
+/// M-LDB sampling of the planes read by Samples at precomputed offsets
+template <typename Samples>
+AKAZE_KERNELS_TARGET
+static void mldb_gather_values_t(const Samples& samples, float* values, const short* offsets,
+                                 int ncells, int nsamples, int nchannels, int x0, int y0,
+                                 float co, float si) {
+
+  int valpos = 0;
+
+  for (int c = 0; c < ncells; c++) {
+
+    float di = 0.0, dx = 0.0, dy = 0.0;
+
+    for (int s = 0; s < nsamples; s++, offsets += 2) {
+
+      int x1 = x0 + offsets[0];
+      int y1 = y0 + offsets[1];
+
+      di += samples.intensity(y1, x1);
+
+      if (nchannels > 1) {
+        float rx = 0.0, ry = 0.0;
+        samples.gradient(y1, x1, rx, ry);
+        if (nchannels == 2) {
+          dx += sqrtf(rx*rx + ry*ry);
+        }
+        else {
+          float rdx = 0.0, rdy = 0.0;
+          mldb_rotate_gradient(rx, ry, co, si, rdx, rdy);
+          dx += rdx;
+          dy += rdy;
+        }
+      }
+    }
+
+    values[valpos] = di / nsamples;
+
+    if (nchannels > 1)
+      values[valpos + 1] = dx / nsamples;
+
+    if (nchannels > 2)
+      values[valpos + 2] = dy / nsamples;
+
+    valpos += nchannels;
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_gather_values(const TEvolution& e, float* values, const short* offsets,
+                               int ncells, int nsamples, int nchannels, int x0, int y0,
+                               float co, float si) {
+  mldb_gather_values_t(planar_samples<float>(e.Lt, e.Lx, e.Ly), values, offsets,
+                       ncells, nsamples, nchannels, x0, y0, co, si);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_gather_values_half(const TEvolution& e, float* values, const short* offsets,
+                                    int ncells, int nsamples, int nchannels, int x0, int y0,
+                                    float co, float si) {
+  mldb_gather_values_t(planar_samples<unsigned short>(e.Lt16, e.Lx16, e.Ly16), values, offsets,
+                       ncells, nsamples, nchannels, x0, y0, co, si);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_gather_values_plane(const TEvolution& e, float* values, const short* offsets,
+                                     int ncells, int nsamples, int nchannels, int x0, int y0,
+                                     float co, float si) {
+  mldb_gather_values_t(interleaved_samples(e.Ldesc), values, offsets,
+                       ncells, nsamples, nchannels, x0, y0, co, si);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void pack_descriptor_plane(const cv::Mat& Lt, const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst) {
+
+  for (int y = 0; y < dst.rows; y++) {
+    const float* Lt_row = Lt.ptr<float>(y);
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    int x = 0;
+#ifdef AKAZE_KERNELS_SSE2
+    // Transposes 4 pixels of (Lt, Lx, Ly, 0) into 4 samples
+    const __m128 zero = _mm_setzero_ps();
+    for (; x + 4 <= dst.cols; x += 4) {
+      __m128 t = _mm_loadu_ps(Lt_row + x);
+      __m128 gx = _mm_loadu_ps(Lx_row + x);
+      __m128 gy = _mm_loadu_ps(Ly_row + x);
+      __m128 tx_lo = _mm_unpacklo_ps(t, gx), tx_hi = _mm_unpackhi_ps(t, gx);
+      __m128 yz_lo = _mm_unpacklo_ps(gy, zero), yz_hi = _mm_unpackhi_ps(gy, zero);
+      _mm_storeu_ps(dst_row + 4*x, _mm_movelh_ps(tx_lo, yz_lo));
+      _mm_storeu_ps(dst_row + 4*x + 4, _mm_movehl_ps(yz_lo, tx_lo));
+      _mm_storeu_ps(dst_row + 4*x + 8, _mm_movelh_ps(tx_hi, yz_hi));
+      _mm_storeu_ps(dst_row + 4*x + 12, _mm_movehl_ps(yz_hi, tx_hi));
+    }
+#endif
+    for (; x < dst.cols; x++) {
+      dst_row[4*x] = Lt_row[x];
+      dst_row[4*x + 1] = Lx_row[x];
+      dst_row[4*x + 2] = Ly_row[x];
+      dst_row[4*x + 3] = 0.0f;
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void mldb_binary_comparisons(const float* values, unsigned char* desc,
+                                    int count, int nchannels, int& dpos) {
+
+  for (int pos = 0; pos < nchannels; pos++) {
+    for (int i = 0; i < count; i++) {
+      float ival = values[nchannels * i + pos];
+      for (int j = i + 1; j < count; j++) {
+        int res = ival > values[nchannels * j + pos];
+        desc[dpos >> 3] |= (res << (dpos & 7));
+        dpos++;
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void fixed_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
+                              const unsigned short* lut) {
+
+  for (int y = 0; y < Lx.rows; y++) {
+    const short* Lx_row = Lx.ptr<short>(y);
+    const short* Ly_row = Ly.ptr<short>(y);
+    short* dst_row = dst.ptr<short>(y);
+    for (int x = 0; x < Lx.cols; x++) {
+      int lx = Lx_row[x], ly = Ly_row[x];
+      unsigned int v = (unsigned int)(lx*lx) + (unsigned int)(ly*ly);
+      dst_row[x] = (short)lut[fixed_lut_index(v)];
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void fixed_sep_filter(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kx,
+                             const cv::Mat& ky, int shift, int border, int nthreads) {
+
+  CV_Assert(src.data != dst.data);
+
+  const int* kx_taps = kx.ptr<int>(0);
+  const int* ky_taps = ky.ptr<int>(0);
+  const int kx_size = (int)kx.total(), ky_size = (int)ky.total();
+  const int rx = kx_size/2, ry = ky_size/2;
+  const int rows = src.rows, cols = src.cols;
+  const int vshift = fixed_tap_bits - 2;
+  const int vround = 1 << (vshift-1);
+  const int hround = (shift > 0 ? 1 << (shift-1) : 0);
+
+  dst.create(src.size(), CV_16S);
+
+  // Rows and columns read by the filter, with the border interpolated
+  std::vector<int> row_index(rows + 2*ry), col_index(cols + 2*rx);
+  for (int i = 0; i < rows + 2*ry; i++)
+    row_index[i] = cv::borderInterpolate(i - ry, rows, border);
+  for (int i = 0; i < cols + 2*rx; i++)
+    col_index[i] = cv::borderInterpolate(i - rx, cols, border);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+  {
+    // Vertical pass with its border columns, and accumulator of the horizontal pass
+    std::vector<int> vbuffer(cols + 2*rx), hbuffer(cols);
+    int* vrow = &vbuffer[rx];
+    int* hrow = &hbuffer[0];
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int y = 0; y < rows; y++) {
+
+      for (int x = 0; x < cols; x++)
+        vrow[x] = 0;
+
+      for (int k = 0; k < ky_size; k++) {
+        const int tap = ky_taps[k];
+        if (tap == 0)
+          continue;
+        const short* src_row = src.ptr<short>(row_index[y + k]);
+        for (int x = 0; x < cols; x++)
+          vrow[x] += tap*src_row[x];
+      }
+
+      for (int x = 0; x < cols; x++)
+        vrow[x] = (vrow[x] + vround) >> vshift;
+
+      for (int x = -rx; x < 0; x++)
+        vrow[x] = vrow[col_index[x + rx]];
+      for (int x = cols; x < cols + rx; x++)
+        vrow[x] = vrow[col_index[x + rx]];
+
+      for (int x = 0; x < cols; x++)
+        hrow[x] = 0;
+
+      for (int k = 0; k < kx_size; k++) {
+        const int tap = kx_taps[k];
+        if (tap == 0)
+          continue;
+        const int* vrow_k = vrow + k - rx;
+        for (int x = 0; x < cols; x++)
+          hrow[x] += tap*vrow_k[x];
+      }
+
+      short* dst_row = dst.ptr<short>(y);
+      for (int x = 0; x < cols; x++)
+        dst_row[x] = cv::saturate_cast<short>((hrow[x] + hround) >> shift);
+    }
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void nld_step_fixed_guarded(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize,
+                                   int nthreads) {
+
+  int m = 0, shift = 0, bits = 0;
+  fixed_step_parameters(stepsize, m, shift, bits);
+
+  const int lap_shift = fixed_diffusivity_bits - bits;
+  const int step_shift = bits + shift;
+  const int lap_round = (lap_shift > 0 ? 1 << (lap_shift-1) : 0);
+  const int step_round = (step_shift > 0 ? 1 << (step_shift-1) : 0);
+  const size_t Ld_step = Ld.step1(), c_step = c.step1();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+#endif
+  for (int y = 0; y < Lstep.rows; y++) {
+    const short* c_row = c.ptr<short>(y);
+    const short* c_row_p = c_row + c_step;
+    const short* c_row_m = c_row - c_step;
+
+    const short* Ld_row = Ld.ptr<short>(y);
+    const short* Ld_row_p = Ld_row + Ld_step;
+    const short* Ld_row_m = Ld_row - Ld_step;
+    short* Lstep_row = Lstep.ptr<short>(y);
+
+    int x = 0;
+#ifdef AKAZE_KERNELS_SSE2
+    // Saturating differences, flux sums with pairwise 16x16->32 bit products,
+    // and saturating packs of the sum and the step
+    const __m128i vm = _mm_set1_epi16((short)m);
+    const __m128i vlap_round = _mm_set1_epi32(lap_round);
+    const __m128i vstep_round = _mm_set1_epi32(step_round);
+    const __m128i vlap_shift = _mm_cvtsi32_si128(lap_shift);
+    const __m128i vstep_shift = _mm_cvtsi32_si128(step_shift);
+
+    for (; x + 8 <= Lstep.cols; x += 8) {
+      __m128i c0 = _mm_loadu_si128((const __m128i*)(c_row + x));
+      __m128i l0 = _mm_loadu_si128((const __m128i*)(Ld_row + x));
+
+      __m128i se = _mm_add_epi16(c0, _mm_loadu_si128((const __m128i*)(c_row + x + 1)));
+      __m128i sw = _mm_add_epi16(c0, _mm_loadu_si128((const __m128i*)(c_row + x - 1)));
+      __m128i ss = _mm_add_epi16(c0, _mm_loadu_si128((const __m128i*)(c_row_p + x)));
+      __m128i sn = _mm_add_epi16(c0, _mm_loadu_si128((const __m128i*)(c_row_m + x)));
+
+      __m128i de = _mm_subs_epi16(_mm_loadu_si128((const __m128i*)(Ld_row + x + 1)), l0);
+      __m128i dw = _mm_subs_epi16(_mm_loadu_si128((const __m128i*)(Ld_row + x - 1)), l0);
+      __m128i ds = _mm_subs_epi16(_mm_loadu_si128((const __m128i*)(Ld_row_p + x)), l0);
+      __m128i dn = _mm_subs_epi16(_mm_loadu_si128((const __m128i*)(Ld_row_m + x)), l0);
+
+      __m128i acc_lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(se, sw), _mm_unpacklo_epi16(de, dw)),
+                                     _mm_madd_epi16(_mm_unpacklo_epi16(ss, sn), _mm_unpacklo_epi16(ds, dn)));
+      __m128i acc_hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(se, sw), _mm_unpackhi_epi16(de, dw)),
+                                     _mm_madd_epi16(_mm_unpackhi_epi16(ss, sn), _mm_unpackhi_epi16(ds, dn)));
+
+      __m128i lap = _mm_packs_epi32(_mm_sra_epi32(_mm_add_epi32(acc_lo, vlap_round), vlap_shift),
+                                    _mm_sra_epi32(_mm_add_epi32(acc_hi, vlap_round), vlap_shift));
+
+      __m128i prod_lo = _mm_mullo_epi16(lap, vm);
+      __m128i prod_hi = _mm_mulhi_epi16(lap, vm);
+      __m128i p0 = _mm_unpacklo_epi16(prod_lo, prod_hi);
+      __m128i p1 = _mm_unpackhi_epi16(prod_lo, prod_hi);
+
+      __m128i step = _mm_packs_epi32(_mm_sra_epi32(_mm_add_epi32(p0, vstep_round), vstep_shift),
+                                     _mm_sra_epi32(_mm_add_epi32(p1, vstep_round), vstep_shift));
+      _mm_storeu_si128((__m128i*)(Lstep_row + x), step);
+    }
+#endif
+
+    for (; x < Lstep.cols; x++) {
+      int l = Ld_row[x], cc = c_row[x];
+      int acc = (cc + c_row[x+1])*cv::saturate_cast<short>(Ld_row[x+1] - l) +
+                (cc + c_row[x-1])*cv::saturate_cast<short>(Ld_row[x-1] - l) +
+                (cc + c_row_p[x])*cv::saturate_cast<short>(Ld_row_p[x] - l) +
+                (cc + c_row_m[x])*cv::saturate_cast<short>(Ld_row_m[x] - l);
+      int lap = cv::saturate_cast<short>((acc + lap_round) >> lap_shift);
+      Lstep_row[x] = cv::saturate_cast<short>((lap*m + step_round) >> step_shift);
+    }
+  }
+
+  // Ld = Ld + Lstep, saturated
+  for (int y = 0; y < Lstep.rows; y++) {
+    short* Ld_row = Ld.ptr<short>(y);
+    const short* Lstep_row = Lstep.ptr<short>(y);
+    int x = 0;
+#ifdef AKAZE_KERNELS_SSE2
+    for (; x + 8 <= Lstep.cols; x += 8) {
+      __m128i l = _mm_loadu_si128((const __m128i*)(Ld_row + x));
+      __m128i step = _mm_loadu_si128((const __m128i*)(Lstep_row + x));
+      _mm_storeu_si128((__m128i*)(Ld_row + x), _mm_adds_epi16(l, step));
+    }
+#endif
+    for (; x < Lstep.cols; x++)
+      Ld_row[x] = cv::saturate_cast<short>(Ld_row[x] + Lstep_row[x]);
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void nld_step_fixed(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
+
+  // Any other image is diffused on bordered copies, so nothing outside Ld is written
+  cv::Mat Ld_border, c_border;
+  cv::copyMakeBorder(Ld, Ld_border, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+  cv::copyMakeBorder(c, c_border, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+
+  cv::Mat Ld_roi = Ld_border(cv::Rect(1, 1, Ld.cols, Ld.rows));
+  nld_step_fixed_guarded(Ld_roi, c_border(cv::Rect(1, 1, c.cols, c.rows)), Lstep, stepsize, OMP_MAX_THREADS);
+  Ld_roi.copyTo(Ld);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void fixed_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                      cv::Mat& Ldet, const float scale) {
+
+  const float unit = scale / (float)(1 << (2*fixed_derivative_bits));
+
+  for (int y = 0; y < Ldet.rows; y++) {
+    const short* lxx = Lxx.ptr<short>(y);
+    const short* lxy = Lxy.ptr<short>(y);
+    const short* lyy = Lyy.ptr<short>(y);
+    float* ldet = Ldet.ptr<float>(y);
+    for (int x = 0; x < Ldet.cols; x++)
+      ldet[x] = (float)(lxx[x]*lyy[x] - lxy[x]*lxy[x])*unit;
+  }
+}
+
+/* ************************************************************************* */
+/// Gaussian weights of the M-SURF descriptors. The weight of a sample only depends on its
+/// offset from the center of its subregion in units of the scale, so neither on the scale
+/// nor on the angle. The 9x9 samples of a subregion are padded to a multiple of 8 with zero
+/// weights at its first sample
+struct msurf_weights {
+
+  static const int nsamples = 88;
+
+  msurf_weights() {
+    for (int s = 0; s < nsamples; s++) {
+      int k = (s < 81 ? s/9 : 0), l = (s < 81 ? s%9 : 0);
+      row[s] = (float)k;
+      col[s] = (float)l;
+      sample[s] = (s < 81 ? gaussian(5.0f-l, 5.0f-k, 2.5f) : 0.0f);
+    }
+
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+        subregion[4*i+j] = gaussian(i-1.5f, j-1.5f, 1.5f);
+  }
+
+  float row[nsamples];      ///< Row of the sample in its subregion, k-i
+  float col[nsamples];      ///< Column of the sample in its subregion, l-j
+  float sample[nsamples];   ///< Weight of the sample
+  float subregion[16];      ///< Weight of the subregions
+};
+
+static const msurf_weights& get_msurf_weights() {
+  static const msurf_weights weights;
+  return weights;
+}
+
+#ifdef AKAZE_KERNELS_AVX2
+/// Sum of the 8 values of v
+AKAZE_KERNELS_TARGET
+static inline float hsum_ps(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+/// Bilinear interpolation of img at the pixels idx, idx+1, idx+step and idx+step+1
+AKAZE_KERNELS_TARGET
+static inline __m256 bilinear_gather(const float* img, __m256i idx, __m256i step, __m256 w00,
+                                     __m256 w01, __m256 w10, __m256 w11) {
+  __m256i idx1 = _mm256_add_epi32(idx, step);
+  __m256 r = _mm256_mul_ps(w00, _mm256_i32gather_ps(img, idx, 4));
+  r = _mm256_fmadd_ps(w01, _mm256_i32gather_ps(img + 1, idx, 4), r);
+  r = _mm256_fmadd_ps(w10, _mm256_i32gather_ps(img, idx1, 4), r);
+  return _mm256_fmadd_ps(w11, _mm256_i32gather_ps(img + 1, idx1, 4), r);
+}
+
+/// Bilinear interpolation of the half precision img. Every gather reads the pixels idx and
+/// idx+1 as one 32 bit word, whose halves are split into the low and high 128 bit lanes
+AKAZE_KERNELS_TARGET
+static inline __m256 bilinear_gather(const unsigned short* img, __m256i idx, __m256i step, __m256 w00,
+                                     __m256 w01, __m256 w10, __m256 w11) {
+  const __m256i split = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+                                         0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+  __m256i p0 = _mm256_i32gather_epi32((const int*)img, idx, 2);
+  __m256i p1 = _mm256_i32gather_epi32((const int*)img, _mm256_add_epi32(idx, step), 2);
+  p0 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(p0, split), _MM_SHUFFLE(3, 1, 2, 0));
+  p1 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(p1, split), _MM_SHUFFLE(3, 1, 2, 0));
+
+  __m256 r = _mm256_mul_ps(w00, _mm256_cvtph_ps(_mm256_castsi256_si128(p0)));
+  r = _mm256_fmadd_ps(w01, _mm256_cvtph_ps(_mm256_extracti128_si256(p0, 1)), r);
+  r = _mm256_fmadd_ps(w10, _mm256_cvtph_ps(_mm256_castsi256_si128(p1)), r);
+  return _mm256_fmadd_ps(w11, _mm256_cvtph_ps(_mm256_extracti128_si256(p1, 1)), r);
+}
+#endif
+
+/* ************************************************************************* */
+/// M-SURF descriptor with the Gaussian weights of msurf_weights, of the float (T = float) or half
+/// precision (T = unsigned short) derivatives. The upright descriptor samples the rows of the
+/// subregions along y and starts its bilinear interpolation half a pixel before
+template <bool Upright, typename T>
+AKAZE_KERNELS_TARGET
+static void msurf_descriptor_t(const cv::Mat& Lx, const cv::Mat& Ly, float* desc, float xf, float yf,
+                               float co, float si, int scale) {
+
+  const msurf_weights& w = get_msurf_weights();
+  const int lx_step = (int)Lx.step1(), ly_step = (int)Ly.step1();
+  const T* lx = Lx.ptr<T>(0);
+  const T* ly = Ly.ptr<T>(0);
+  const float fscale = (float)scale;
+  float len = 0.0f;
+
+  for (int ii = 0; ii < 4; ii++) {
+    for (int jj = 0; jj < 4; jj++) {
+
+      // First sample of the 9x9 subregion, with a step of 5 samples between subregions
+      const float i = -12.0f + 5*ii, j = -12.0f + 5*jj;
+      float dx = 0.0f, dy = 0.0f, mdx = 0.0f, mdy = 0.0f;
+      int s = 0;
+
+#ifdef AKAZE_KERNELS_AVX2
+      const __m256 vco = _mm256_set1_ps(co), vsi = _mm256_set1_ps(si), vscale = _mm256_set1_ps(fscale);
+      const __m256 vxf = _mm256_set1_ps(xf), vyf = _mm256_set1_ps(yf), one = _mm256_set1_ps(1.0f);
+      const __m256 sign = _mm256_set1_ps(-0.0f);
+      const __m256i vlx_step = _mm256_set1_epi32(lx_step), vly_step = _mm256_set1_epi32(ly_step);
+      __m256 vdx = _mm256_setzero_ps(), vdy = _mm256_setzero_ps();
+      __m256 vmdx = _mm256_setzero_ps(), vmdy = _mm256_setzero_ps();
+
+      for (; s + 8 <= msurf_weights::nsamples; s += 8) {
+        __m256 ks = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(i), _mm256_loadu_ps(w.row + s)), vscale);
+        __m256 ls = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(j), _mm256_loadu_ps(w.col + s)), vscale);
+        __m256 sx, sy;
+        __m256i x1, y1;
+
+        if (Upright) {
+          sy = _mm256_add_ps(ks, vyf);
+          sx = _mm256_add_ps(ls, vxf);
+          y1 = _mm256_cvttps_epi32(_mm256_sub_ps(sy, _mm256_set1_ps(0.5f)));
+          x1 = _mm256_cvttps_epi32(_mm256_sub_ps(sx, _mm256_set1_ps(0.5f)));
+        }
+        else {
+          sy = _mm256_add_ps(vyf, _mm256_fmadd_ps(ls, vco, _mm256_mul_ps(ks, vsi)));
+          sx = _mm256_add_ps(vxf, _mm256_fmsub_ps(ks, vco, _mm256_mul_ps(ls, vsi)));
+          y1 = _mm256_cvttps_epi32(sy);
+          x1 = _mm256_cvttps_epi32(sx);
+        }
+
+        __m256 fx = _mm256_sub_ps(sx, _mm256_cvtepi32_ps(x1));
+        __m256 fy = _mm256_sub_ps(sy, _mm256_cvtepi32_ps(y1));
+        __m256 w00 = _mm256_mul_ps(_mm256_sub_ps(one, fx), _mm256_sub_ps(one, fy));
+        __m256 w01 = _mm256_mul_ps(fx, _mm256_sub_ps(one, fy));
+        __m256 w10 = _mm256_mul_ps(_mm256_sub_ps(one, fx), fy);
+        __m256 w11 = _mm256_mul_ps(fx, fy);
+
+        __m256i ix = _mm256_add_epi32(_mm256_mullo_epi32(y1, vlx_step), x1);
+        __m256i iy = _mm256_add_epi32(_mm256_mullo_epi32(y1, vly_step), x1);
+        __m256 rx = bilinear_gather(lx, ix, vlx_step, w00, w01, w10, w11);
+        __m256 ry = bilinear_gather(ly, iy, vly_step, w00, w01, w10, w11);
+
+        __m256 gw = _mm256_loadu_ps(w.sample + s);
+        __m256 rrx, rry;
+        if (Upright) {
+          rrx = _mm256_mul_ps(gw, rx);
+          rry = _mm256_mul_ps(gw, ry);
+        }
+        else {
+          rry = _mm256_mul_ps(gw, _mm256_fmadd_ps(rx, vco, _mm256_mul_ps(ry, vsi)));
+          rrx = _mm256_mul_ps(gw, _mm256_fmsub_ps(ry, vco, _mm256_mul_ps(rx, vsi)));
+        }
+
+        vdx = _mm256_add_ps(vdx, rrx);
+        vdy = _mm256_add_ps(vdy, rry);
+        vmdx = _mm256_add_ps(vmdx, _mm256_andnot_ps(sign, rrx));
+        vmdy = _mm256_add_ps(vmdy, _mm256_andnot_ps(sign, rry));
+      }
+
+      dx = hsum_ps(vdx);
+      dy = hsum_ps(vdy);
+      mdx = hsum_ps(vmdx);
+      mdy = hsum_ps(vmdy);
+#endif
+
+      for (; s < 81; s++) {
+        float k = i + w.row[s], l = j + w.col[s];
+        float sample_x, sample_y;
+        int x1, y1;
+
+        if (Upright) {
+          sample_y = k*fscale + yf;
+          sample_x = l*fscale + xf;
+          y1 = (int)(sample_y-0.5f);
+          x1 = (int)(sample_x-0.5f);
+        }
+        else {
+          sample_y = yf + (l*fscale*co + k*fscale*si);
+          sample_x = xf + (-l*fscale*si + k*fscale*co);
+          y1 = (int)sample_y;
+          x1 = (int)sample_x;
+        }
+
+        float fx = sample_x-x1, fy = sample_y-y1;
+        const T* lx0 = lx + y1*lx_step + x1;
+        const T* ly0 = ly + y1*ly_step + x1;
+        float rx = (1.0f-fx)*(1.0f-fy)*load_value(lx0) + fx*(1.0f-fy)*load_value(lx0+1) +
+                   (1.0f-fx)*fy*load_value(lx0+lx_step) + fx*fy*load_value(lx0+lx_step+1);
+        float ry = (1.0f-fx)*(1.0f-fy)*load_value(ly0) + fx*(1.0f-fy)*load_value(ly0+1) +
+                   (1.0f-fx)*fy*load_value(ly0+ly_step) + fx*fy*load_value(ly0+ly_step+1);
+
+        float rrx, rry;
+        if (Upright) {
+          rrx = w.sample[s]*rx;
+          rry = w.sample[s]*ry;
+        }
+        else {
+          rry = w.sample[s]*(rx*co + ry*si);
+          rrx = w.sample[s]*(-rx*si + ry*co);
+        }
+
+        dx += rrx;
+        dy += rry;
+        mdx += fabsf(rrx);
+        mdy += fabsf(rry);
+      }
+
+      const float g = w.subregion[4*ii+jj];
+      float* d = desc + 4*(4*ii+jj);
+      d[0] = dx*g;
+      d[1] = dy*g;
+      d[2] = mdx*g;
+      d[3] = mdy*g;
+
+      len += (dx*dx + dy*dy + mdx*mdx + mdy*mdy)*g*g;
+    }
+  }
+
+  // Unit vector
+  int n = 0;
+#ifdef AKAZE_KERNELS_AVX2
+  // Reciprocal square root with one Newton-Raphson step
+  __m256 vlen = _mm256_set1_ps(len);
+  __m256 inv = _mm256_rsqrt_ps(vlen);
+  inv = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), inv),
+                      _mm256_fnmadd_ps(_mm256_mul_ps(vlen, inv), inv, _mm256_set1_ps(3.0f)));
+  for (; n < 64; n += 8)
+    _mm256_storeu_ps(desc + n, _mm256_mul_ps(_mm256_loadu_ps(desc + n), inv));
+#endif
+  const float inv_len = 1.0f/sqrtf(len);
+  for (; n < 64; n++)
+    desc[n] *= inv_len;
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void msurf_descriptor(const TEvolution& e, float* desc, float xf, float yf,
+                             float co, float si, int scale) {
+  msurf_descriptor_t<false, float>(e.Lx, e.Ly, desc, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void msurf_upright_descriptor(const TEvolution& e, float* desc, float xf, float yf, int scale) {
+  msurf_descriptor_t<true, float>(e.Lx, e.Ly, desc, xf, yf, 1.0f, 0.0f, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void msurf_descriptor_half(const TEvolution& e, float* desc, float xf, float yf,
+                                  float co, float si, int scale) {
+  msurf_descriptor_t<false, unsigned short>(e.Lx16, e.Ly16, desc, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void msurf_upright_descriptor_half(const TEvolution& e, float* desc, float xf, float yf, int scale) {
+  msurf_descriptor_t<true, unsigned short>(e.Lx16, e.Ly16, desc, xf, yf, 1.0f, 0.0f, scale);
+}
+
+/* ************************************************************************* */
+/// Number of bits set in a 64 bit word
+AKAZE_KERNELS_TARGET
+static inline int popcount64(unsigned long long v) {
+
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((v * 0x0101010101010101ULL) >> 56);
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void hamming_distances(const unsigned char* query, const cv::Mat& train, int* dist) {
+
+  const int nbytes = train.cols;
+
+#if defined(AKAZE_KERNELS_AVX512)
+  // Population count of the bytes with a lookup of their nibbles, summed per 64 bit lane
+  const __m512i lut = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+  const __m512i low = _mm512_set1_epi8(0x0f);
+#elif defined(AKAZE_KERNELS_AVX2)
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+#endif
+
+  // Rows padded to a multiple of 64 bytes have no tail. The rows are only read with aligned
+  // loads when all of them start at 64 byte boundaries, the query may be at any address
+#if defined(AKAZE_KERNELS_AVX512) || defined(AKAZE_KERNELS_AVX2)
+  const bool aligned = (train.step[0] % 64 == 0 && (size_t)train.data % 64 == 0);
+#endif
+
+  for (int i = 0; i < train.rows; i++) {
+    const unsigned char* desc = train.ptr<unsigned char>(i);
+    int j = 0, d = 0;
+
+#if defined(AKAZE_KERNELS_AVX512)
+    __m512i acc = _mm512_setzero_si512();
+    for (; j + 64 <= nbytes; j += 64) {
+      __m512i y = (aligned ? _mm512_load_si512(desc + j) : _mm512_loadu_si512(desc + j));
+      __m512i x = _mm512_xor_si512(_mm512_loadu_si512(query + j), y);
+      __m512i cnt = _mm512_add_epi8(_mm512_shuffle_epi8(lut, _mm512_and_si512(x, low)),
+                                    _mm512_shuffle_epi8(lut, _mm512_and_si512(_mm512_srli_epi16(x, 4), low)));
+      acc = _mm512_add_epi64(acc, _mm512_sad_epu8(cnt, _mm512_setzero_si512()));
+    }
+    long long lanes[8];
+    _mm512_storeu_si512(lanes, acc);
+    for (int k = 0; k < 8; k++)
+      d += (int)lanes[k];
+#elif defined(AKAZE_KERNELS_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+    for (; j + 32 <= nbytes; j += 32) {
+      __m256i y = (aligned ? _mm256_load_si256((const __m256i*)(desc + j)) :
+                             _mm256_loadu_si256((const __m256i*)(desc + j)));
+      __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(query + j)), y);
+      __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    __m128i acc2 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    d += _mm_cvtsi128_si32(acc2) + _mm_extract_epi32(acc2, 2);
+#endif
+
+    for (; j + 8 <= nbytes; j += 8) {
+      unsigned long long a = 0, b = 0;
+      memcpy(&a, query + j, sizeof(a));
+      memcpy(&b, desc + j, sizeof(b));
+      d += popcount64(a ^ b);
+    }
+
+    for (; j < nbytes; j++)
+      d += popcount64((unsigned long long)(query[j] ^ desc[j]));
+
+    dist[i] = d;
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void int8_dot_products(const signed char* query, const cv::Mat& train, int* dot) {
+
+  // The signs of the query are moved to the row, so that the unsigned by signed products of
+  // pmaddubsw give the products of the values. They do not saturate for values in [-127, 127]
+#if defined(AKAZE_KERNELS_AVX512)
+  const __m512i q = _mm512_loadu_si512(query);
+  const __m512i qabs = _mm512_abs_epi8(q);
+  const __mmask64 qneg = _mm512_movepi8_mask(q);
+  const __m512i ones = _mm512_set1_epi16(1);
+#elif defined(AKAZE_KERNELS_AVX2)
+  const __m256i q0 = _mm256_loadu_si256((const __m256i*)query);
+  const __m256i q1 = _mm256_loadu_si256((const __m256i*)(query + 32));
+  const __m256i qabs0 = _mm256_abs_epi8(q0), qabs1 = _mm256_abs_epi8(q1);
+  const __m256i ones = _mm256_set1_epi16(1);
+#endif
+
+  for (int i = 0; i < train.rows; i++) {
+    const signed char* desc = train.ptr<signed char>(i);
+
+#if defined(AKAZE_KERNELS_AVX512)
+    __m512i d = _mm512_loadu_si512(desc);
+    d = _mm512_mask_sub_epi8(d, qneg, _mm512_setzero_si512(), d);
+    __m512i sums = _mm512_madd_epi16(_mm512_maddubs_epi16(qabs, d), ones);
+    int lanes[16];
+    _mm512_storeu_si512(lanes, sums);
+    int s = 0;
+    for (int k = 0; k < 16; k++)
+      s += lanes[k];
+    dot[i] = s;
+#elif defined(AKAZE_KERNELS_AVX2)
+    __m256i d0 = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)desc), q0);
+    __m256i d1 = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)(desc + 32)), q1);
+    __m256i s = _mm256_add_epi32(_mm256_madd_epi16(_mm256_maddubs_epi16(qabs0, d0), ones),
+                                 _mm256_madd_epi16(_mm256_maddubs_epi16(qabs1, d1), ones));
+    __m128i s2 = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    s2 = _mm_add_epi32(s2, _mm_shuffle_epi32(s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s2 = _mm_add_epi32(s2, _mm_shuffle_epi32(s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    dot[i] = _mm_cvtsi128_si32(s2);
+#else
+    int d = 0;
+    for (int j = 0; j < 64; j++)
+      d += query[j]*desc[j];
+    dot[i] = d;
+#endif
+  }
+}
+
+/* ************************************************************************* */
+AKAZE_KERNELS_TARGET
+static void pca_projection(const float* src, const float* projection, const float* bias,
+                           int ncomponents, float* dst) {
+
+  int r = 0;
+#ifdef AKAZE_KERNELS_AVX2
+  // Blocks of 4 components, the descriptor stays in 8 registers
+  __m256 x[8];
+  for (int k = 0; k < 8; k++)
+    x[k] = _mm256_loadu_ps(src + 8*k);
+
+  for (; r + 4 <= ncomponents; r += 4) {
+    const float* p = projection + 64*r;
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+
+    for (int k = 0; k < 8; k++) {
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(p + 8*k), x[k], acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(p + 64 + 8*k), x[k], acc1);
+      acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(p + 128 + 8*k), x[k], acc2);
+      acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(p + 192 + 8*k), x[k], acc3);
+    }
+
+    dst[r] = bias[r] + hsum_ps(acc0);
+    dst[r+1] = bias[r+1] + hsum_ps(acc1);
+    dst[r+2] = bias[r+2] + hsum_ps(acc2);
+    dst[r+3] = bias[r+3] + hsum_ps(acc3);
+  }
+
+  for (; r < ncomponents; r++) {
+    const float* p = projection + 64*r;
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < 8; k++)
+      acc = _mm256_fmadd_ps(_mm256_loadu_ps(p + 8*k), x[k], acc);
+    dst[r] = bias[r] + hsum_ps(acc);
+  }
+#endif
+
+  for (; r < ncomponents; r++) {
+    const float* p = projection + 64*r;
+    float sum = 0.0f;
+    for (int k = 0; k < 64; k++)
+      sum += p[k]*src[k];
+    dst[r] = bias[r] + sum;
+  }
+}
+
+/* ************************************************************************* */
+#define AKAZE_KERNELS_STR_(x) #x
+#define AKAZE_KERNELS_STR(x) AKAZE_KERNELS_STR_(x)
+
+const AKAZEKernels& kernels() {
+
+  static const AKAZEKernels table = {
+    AKAZE_KERNELS_STR(AKAZE_KERNELS_ISA),
+    pm_g1,
+    pm_g2,
+    weickert_diffusivity,
+    charbonnier_diffusivity,
+    compute_scharr_derivatives,
+    nld_step_scalar,
+    compute_determinant_hessian,
+    mldb_fill_values,
+    mldb_fill_upright_values,
+    mldb_binary_comparisons,
+    convert_to_half,
+    convert_from_half,
+    mldb_fill_values_half,
+    mldb_fill_upright_values_half,
+    fixed_diffusivity,
+    fixed_sep_filter,
+    nld_step_fixed,
+    fixed_determinant_hessian,
+    nld_flux_rows,
+    pack_descriptor_plane,
+    mldb_fill_values_plane,
+    mldb_fill_upright_values_plane,
+    mldb_gather_values,
+    mldb_gather_values_half,
+    mldb_gather_values_plane,
+    msurf_descriptor,
+    msurf_upright_descriptor,
+    hamming_distances,
+    int8_dot_products,
+    pca_projection,
+    nld_step_guarded,
+    nld_step_fixed_guarded,
+    msurf_descriptor_half,
+    msurf_upright_descriptor_half
+  };
+
+  return table;
+}
+
+#undef AKAZE_KERNELS_STR
+#undef AKAZE_KERNELS_STR_
+
+}
+}
@@ -20,6 +20,7 @@
  */
 
 #include "nldiffusion_functions.h"
+#include "kernels.h"
 #include <opencv2/imgproc/imgproc.hpp>
 
 using namespace std;
@@ -41,79 +42,36 @@ void gaussian_2D_convolution(const cv::Mat& src, cv::Mat& dst, size_t ksize_x,
   if ((ksize_y % 2) == 0)
     ksize_y += 1;
 
-  // Perform the Gaussian Smoothing with border replication
-  cv::GaussianBlur(src, dst, cv::Size(ksize_x, ksize_y), sigma, sigma, cv::BORDER_REPLICATE);
+  // Perform the Gaussian Smoothing with border replication. The pixels out of
+  // the ROI (e.g. the guard band of the evolution) are not used
+  cv::GaussianBlur(src, dst, cv::Size(ksize_x, ksize_y), sigma, sigma,
+                   cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
 }
 
 /* ************************************************************************* */
 void image_derivatives_scharr(const cv::Mat& src, cv::Mat& dst,
                               const size_t xorder, const size_t yorder) {
-  cv::Scharr(src, dst, CV_32F, xorder, yorder, 1.0, 0, cv::BORDER_DEFAULT);
+  cv::Scharr(src, dst, CV_32F, xorder, yorder, 1.0, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
 }
 
 /* ************************************************************************* */
 void pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
-
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++)
-      dst_row[x] = (-inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
-  }
-
-  cv::exp(dst, dst);
+  libAKAZE::active_kernels().pm_g1(Lx, Ly, dst, k);
 }
 
 /* ************************************************************************* */
 void pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
-
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++)
-      dst_row[x] = 1.0 / (1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
-  }
+  libAKAZE::active_kernels().pm_g2(Lx, Ly, dst, k);
 }
 
 /* ************************************************************************* */
 void weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
-
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++) {
-      float dL = inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
-      dst_row[x] = -3.315/(dL*dL*dL*dL);
-    }
-  }
-
-  cv::exp(dst, dst);
-  dst = 1.0 - dst;
+  libAKAZE::active_kernels().weickert_diffusivity(Lx, Ly, dst, k);
 }
 
 /* ************************************************************************* */
 void charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
-
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++) {
-      float den = sqrt(1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
-      dst_row[x] = 1.0 / den;
-    }
-  }
+  libAKAZE::active_kernels().charbonnier_diffusivity(Lx, Ly, dst, k);
 }
 
 /* ************************************************************************* */
@@ -200,117 +158,12 @@ float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
 /* ************************************************************************* */
 void compute_scharr_derivatives(const cv::Mat& src, cv::Mat& dst, const size_t xorder,
                                 const size_t yorder, const size_t scale) {
-
-  cv::Mat kx, ky;
-  compute_derivative_kernels(kx, ky, xorder, yorder, scale);
-  cv::sepFilter2D(src, dst, CV_32F, kx, ky);
+  libAKAZE::active_kernels().compute_scharr_derivatives(src, dst, xorder, yorder, scale);
 }
 
 /* ************************************************************************* */
 void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
-
-  Lstep = cv::Scalar(0);
-
-  // Diffusion all the image except borders
-#ifdef _OPENMP
-  omp_set_num_threads(OMP_MAX_THREADS);
-#pragma omp parallel for schedule(dynamic)
-#endif
-  for (int y = 1; y < Lstep.rows-1; y++) {
-    const float* c_row = c.ptr<float>(y);
-    const float* c_row_p = c.ptr<float>(y+1);
-    const float* c_row_m = c.ptr<float>(y-1);
-
-    float* Ld_row = Ld.ptr<float>(y);
-    float* Ld_row_p = Ld.ptr<float>(y+1);
-    float* Ld_row_m = Ld.ptr<float>(y-1);
-    float* Lstep_row = Lstep.ptr<float>(y);
-
-    for (int x = 1; x < Lstep.cols-1; x++) {
-      float xpos =  (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
-      float xneg =  (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-      float ypos =  (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-      float yneg =  (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
-      Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos-yneg);
-    }
-  }
-
-  // First row
-  const float* c_row = c.ptr<float>(0);
-  const float* c_row_p = c.ptr<float>(1);
-  float* Ld_row = Ld.ptr<float>(0);
-  float* Ld_row_p = Ld.ptr<float>(1);
-  float* Lstep_row = Lstep.ptr<float>(0);
-
-  for (int x = 1; x < Lstep.cols-1; x++) {
-    float xpos = (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
-    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-    float ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-    Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos);
-  }
-
-  float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
-  float ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
-  Lstep_row[0] = 0.5*stepsize*(xpos + ypos);
-
-  int x = Lstep.cols-1;
-  float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-  ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-  Lstep_row[x] = 0.5*stepsize*(-xneg + ypos);
-
-  // Last row
-  c_row = c.ptr<float>(Lstep.rows-1);
-  c_row_p = c.ptr<float>(Lstep.rows-2);
-  Ld_row = Ld.ptr<float>(Lstep.rows-1);
-  Ld_row_p = Ld.ptr<float>(Lstep.rows-2);
-  Lstep_row = Lstep.ptr<float>(Lstep.rows-1);
-
-  for (int x = 1; x < Lstep.cols-1; x++) {
-    float xpos = (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
-    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-    float ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-    Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos);
-  }
-
-  xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
-  ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
-  Lstep_row[0] = 0.5*stepsize*(xpos + ypos);
-
-  x = Lstep.cols-1;
-  xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-  ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-  Lstep_row[x] = 0.5*stepsize*(-xneg + ypos);
-
-  // First and last columns
-  for (int i = 1; i < Lstep.rows-1; i++) {
-
-    const float* c_row = c.ptr<float>(i);
-    const float* c_row_m = c.ptr<float>(i-1);
-    const float* c_row_p = c.ptr<float>(i+1);
-    float* Ld_row = Ld.ptr<float>(i);
-    float* Ld_row_p = Ld.ptr<float>(i+1);
-    float* Ld_row_m = Ld.ptr<float>(i-1);
-    Lstep_row = Lstep.ptr<float>(i);
-
-    float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
-    float ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
-    float yneg = (c_row_m[0]+c_row[0])*(Ld_row[0]-Ld_row_m[0]);
-    Lstep_row[0] = 0.5*stepsize*(xpos+ypos-yneg);
-
-    float xneg = (c_row[Lstep.cols-2]+c_row[Lstep.cols-1])*(Ld_row[Lstep.cols-1]-Ld_row[Lstep.cols-2]);
-    ypos = (c_row[Lstep.cols-1]+c_row_p[Lstep.cols-1])*(Ld_row_p[Lstep.cols-1]-Ld_row[Lstep.cols-1]);
-    yneg = (c_row_m[Lstep.cols-1]+c_row[Lstep.cols-1])*(Ld_row[Lstep.cols-1]-Ld_row_m[Lstep.cols-1]);
-    Lstep_row[Lstep.cols-1] = 0.5*stepsize*(-xneg+ypos-yneg);
-  }
-
-  // Ld = Ld + Lstep
-  for (int y = 0; y < Lstep.rows; y++) {
-    float* Ld_row = Ld.ptr<float>(y);
-    float* Lstep_row = Lstep.ptr<float>(y);
-    for (int x = 0; x < Lstep.cols; x++) {
-      Ld_row[x] = Ld_row[x] + Lstep_row[x];
-    }
-  }
+  libAKAZE::active_kernels().nld_step_scalar(Ld, c, Lstep, stepsize);
 }
 
 /* ************************************************************************* */
@@ -364,6 +217,70 @@ void compute_derivative_kernels(cv::OutputArray kx_, cv::OutputArray ky_,
   }
 }
 
+/* ************************************************************************* */
+void compute_fixed_diffusivity_lut(DIFFUSIVITY_TYPE diffusivity, float k,
+                                   std::vector<unsigned short>& lut) {
+
+  // Squared gradient of the normalized Scharr kernel over k^2
+  const double inv_k = (32.0*32.0)/((double)k*k*(double)(1 << (2*libAKAZE::fixed_derivative_bits)));
+  const double one = (double)(1 << libAKAZE::fixed_diffusivity_bits);
+
+  lut.resize(libAKAZE::fixed_lut_size);
+
+  for (int i = 0; i < libAKAZE::fixed_lut_size; i++) {
+
+    // Middle of the bin of fixed_lut_index
+    double v = i;
+    if (i >= 64) {
+      int e = (i >> 6) + 5;
+      double width = ldexp(1.0, e - 6);
+      v = (64 + (i & 63))*width + 0.5*(width - 1.0);
+    }
+
+    double dL = inv_k*v, g = 1.0;
+    switch (diffusivity) {
+      case PM_G1:
+        g = exp(-dL);
+      break;
+      case PM_G2:
+        g = 1.0/(1.0 + dL);
+      break;
+      case WEICKERT:
+        g = (dL > 0.0 ? 1.0 - exp(-3.315/(dL*dL*dL*dL)) : 1.0);
+      break;
+      case CHARBONNIER:
+        g = 1.0/sqrt(1.0 + dL);
+      break;
+      default:
+        cerr << "Diffusivity: " << diffusivity << " is not supported" << endl;
+    }
+
+    lut[i] = (unsigned short)min(max(floor(g*one + 0.5), 0.0), one);
+  }
+}
+
+/* ************************************************************************* */
+void compute_fixed_derivative_kernels(cv::Mat& kx, cv::Mat& ky, const size_t dx,
+                                      const size_t dy, const size_t scale) {
+
+  cv::Mat fkx, fky;
+  compute_derivative_kernels(fkx, fky, dx, dy, scale);
+  fkx.convertTo(kx, CV_32S, (double)(1 << libAKAZE::fixed_tap_bits));
+  fky.convertTo(ky, CV_32S, (double)(1 << libAKAZE::fixed_tap_bits));
+}
+
+/* ************************************************************************* */
+void compute_fixed_gaussian_kernel(cv::Mat& kernel, float sigma) {
+
+  // Same kernel size as gaussian_2D_convolution
+  int ksize = ceil(2.0*(1.0 + (sigma-0.8)/(0.3)));
+  if ((ksize % 2) == 0)
+    ksize += 1;
+
+  cv::getGaussianKernel(ksize, sigma, CV_32F).convertTo(kernel, CV_32S,
+                                                        (double)(1 << libAKAZE::fixed_tap_bits));
+}
+
 /* ************************************************************************* */
 bool check_maximum_neighbourhood(const cv::Mat& img, int dsize, float value,
                                  int row, int col, bool same_img) {
@@ -92,6 +92,10 @@ void compute_scharr_derivatives(const cv::Mat& src, cv::Mat& dst, const size_t x
 /// @note Forward Euler Scheme 3x3 stencil
 /// The function c is a scalar value that depends on the gradient norm
 /// dL_by_ds = d(c dL_by_dx)_by_dx + d(c dL_by_dy)_by_dy
+/// The first and last rows and columns have zero flux across the image borders, and
+/// nothing outside Ld and c is read or written. The AKAZE evolution uses the guarded
+/// kernel of AKAZEKernels instead (nld_step_guarded), which reads the replicated borders
+/// from a one pixel guard band around Ld and c
 void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize);
 
 /// This function downsamples the input image using OpenCV resize
@@ -108,6 +112,31 @@ void halfsample_image(const cv::Mat& src, cv::Mat& dst);
 void compute_derivative_kernels(cv::OutputArray kx_, cv::OutputArray ky_,
                                 const size_t dx, const size_t dy, const size_t scale);
 
+/// This function computes the lookup table of the fixed point conductivity (ENGINE_FIXED)
+/// @param diffusivity Diffusivity type
+/// @param k Contrast factor parameter, for the gradients of image_derivatives_scharr
+/// @param lut Output table with fixed_lut_size entries, indexed by fixed_lut_index
+/// @note The fixed point gradients are computed with the normalized Scharr kernel, which is
+/// 1/32 of the kernel of image_derivatives_scharr. The conductivities have fixed_diffusivity_bits
+/// fractional bits and every entry is the conductivity in the middle of its bin
+void compute_fixed_diffusivity_lut(DIFFUSIVITY_TYPE diffusivity, float k,
+                                   std::vector<unsigned short>& lut);
+
+/// This function computes the fixed point taps (CV_32S) of the Scharr derivative kernels
+/// @param kx The derivative kernel in x-direction
+/// @param ky The derivative kernel in y-direction
+/// @param dx The derivative order in x-direction
+/// @param dy The derivative order in y-direction
+/// @param scale The kernel size
+void compute_fixed_derivative_kernels(cv::Mat& kx, cv::Mat& ky, const size_t dx,
+                                      const size_t dy, const size_t scale);
+
+/// This function computes the fixed point taps (CV_32S) of the Gaussian kernel of
+/// gaussian_2D_convolution with automatic kernel size
+/// @param kernel Output kernel, the same in both directions
+/// @param sigma Standard deviation of the Gaussian
+void compute_fixed_gaussian_kernel(cv::Mat& kernel, float sigma);
+
 /// This function checks if a given pixel is a maximum in a local neighbourhood
 /// @param img Input image where we will perform the maximum search
 /// @param dsize Half size of the neighbourhood
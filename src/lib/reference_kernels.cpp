@@ -0,0 +1,1168 @@
+//=============================================================================
+//
+// reference_kernels.cpp
+// Authors: Pablo F. Alcantarilla (1), Jesus Nuevo (2)
+// Institutions: Toshiba Research Europe Ltd (1)
+//               TrueVision Solutions (2)
+// Date: 07/10/2014
+// Email: pablofdezalc@gmail.com
+//
+// AKAZE Features Copyright 2014, Pablo F. Alcantarilla, Jesus Nuevo
+// All Rights Reserved
+// See LICENSE for the license information
+//=============================================================================
+
+/**
+ * @file reference_kernels.cpp
+ * @brief Scalar reference implementations of the hot kernels of the library
+ * @note These functions are kept as they were before any optimization. They are
+ * only used to check the optimized kernels, see akaze_conformance.cpp
+ * @date Oct 07, 2014
+ * @author Pablo F. Alcantarilla, Jesus Nuevo
+ */
+
+#include "AKAZE.h"
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+using namespace libAKAZE;
+
+/* ************************************************************************* */
+void reference::pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = (-inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+
+  cv::exp(dst, dst);
+}
+
+/* ************************************************************************* */
+void reference::pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = 1.0 / (1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+}
+
+/* ************************************************************************* */
+void reference::weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++) {
+      float dL = inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
+      dst_row[x] = -3.315/(dL*dL*dL*dL);
+    }
+  }
+
+  cv::exp(dst, dst);
+  dst = 1.0 - dst;
+}
+
+/* ************************************************************************* */
+void reference::charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  cv::Size sz = Lx.size();
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++) {
+      float den = sqrt(1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+      dst_row[x] = 1.0 / den;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::compute_scharr_derivatives(const cv::Mat& src, cv::Mat& dst, const size_t xorder,
+                                const size_t yorder, const size_t scale) {
+
+  cv::Mat kx, ky;
+  ::compute_derivative_kernels(kx, ky, xorder, yorder, scale);
+  // BORDER_ISOLATED: the guard band of the evolution matrices is not part of the image
+  cv::sepFilter2D(src, dst, CV_32F, kx, ky, cv::Point(-1,-1), 0,
+                  cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+}
+
+/* ************************************************************************* */
+void reference::nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
+
+  Lstep = cv::Scalar(0);
+
+  // Diffusion all the image except borders
+#ifdef _OPENMP
+  omp_set_num_threads(OMP_MAX_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int y = 1; y < Lstep.rows-1; y++) {
+    const float* c_row = c.ptr<float>(y);
+    const float* c_row_p = c.ptr<float>(y+1);
+    const float* c_row_m = c.ptr<float>(y-1);
+
+    float* Ld_row = Ld.ptr<float>(y);
+    float* Ld_row_p = Ld.ptr<float>(y+1);
+    float* Ld_row_m = Ld.ptr<float>(y-1);
+    float* Lstep_row = Lstep.ptr<float>(y);
+
+    for (int x = 1; x < Lstep.cols-1; x++) {
+      float xpos =  (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+      float xneg =  (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+      float ypos =  (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+      float yneg =  (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
+      Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos-yneg);
+    }
+  }
+
+  // First row
+  const float* c_row = c.ptr<float>(0);
+  const float* c_row_p = c.ptr<float>(1);
+  float* Ld_row = Ld.ptr<float>(0);
+  float* Ld_row_p = Ld.ptr<float>(1);
+  float* Lstep_row = Lstep.ptr<float>(0);
+
+  for (int x = 1; x < Lstep.cols-1; x++) {
+    float xpos = (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+    float ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+    Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos);
+  }
+
+  float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
+  float ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
+  Lstep_row[0] = 0.5*stepsize*(xpos + ypos);
+
+  int x = Lstep.cols-1;
+  float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+  ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+  Lstep_row[x] = 0.5*stepsize*(-xneg + ypos);
+
+  // Last row
+  c_row = c.ptr<float>(Lstep.rows-1);
+  c_row_p = c.ptr<float>(Lstep.rows-2);
+  Ld_row = Ld.ptr<float>(Lstep.rows-1);
+  Ld_row_p = Ld.ptr<float>(Lstep.rows-2);
+  Lstep_row = Lstep.ptr<float>(Lstep.rows-1);
+
+  for (int x = 1; x < Lstep.cols-1; x++) {
+    float xpos = (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+    float xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+    float ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+    Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos);
+  }
+
+  xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
+  ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
+  Lstep_row[0] = 0.5*stepsize*(xpos + ypos);
+
+  x = Lstep.cols-1;
+  xneg = (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+  ypos = (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+  Lstep_row[x] = 0.5*stepsize*(-xneg + ypos);
+
+  // First and last columns
+  for (int i = 1; i < Lstep.rows-1; i++) {
+
+    const float* c_row = c.ptr<float>(i);
+    const float* c_row_m = c.ptr<float>(i-1);
+    const float* c_row_p = c.ptr<float>(i+1);
+    float* Ld_row = Ld.ptr<float>(i);
+    float* Ld_row_p = Ld.ptr<float>(i+1);
+    float* Ld_row_m = Ld.ptr<float>(i-1);
+    Lstep_row = Lstep.ptr<float>(i);
+
+    float xpos = (c_row[0]+c_row[1])*(Ld_row[1]-Ld_row[0]);
+    float ypos = (c_row[0]+c_row_p[0])*(Ld_row_p[0]-Ld_row[0]);
+    float yneg = (c_row_m[0]+c_row[0])*(Ld_row[0]-Ld_row_m[0]);
+    Lstep_row[0] = 0.5*stepsize*(xpos+ypos-yneg);
+
+    float xneg = (c_row[Lstep.cols-2]+c_row[Lstep.cols-1])*(Ld_row[Lstep.cols-1]-Ld_row[Lstep.cols-2]);
+    ypos = (c_row[Lstep.cols-1]+c_row_p[Lstep.cols-1])*(Ld_row_p[Lstep.cols-1]-Ld_row[Lstep.cols-1]);
+    yneg = (c_row_m[Lstep.cols-1]+c_row[Lstep.cols-1])*(Ld_row[Lstep.cols-1]-Ld_row_m[Lstep.cols-1]);
+    Lstep_row[Lstep.cols-1] = 0.5*stepsize*(-xneg+ypos-yneg);
+  }
+
+  // Ld = Ld + Lstep
+  for (int y = 0; y < Lstep.rows; y++) {
+    float* Ld_row = Ld.ptr<float>(y);
+    float* Lstep_row = Lstep.ptr<float>(y);
+    for (int x = 0; x < Lstep.cols; x++) {
+      Ld_row[x] = Ld_row[x] + Lstep_row[x];
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::nld_flux_rows(const cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep,
+                              const float stepsize, int y0, int y1) {
+
+  // Clamped neighbours give zero flux across the image borders, as in nld_step_scalar
+  for (int y = y0; y < y1; y++) {
+    int ym = std::max(y-1, 0), yp = std::min(y+1, Lstep.rows-1);
+    for (int x = 0; x < Lstep.cols; x++) {
+      int xm = std::max(x-1, 0), xp = std::min(x+1, Lstep.cols-1);
+      float xpos = (c.at<float>(y,x)+c.at<float>(y,xp))*(Ld.at<float>(y,xp)-Ld.at<float>(y,x));
+      float xneg = (c.at<float>(y,xm)+c.at<float>(y,x))*(Ld.at<float>(y,x)-Ld.at<float>(y,xm));
+      float ypos = (c.at<float>(y,x)+c.at<float>(yp,x))*(Ld.at<float>(yp,x)-Ld.at<float>(y,x));
+      float yneg = (c.at<float>(ym,x)+c.at<float>(y,x))*(Ld.at<float>(y,x)-Ld.at<float>(ym,x));
+      Lstep.at<float>(y,x) = 0.5*stepsize*(xpos-xneg + ypos-yneg);
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::compute_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                            cv::Mat& Ldet, const float scale) {
+
+  for (int ix = 0; ix < Ldet.rows; ix++) {
+    const float* lxx = Lxx.ptr<float>(ix);
+    const float* lxy = Lxy.ptr<float>(ix);
+    const float* lyy = Lyy.ptr<float>(ix);
+    float* ldet = Ldet.ptr<float>(ix);
+    for (int jx = 0; jx < Ldet.cols; jx++)
+      ldet[jx] = (lxx[jx]*lyy[jx]-lxy[jx]*lxy[jx])*scale;
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_values(const TEvolution& e, float* values, int sample_step,
+                                 int pattern_size, int nchannels, float xf, float yf,
+                                 float co, float si, float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + (l*co*scale + k*si*scale);
+          float sample_x = xf + (-l*si*scale + k*co*scale);
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          float ri = *(e.Lt.ptr<float>(y1)+x1);
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = *(e.Lx.ptr<float>(y1)+x1);
+            float ry = *(e.Ly.ptr<float>(y1)+x1);
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              float rry = rx*co + ry*si;
+              float rrx = -rx*si + ry*co;
+              dx += rrx;
+              dy += rry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_upright_values(const TEvolution& e, float* values, int sample_step,
+                                         int pattern_size, int nchannels, float xf, float yf,
+                                         float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + l*scale;
+          float sample_x = xf + k*scale;
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          float ri = *(e.Lt.ptr<float>(y1)+x1);
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = *(e.Lx.ptr<float>(y1)+x1);
+            float ry = *(e.Ly.ptr<float>(y1)+x1);
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              dx += rx;
+              dy += ry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_binary_comparisons(const float* values, unsigned char* desc,
+                                        int count, int nchannels, int& dpos) {
+
+  int nr_channels = nchannels;
+
+  for(int pos = 0; pos < nr_channels; pos++) {
+    for (int i = 0; i < count; i++) {
+      float ival = values[nr_channels * i + pos];
+      for (int j = i + 1; j < count; j++) {
+        int res = ival > values[nr_channels * j + pos];
+        desc[dpos >> 3] |= (res << (dpos & 7));
+        dpos++;
+      }
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::convert_to_half(const cv::Mat& src, cv::Mat& dst) {
+
+  dst.create(src.size(), CV_16U);
+
+  for (int y = 0; y < src.rows; y++) {
+    const float* src_row = src.ptr<float>(y);
+    unsigned short* dst_row = dst.ptr<unsigned short>(y);
+    for (int x = 0; x < src.cols; x++)
+      dst_row[x] = float_to_half(src_row[x]);
+  }
+}
+
+/* ************************************************************************* */
+void reference::convert_from_half(const unsigned short* src, float* dst, int n) {
+
+  for (int i = 0; i < n; i++)
+    dst[i] = half_to_float(src[i]);
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_values_half(const TEvolution& e, float* values, int sample_step,
+                                      int pattern_size, int nchannels, float xf, float yf,
+                                      float co, float si, float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + (l*co*scale + k*si*scale);
+          float sample_x = xf + (-l*si*scale + k*co*scale);
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          float ri = half_to_float(*(e.Lt16.ptr<unsigned short>(y1)+x1));
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = half_to_float(*(e.Lx16.ptr<unsigned short>(y1)+x1));
+            float ry = half_to_float(*(e.Ly16.ptr<unsigned short>(y1)+x1));
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              float rry = rx*co + ry*si;
+              float rrx = -rx*si + ry*co;
+              dx += rrx;
+              dy += rry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_upright_values_half(const TEvolution& e, float* values, int sample_step,
+                                              int pattern_size, int nchannels, float xf, float yf,
+                                              float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + l*scale;
+          float sample_x = xf + k*scale;
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          float ri = half_to_float(*(e.Lt16.ptr<unsigned short>(y1)+x1));
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = half_to_float(*(e.Lx16.ptr<unsigned short>(y1)+x1));
+            float ry = half_to_float(*(e.Ly16.ptr<unsigned short>(y1)+x1));
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              dx += rx;
+              dy += ry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::fixed_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
+                                  const unsigned short* lut) {
+
+  for (int y = 0; y < Lx.rows; y++) {
+    const short* Lx_row = Lx.ptr<short>(y);
+    const short* Ly_row = Ly.ptr<short>(y);
+    short* dst_row = dst.ptr<short>(y);
+    for (int x = 0; x < Lx.cols; x++) {
+      int lx = Lx_row[x], ly = Ly_row[x];
+      unsigned int v = (unsigned int)(lx*lx) + (unsigned int)(ly*ly);
+      dst_row[x] = (short)lut[fixed_lut_index(v)];
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::fixed_sep_filter(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kx,
+                                 const cv::Mat& ky, int shift, int border) {
+
+  const int* kx_taps = kx.ptr<int>(0);
+  const int* ky_taps = ky.ptr<int>(0);
+  const int kx_size = (int)kx.total(), ky_size = (int)ky.total();
+  const int vshift = fixed_tap_bits - 2;
+  const int hround = (shift > 0 ? 1 << (shift-1) : 0);
+
+  // Vertical pass, with 2 more fractional bits than the source
+  cv::Mat tmp(src.size(), CV_32S);
+  for (int y = 0; y < src.rows; y++) {
+    for (int x = 0; x < src.cols; x++) {
+      int acc = 0;
+      for (int k = 0; k < ky_size; k++) {
+        int yk = cv::borderInterpolate(y + k - ky_size/2, src.rows, border);
+        acc += ky_taps[k]*(*(src.ptr<short>(yk)+x));
+      }
+      *(tmp.ptr<int>(y)+x) = (acc + (1 << (vshift-1))) >> vshift;
+    }
+  }
+
+  // Horizontal pass
+  dst.create(src.size(), CV_16S);
+  for (int y = 0; y < src.rows; y++) {
+    for (int x = 0; x < src.cols; x++) {
+      int acc = 0;
+      for (int k = 0; k < kx_size; k++) {
+        int xk = cv::borderInterpolate(x + k - kx_size/2, src.cols, border);
+        acc += kx_taps[k]*(*(tmp.ptr<int>(y)+xk));
+      }
+      *(dst.ptr<short>(y)+x) = cv::saturate_cast<short>((acc + hround) >> shift);
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::nld_step_fixed(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
+
+  int m = 0, shift = 0, bits = 0;
+  fixed_step_parameters(stepsize, m, shift, bits);
+
+  const int lap_shift = fixed_diffusivity_bits - bits;
+  const int step_shift = bits + shift;
+  const int lap_round = (lap_shift > 0 ? 1 << (lap_shift-1) : 0);
+  const int step_round = (step_shift > 0 ? 1 << (step_shift-1) : 0);
+
+  // The borders are replicated, which gives zero flux across them
+  for (int y = 0; y < Ld.rows; y++) {
+    int ym = max(y-1, 0), yp = min(y+1, Ld.rows-1);
+
+    for (int x = 0; x < Ld.cols; x++) {
+      int xm = max(x-1, 0), xp = min(x+1, Ld.cols-1);
+
+      int l = *(Ld.ptr<short>(y)+x);
+      int cc = *(c.ptr<short>(y)+x);
+
+      int acc = (cc + *(c.ptr<short>(y)+xp))*cv::saturate_cast<short>(*(Ld.ptr<short>(y)+xp) - l) +
+                (cc + *(c.ptr<short>(y)+xm))*cv::saturate_cast<short>(*(Ld.ptr<short>(y)+xm) - l) +
+                (cc + *(c.ptr<short>(yp)+x))*cv::saturate_cast<short>(*(Ld.ptr<short>(yp)+x) - l) +
+                (cc + *(c.ptr<short>(ym)+x))*cv::saturate_cast<short>(*(Ld.ptr<short>(ym)+x) - l);
+
+      int lap = cv::saturate_cast<short>((acc + lap_round) >> lap_shift);
+      *(Lstep.ptr<short>(y)+x) = cv::saturate_cast<short>((lap*m + step_round) >> step_shift);
+    }
+  }
+
+  for (int y = 0; y < Ld.rows; y++) {
+    for (int x = 0; x < Ld.cols; x++)
+      *(Ld.ptr<short>(y)+x) = cv::saturate_cast<short>(*(Ld.ptr<short>(y)+x) + *(Lstep.ptr<short>(y)+x));
+  }
+}
+
+/* ************************************************************************* */
+void reference::fixed_determinant_hessian(const cv::Mat& Lxx, const cv::Mat& Lxy, const cv::Mat& Lyy,
+                                          cv::Mat& Ldet, const float scale) {
+
+  const float unit = scale / (float)(1 << (2*fixed_derivative_bits));
+
+  for (int y = 0; y < Ldet.rows; y++) {
+    for (int x = 0; x < Ldet.cols; x++) {
+      int lxx = *(Lxx.ptr<short>(y)+x), lxy = *(Lxy.ptr<short>(y)+x), lyy = *(Lyy.ptr<short>(y)+x);
+      *(Ldet.ptr<float>(y)+x) = (float)(lxx*lyy - lxy*lxy)*unit;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::pack_descriptor_plane(const cv::Mat& Lt, const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst) {
+
+  for (int y = 0; y < dst.rows; y++) {
+    for (int x = 0; x < dst.cols; x++) {
+      float* p = dst.ptr<float>(y) + 4*x;
+      p[0] = *(Lt.ptr<float>(y)+x);
+      p[1] = *(Lx.ptr<float>(y)+x);
+      p[2] = *(Ly.ptr<float>(y)+x);
+      p[3] = 0.0f;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_values_plane(const TEvolution& e, float* values, int sample_step,
+                                       int pattern_size, int nchannels, float xf, float yf,
+                                       float co, float si, float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + (l*co*scale + k*si*scale);
+          float sample_x = xf + (-l*si*scale + k*co*scale);
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          const float* p = e.Ldesc.ptr<float>(y1) + 4*x1;
+          float ri = p[0];
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = p[1];
+            float ry = p[2];
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              float rry = rx*co + ry*si;
+              float rrx = -rx*si + ry*co;
+              dx += rrx;
+              dy += rry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_fill_upright_values_plane(const TEvolution& e, float* values, int sample_step,
+                                               int pattern_size, int nchannels, float xf, float yf,
+                                               float scale) {
+
+  int nr_channels = nchannels;
+  int valpos = 0;
+
+  for (int i = -pattern_size; i < pattern_size; i += sample_step) {
+    for (int j = -pattern_size; j < pattern_size; j += sample_step) {
+
+      float di = 0.0, dx = 0.0, dy = 0.0;
+      int nsamples = 0;
+
+      for (int k = i; k < i + sample_step; k++) {
+        for (int l = j; l < j + sample_step; l++) {
+
+          float sample_y = yf + l*scale;
+          float sample_x = xf + k*scale;
+
+          int y1 = fRound(sample_y);
+          int x1 = fRound(sample_x);
+
+          const float* p = e.Ldesc.ptr<float>(y1) + 4*x1;
+          float ri = p[0];
+          di += ri;
+
+          if(nr_channels > 1) {
+            float rx = p[1];
+            float ry = p[2];
+            if (nr_channels == 2) {
+              dx += sqrtf(rx*rx + ry*ry);
+            }
+            else {
+              dx += rx;
+              dy += ry;
+            }
+          }
+          nsamples++;
+        }
+      }
+
+      di /= nsamples;
+      dx /= nsamples;
+      dy /= nsamples;
+
+      values[valpos] = di;
+
+      if (nr_channels > 1)
+        values[valpos + 1] = dx;
+
+      if (nr_channels > 2)
+        values[valpos + 2] = dy;
+
+      valpos += nr_channels;
+    }
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_gather_values(const TEvolution& e, float* values, const short* offsets,
+                                   int ncells, int nsamples, int nchannels, int x0, int y0,
+                                   float co, float si) {
+
+  int nr_channels = nchannels;
+
+  for (int c = 0; c < ncells; c++) {
+
+    float di = 0.0, dx = 0.0, dy = 0.0;
+
+    for (int s = 0; s < nsamples; s++) {
+
+      int x1 = x0 + offsets[2*(c*nsamples+s)];
+      int y1 = y0 + offsets[2*(c*nsamples+s)+1];
+
+      float ri = *(e.Lt.ptr<float>(y1)+x1);
+      di += ri;
+
+      if(nr_channels > 1) {
+        float rx = *(e.Lx.ptr<float>(y1)+x1);
+        float ry = *(e.Ly.ptr<float>(y1)+x1);
+        if (nr_channels == 2) {
+          dx += sqrtf(rx*rx + ry*ry);
+        }
+        else {
+          float rry = rx*co + ry*si;
+          float rrx = -rx*si + ry*co;
+          dx += rrx;
+          dy += rry;
+        }
+      }
+    }
+
+    di /= nsamples;
+    dx /= nsamples;
+    dy /= nsamples;
+
+    values[nr_channels*c] = di;
+
+    if (nr_channels > 1)
+      values[nr_channels*c + 1] = dx;
+
+    if (nr_channels > 2)
+      values[nr_channels*c + 2] = dy;
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_gather_values_half(const TEvolution& e, float* values, const short* offsets,
+                                        int ncells, int nsamples, int nchannels, int x0, int y0,
+                                        float co, float si) {
+
+  int nr_channels = nchannels;
+
+  for (int c = 0; c < ncells; c++) {
+
+    float di = 0.0, dx = 0.0, dy = 0.0;
+
+    for (int s = 0; s < nsamples; s++) {
+
+      int x1 = x0 + offsets[2*(c*nsamples+s)];
+      int y1 = y0 + offsets[2*(c*nsamples+s)+1];
+
+      float ri = half_to_float(*(e.Lt16.ptr<unsigned short>(y1)+x1));
+      di += ri;
+
+      if(nr_channels > 1) {
+        float rx = half_to_float(*(e.Lx16.ptr<unsigned short>(y1)+x1));
+        float ry = half_to_float(*(e.Ly16.ptr<unsigned short>(y1)+x1));
+        if (nr_channels == 2) {
+          dx += sqrtf(rx*rx + ry*ry);
+        }
+        else {
+          float rry = rx*co + ry*si;
+          float rrx = -rx*si + ry*co;
+          dx += rrx;
+          dy += rry;
+        }
+      }
+    }
+
+    di /= nsamples;
+    dx /= nsamples;
+    dy /= nsamples;
+
+    values[nr_channels*c] = di;
+
+    if (nr_channels > 1)
+      values[nr_channels*c + 1] = dx;
+
+    if (nr_channels > 2)
+      values[nr_channels*c + 2] = dy;
+  }
+}
+
+/* ************************************************************************* */
+void reference::mldb_gather_values_plane(const TEvolution& e, float* values, const short* offsets,
+                                         int ncells, int nsamples, int nchannels, int x0, int y0,
+                                         float co, float si) {
+
+  int nr_channels = nchannels;
+
+  for (int c = 0; c < ncells; c++) {
+
+    float di = 0.0, dx = 0.0, dy = 0.0;
+
+    for (int s = 0; s < nsamples; s++) {
+
+      int x1 = x0 + offsets[2*(c*nsamples+s)];
+      int y1 = y0 + offsets[2*(c*nsamples+s)+1];
+
+      const float* p = e.Ldesc.ptr<float>(y1) + 4*x1;
+      float ri = p[0];
+      di += ri;
+
+      if(nr_channels > 1) {
+        float rx = p[1];
+        float ry = p[2];
+        if (nr_channels == 2) {
+          dx += sqrtf(rx*rx + ry*ry);
+        }
+        else {
+          float rry = rx*co + ry*si;
+          float rrx = -rx*si + ry*co;
+          dx += rrx;
+          dy += rry;
+        }
+      }
+    }
+
+    di /= nsamples;
+    dx /= nsamples;
+    dy /= nsamples;
+
+    values[nr_channels*c] = di;
+
+    if (nr_channels > 1)
+      values[nr_channels*c + 1] = dx;
+
+    if (nr_channels > 2)
+      values[nr_channels*c + 2] = dy;
+  }
+}
+
+/* ************************************************************************* */
+/// Loads one sample of a float or half precision plane
+static inline float sample_value(const float* ptr) {
+  return *ptr;
+}
+
+static inline float sample_value(const unsigned short* ptr) {
+  return half_to_float(*ptr);
+}
+
+/* ************************************************************************* */
+/// M-SURF descriptor of the float (T = float) or half precision (T = unsigned short) derivatives
+template <typename T>
+static void msurf_descriptor_t(const cv::Mat& Lx, const cv::Mat& Ly, float* desc, float xf, float yf,
+                               float co, float si, int scale) {
+
+  float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
+  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, ys = 0.0, xs = 0.0;
+  float sample_x = 0.0, sample_y = 0.0;
+  float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
+  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 5, pattern_size = 12;
+  int kx = 0, ky = 0, i = -8, j = 0, dcount = 0;
+
+  // Subregion centers for the 4x4 gaussian weighting
+  float cx = -0.5, cy = 0.5;
+
+  // Area of size 24 s x 24 s
+  while (i < pattern_size) {
+    j = -8;
+    i = i-4;
+
+    cx += 1.0;
+    cy = -0.5;
+
+    while (j < pattern_size) {
+      dx=dy=mdx=mdy=0.0;
+      cy += 1.0;
+      j = j - 4;
+
+      ky = i + sample_step;
+      kx = j + sample_step;
+
+      xs = xf + (-kx*scale*si + ky*scale*co);
+      ys = yf + (kx*scale*co + ky*scale*si);
+
+      for (int k = i; k < i + 9; ++k) {
+        for (int l = j; l < j + 9; ++l) {
+          // Get coords of sample point on the rotated axis
+          sample_y = yf + (l*scale*co + k*scale*si);
+          sample_x = xf + (-l*scale*si + k*scale*co);
+
+          // Get the gaussian weighted x and y responses
+          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.5*scale);
+
+          y1 = fRound(sample_y-.5);
+          x1 = fRound(sample_x-.5);
+
+          y2 = fRound(sample_y+.5);
+          x2 = fRound(sample_x+.5);
+
+          fx = sample_x-x1;
+          fy = sample_y-y1;
+
+          res1 = sample_value(Lx.ptr<T>(y1)+x1);
+          res2 = sample_value(Lx.ptr<T>(y1)+x2);
+          res3 = sample_value(Lx.ptr<T>(y2)+x1);
+          res4 = sample_value(Lx.ptr<T>(y2)+x2);
+          rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+
+          res1 = sample_value(Ly.ptr<T>(y1)+x1);
+          res2 = sample_value(Ly.ptr<T>(y1)+x2);
+          res3 = sample_value(Ly.ptr<T>(y2)+x1);
+          res4 = sample_value(Ly.ptr<T>(y2)+x2);
+          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+
+          // Get the x and y derivatives on the rotated axis
+          rry = gauss_s1*(rx*co + ry*si);
+          rrx = gauss_s1*(-rx*si + ry*co);
+
+          // Sum the derivatives to the cumulative descriptor
+          dx += rrx;
+          dy += rry;
+          mdx += fabs(rrx);
+          mdy += fabs(rry);
+        }
+      }
+
+      // Add the values to the descriptor vector
+      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+      desc[dcount++] = dx*gauss_s2;
+      desc[dcount++] = dy*gauss_s2;
+      desc[dcount++] = mdx*gauss_s2;
+      desc[dcount++] = mdy*gauss_s2;
+
+      len += (dx*dx + dy*dy + mdx*mdx + mdy*mdy)*gauss_s2*gauss_s2;
+
+      j += 9;
+    }
+
+    i += 9;
+  }
+
+  // convert to unit vector
+  len = sqrt(len);
+
+  for (int n = 0; n < 64; n++)
+    desc[n] /= len;
+}
+
+/* ************************************************************************* */
+/// Upright M-SURF descriptor of the float or half precision derivatives
+template <typename T>
+static void msurf_upright_descriptor_t(const cv::Mat& Lx, const cv::Mat& Ly, float* desc, float xf, float yf,
+                                       int scale) {
+
+  float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
+  float rx = 0.0, ry = 0.0, len = 0.0, ys = 0.0, xs = 0.0;
+  float sample_x = 0.0, sample_y = 0.0;
+  float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
+  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 5, pattern_size = 12;
+  int kx = 0, ky = 0, i = -8, j = 0, dcount = 0;
+
+  // Subregion centers for the 4x4 gaussian weighting
+  float cx = -0.5, cy = 0.5;
+
+  // Area of size 24 s x 24 s
+  while (i < pattern_size) {
+    j = -8;
+    i = i-4;
+
+    cx += 1.0;
+    cy = -0.5;
+
+    while (j < pattern_size) {
+      dx=dy=mdx=mdy=0.0;
+      cy += 1.0;
+      j = j-4;
+
+      ky = i + sample_step;
+      kx = j + sample_step;
+
+      ys = yf + (ky*scale);
+      xs = xf + (kx*scale);
+
+      for (int k = i; k < i+9; k++) {
+        for (int l = j; l < j+9; l++) {
+          sample_y = k*scale + yf;
+          sample_x = l*scale + xf;
+
+          //Get the gaussian weighted x and y responses
+          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.50*scale);
+
+          y1 = (int)(sample_y-.5);
+          x1 = (int)(sample_x-.5);
+
+          y2 = (int)(sample_y+.5);
+          x2 = (int)(sample_x+.5);
+
+          fx = sample_x-x1;
+          fy = sample_y-y1;
+
+          res1 = sample_value(Lx.ptr<T>(y1)+x1);
+          res2 = sample_value(Lx.ptr<T>(y1)+x2);
+          res3 = sample_value(Lx.ptr<T>(y2)+x1);
+          res4 = sample_value(Lx.ptr<T>(y2)+x2);
+          rx = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+
+          res1 = sample_value(Ly.ptr<T>(y1)+x1);
+          res2 = sample_value(Ly.ptr<T>(y1)+x2);
+          res3 = sample_value(Ly.ptr<T>(y2)+x1);
+          res4 = sample_value(Ly.ptr<T>(y2)+x2);
+          ry = (1.0-fx)*(1.0-fy)*res1 + fx*(1.0-fy)*res2 + (1.0-fx)*fy*res3 + fx*fy*res4;
+
+          rx = gauss_s1*rx;
+          ry = gauss_s1*ry;
+
+          // Sum the derivatives to the cumulative descriptor
+          dx += rx;
+          dy += ry;
+          mdx += fabs(rx);
+          mdy += fabs(ry);
+        }
+      }
+
+      // Add the values to the descriptor vector
+      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+
+      desc[dcount++] = dx*gauss_s2;
+      desc[dcount++] = dy*gauss_s2;
+      desc[dcount++] = mdx*gauss_s2;
+      desc[dcount++] = mdy*gauss_s2;
+
+      len += (dx*dx + dy*dy + mdx*mdx + mdy*mdy)*gauss_s2*gauss_s2;
+
+      j += 9;
+    }
+
+    i += 9;
+  }
+
+  // convert to unit vector
+  len = sqrt(len);
+
+  for (int n = 0; n < 64; n++)
+    desc[n] /= len;
+}
+
+/* ************************************************************************* */
+void reference::msurf_descriptor(const TEvolution& e, float* desc, float xf, float yf,
+                                 float co, float si, int scale) {
+  msurf_descriptor_t<float>(e.Lx, e.Ly, desc, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+void reference::msurf_upright_descriptor(const TEvolution& e, float* desc, float xf, float yf, int scale) {
+  msurf_upright_descriptor_t<float>(e.Lx, e.Ly, desc, xf, yf, scale);
+}
+
+/* ************************************************************************* */
+void reference::msurf_descriptor_half(const TEvolution& e, float* desc, float xf, float yf,
+                                      float co, float si, int scale) {
+  msurf_descriptor_t<unsigned short>(e.Lx16, e.Ly16, desc, xf, yf, co, si, scale);
+}
+
+/* ************************************************************************* */
+void reference::msurf_upright_descriptor_half(const TEvolution& e, float* desc, float xf, float yf, int scale) {
+  msurf_upright_descriptor_t<unsigned short>(e.Lx16, e.Ly16, desc, xf, yf, scale);
+}
+
+/* ************************************************************************* */
+void reference::hamming_distances(const unsigned char* query, const cv::Mat& train, int* dist) {
+
+  for (int i = 0; i < train.rows; i++) {
+    const unsigned char* desc = train.ptr<unsigned char>(i);
+    int d = 0;
+    for (int j = 0; j < train.cols; j++) {
+      unsigned char x = query[j] ^ desc[j];
+      for (; x != 0; x >>= 1)
+        d += (x & 1);
+    }
+    dist[i] = d;
+  }
+}
+
+/* ************************************************************************* */
+void reference::int8_dot_products(const signed char* query, const cv::Mat& train, int* dot) {
+
+  for (int i = 0; i < train.rows; i++) {
+    const signed char* desc = train.ptr<signed char>(i);
+    int d = 0;
+    for (int j = 0; j < 64; j++)
+      d += query[j]*desc[j];
+    dot[i] = d;
+  }
+}
+
+/* ************************************************************************* */
+void reference::pca_projection(const float* src, const float* projection, const float* bias,
+                               int ncomponents, float* dst) {
+
+  for (int r = 0; r < ncomponents; r++) {
+    float sum = bias[r];
+    for (int k = 0; k < 64; k++)
+      sum += projection[64*r+k]*src[k];
+    dst[r] = sum;
+  }
+}
@@ -20,13 +20,16 @@
  */
 
 #include "utils.h"
+#include "kernels.h"
 
 // OpenCV
 #include <opencv2/calib3d.hpp>
+#include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 
 // System
 #include <fstream>
+#include <map>
 
 using namespace std;
 
@@ -92,6 +95,15 @@ void draw_keypoints(cv::Mat& img, const std::vector<cv::KeyPoint>& kpts) {
   }
 }
 
+/* ************************************************************************* */
+/// Returns the factor that converts the values of an int8 descriptor back to float
+static inline float int8_descriptor_factor(const signed char* desc) {
+
+  float factor = 0.0f;
+  memcpy(&factor, desc + 64, sizeof(float));
+  return factor;
+}
+
 /* ************************************************************************* */
 int save_keypoints(const string& outFile, const std::vector<cv::KeyPoint>& kpts,
                    const cv::Mat& desc, bool save_desc) {
@@ -102,6 +114,10 @@ int save_keypoints(const string& outFile, const std::vector<cv::KeyPoint>& kpts,
   nkpts = (int)(kpts.size());
   dsize = (int)(desc.cols);
 
+  // The int8 descriptors are saved converted back to float
+  if (desc.type() == CV_8SC1)
+    dsize = 64;
+
   ofstream ipfile(outFile.c_str());
 
   if (!ipfile) {
@@ -134,6 +150,10 @@ int save_keypoints(const string& outFile, const std::vector<cv::KeyPoint>& kpts,
       if (desc.type() == 0) {
         ipfile << " " << (int)(desc.at<unsigned char>(i,j));
       }
+      else if (desc.type() == CV_8SC1) {
+        const signed char* d = desc.ptr<signed char>(i);
+        ipfile << " " << d[j]*int8_descriptor_factor(d);
+      }
       else {
         ipfile << " " << (desc.at<float>(i,j));
       }
@@ -168,6 +188,93 @@ void matches2points_nndr(const std::vector<cv::KeyPoint>& train,
   }
 }
 
+/* ************************************************************************* */
+void match_binary_descriptors(const cv::Mat& query, const cv::Mat& train,
+                              std::vector<std::vector<cv::DMatch> >& matches) {
+
+  const libAKAZE::AKAZEKernels& kernels = libAKAZE::active_kernels();
+  matches.assign(query.rows, vector<cv::DMatch>());
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < query.rows; i++) {
+    vector<int> dist(train.rows);
+    kernels.hamming_distances(query.ptr<unsigned char>(i), train, &dist[0]);
+
+    int best1 = -1, best2 = -1;
+    for (int j = 0; j < train.rows; j++) {
+      if (best1 < 0 || dist[j] < dist[best1]) {
+        best2 = best1;
+        best1 = j;
+      }
+      else if (best2 < 0 || dist[j] < dist[best2]) {
+        best2 = j;
+      }
+    }
+
+    if (best1 >= 0)
+      matches[i].push_back(cv::DMatch(i, best1, (float)dist[best1]));
+    if (best2 >= 0)
+      matches[i].push_back(cv::DMatch(i, best2, (float)dist[best2]));
+  }
+}
+
+/* ************************************************************************* */
+void match_int8_descriptors(const cv::Mat& query, const cv::Mat& train,
+                            std::vector<std::vector<cv::DMatch> >& matches) {
+
+  const libAKAZE::AKAZEKernels& kernels = libAKAZE::active_kernels();
+  matches.assign(query.rows, vector<cv::DMatch>());
+
+  // |a - b|^2 = |a|^2 + |b|^2 - 2*fa*fb*(qa . qb), with the factors fa and fb of the descriptors
+  vector<float> factors(train.rows), norms(train.rows);
+  for (int j = 0; j < train.rows; j++) {
+    const signed char* d = train.ptr<signed char>(j);
+    int n = 0;
+    for (int k = 0; k < 64; k++)
+      n += d[k]*d[k];
+    factors[j] = int8_descriptor_factor(d);
+    norms[j] = factors[j]*factors[j]*n;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < query.rows; i++) {
+    const signed char* q = query.ptr<signed char>(i);
+    vector<int> dot(train.rows);
+    kernels.int8_dot_products(q, train, &dot[0]);
+
+    int n = 0;
+    for (int k = 0; k < 64; k++)
+      n += q[k]*q[k];
+    const float fq = int8_descriptor_factor(q);
+    const float norm = fq*fq*n;
+
+    int best1 = -1, best2 = -1;
+    float dist1 = 0.0f, dist2 = 0.0f;
+    for (int j = 0; j < train.rows; j++) {
+      const float dist = max(norm + norms[j] - 2.0f*fq*factors[j]*dot[j], 0.0f);
+      if (best1 < 0 || dist < dist1) {
+        best2 = best1;
+        dist2 = dist1;
+        best1 = j;
+        dist1 = dist;
+      }
+      else if (best2 < 0 || dist < dist2) {
+        best2 = j;
+        dist2 = dist;
+      }
+    }
+
+    if (best1 >= 0)
+      matches[i].push_back(cv::DMatch(i, best1, sqrtf(dist1)));
+    if (best2 >= 0)
+      matches[i].push_back(cv::DMatch(i, best2, sqrtf(dist2)));
+  }
+}
+
 /* ************************************************************************* */
 void compute_inliers_ransac(const std::vector<cv::Point2f>& matches,
                             std::vector<cv::Point2f>& inliers,
@@ -380,6 +487,473 @@ bool read_homography(const string& hFile, cv::Mat& H1toN) {
   return true;
 }
 
+/* ************************************************************************* */
+bool read_akaze_options(const string& optFile, AKAZEOptions& options) {
+
+  cv::FileStorage fs(optFile, cv::FileStorage::READ);
+  if (!fs.isOpened())
+    return false;
+
+  read_akaze_options(fs["AKAZEOptions"], options);
+  return true;
+}
+
+/* ************************************************************************* */
+void read_akaze_options(const cv::FileNode& node, AKAZEOptions& options) {
+
+  if (!node["omin"].empty()) {
+    // read_image only decodes the images reduced by 2 and 4
+    const int omin = (int)node["omin"];
+    if (omin < 0 || omin > 2)
+      cerr << "Error: omin must be 0, 1 or 2. Ignoring omin = " << omin << endl;
+    else
+      options.omin = omin;
+  }
+  if (!node["omax"].empty()) options.omax = (int)node["omax"];
+  if (!node["nsublevels"].empty()) options.nsublevels = (int)node["nsublevels"];
+  if (!node["soffset"].empty()) options.soffset = (float)node["soffset"];
+  if (!node["derivative_factor"].empty()) options.derivative_factor = (float)node["derivative_factor"];
+  if (!node["sderivatives"].empty()) options.sderivatives = (float)node["sderivatives"];
+  if (!node["diffusivity"].empty()) options.diffusivity = DIFFUSIVITY_TYPE((int)node["diffusivity"]);
+  if (!node["dthreshold"].empty()) options.dthreshold = (float)node["dthreshold"];
+  if (!node["min_dthreshold"].empty()) options.min_dthreshold = (float)node["min_dthreshold"];
+  if (!node["descriptor"].empty()) options.descriptor = DESCRIPTOR_TYPE((int)node["descriptor"]);
+  if (!node["descriptor_size"].empty()) options.descriptor_size = (int)node["descriptor_size"];
+  if (!node["descriptor_channels"].empty()) options.descriptor_channels = (int)node["descriptor_channels"];
+  if (!node["descriptor_pattern_size"].empty()) options.descriptor_pattern_size = (int)node["descriptor_pattern_size"];
+  if (!node["kcontrast_percentile"].empty()) options.kcontrast_percentile = (float)node["kcontrast_percentile"];
+  if (!node["kcontrast_nbins"].empty()) options.kcontrast_nbins = (int)node["kcontrast_nbins"];
+  if (!node["pin_threads"].empty()) options.pin_threads = ((int)node["pin_threads"] != 0);
+  if (!node["first_touch"].empty()) options.first_touch = ((int)node["first_touch"] != 0);
+  if (!node["huge_pages"].empty()) options.huge_pages = ((int)node["huge_pages"] != 0);
+  if (!node["storage"].empty()) options.storage = EVOLUTION_STORAGE((int)node["storage"]);
+  if (!node["engine"].empty()) options.engine = EVOLUTION_ENGINE((int)node["engine"]);
+  if (!node["pipeline"].empty()) options.pipeline = ((int)node["pipeline"] != 0);
+  if (!node["wavefront"].empty()) options.wavefront = ((int)node["wavefront"] != 0);
+  if (!node["sparse_derivatives"].empty()) options.sparse_derivatives = ((int)node["sparse_derivatives"] != 0);
+  if (!node["sparse_detector"].empty()) options.sparse_detector = ((int)node["sparse_detector"] != 0);
+  if (!node["descriptor_plane"].empty()) options.descriptor_plane = ((int)node["descriptor_plane"] != 0);
+  if (!node["mldb_angle_bins"].empty()) options.mldb_angle_bins = (int)node["mldb_angle_bins"];
+  if (!node["extra_descriptors"].empty()) options.extra_descriptors = (int)node["extra_descriptors"];
+  if (!node["descriptor_bits"].empty()) options.descriptor_bits = (string)node["descriptor_bits"];
+  if (!node["descriptor_padding"].empty()) options.descriptor_padding = ((int)node["descriptor_padding"] != 0);
+  if (!node["descriptor_int8"].empty()) options.descriptor_int8 = ((int)node["descriptor_int8"] != 0);
+  if (!node["pca_basis"].empty()) options.pca_basis = (string)node["pca_basis"];
+  if (!node["orientation_ratio"].empty()) options.orientation_ratio = (float)node["orientation_ratio"];
+}
+
+/* ************************************************************************* */
+bool write_akaze_options(const string& optFile, const AKAZEOptions& options) {
+
+  cv::FileStorage fs(optFile, cv::FileStorage::WRITE);
+  if (!fs.isOpened())
+    return false;
+
+  write_akaze_options(fs, options);
+  return true;
+}
+
+/* ************************************************************************* */
+void write_akaze_options(cv::FileStorage& fs, const AKAZEOptions& options) {
+
+  fs << "AKAZEOptions" << "{";
+  fs << "omin" << options.omin;
+  fs << "omax" << options.omax;
+  fs << "nsublevels" << options.nsublevels;
+  fs << "soffset" << options.soffset;
+  fs << "derivative_factor" << options.derivative_factor;
+  fs << "sderivatives" << options.sderivatives;
+  fs << "diffusivity" << (int)options.diffusivity;
+  fs << "dthreshold" << options.dthreshold;
+  fs << "min_dthreshold" << options.min_dthreshold;
+  fs << "descriptor" << (int)options.descriptor;
+  fs << "descriptor_size" << options.descriptor_size;
+  fs << "descriptor_channels" << options.descriptor_channels;
+  fs << "descriptor_pattern_size" << options.descriptor_pattern_size;
+  fs << "kcontrast_percentile" << options.kcontrast_percentile;
+  fs << "kcontrast_nbins" << (int)options.kcontrast_nbins;
+  fs << "pin_threads" << (int)options.pin_threads;
+  fs << "first_touch" << (int)options.first_touch;
+  fs << "huge_pages" << (int)options.huge_pages;
+  fs << "storage" << (int)options.storage;
+  fs << "engine" << (int)options.engine;
+  fs << "pipeline" << (int)options.pipeline;
+  fs << "wavefront" << (int)options.wavefront;
+  fs << "sparse_derivatives" << (int)options.sparse_derivatives;
+  fs << "sparse_detector" << (int)options.sparse_detector;
+  fs << "descriptor_plane" << (int)options.descriptor_plane;
+  fs << "mldb_angle_bins" << options.mldb_angle_bins;
+  fs << "extra_descriptors" << options.extra_descriptors;
+  fs << "descriptor_bits" << options.descriptor_bits;
+  fs << "descriptor_padding" << (int)options.descriptor_padding;
+  fs << "descriptor_int8" << (int)options.descriptor_int8;
+  fs << "pca_basis" << options.pca_basis;
+  fs << "orientation_ratio" << options.orientation_ratio;
+  fs << "}";
+}
+
+/* ************************************************************************* */
+bool read_descriptor_bits(const string& bitsFile, vector<int>& bits,
+                          int& nchannels, int& pattern_size) {
+
+  cv::FileStorage fs(bitsFile, cv::FileStorage::READ);
+  if (!fs.isOpened())
+    return false;
+
+  cv::FileNode node = fs["DescriptorBits"];
+  if (node.empty() || node["bits"].empty())
+    return false;
+
+  nchannels = (int)node["descriptor_channels"];
+  pattern_size = (int)node["descriptor_pattern_size"];
+  node["bits"] >> bits;
+  return true;
+}
+
+/* ************************************************************************* */
+bool write_descriptor_bits(const string& bitsFile, const vector<int>& bits,
+                           int nchannels, int pattern_size) {
+
+  cv::FileStorage fs(bitsFile, cv::FileStorage::WRITE);
+  if (!fs.isOpened())
+    return false;
+
+  fs << "DescriptorBits" << "{";
+  fs << "descriptor_channels" << nchannels;
+  fs << "descriptor_pattern_size" << pattern_size;
+  fs << "bits" << bits;
+  fs << "}";
+  return true;
+}
+
+/* ************************************************************************* */
+void compute_pca_basis(const cv::Mat& desc, int ncomponents, bool whiten,
+                       cv::Mat& projection, cv::Mat& bias) {
+
+  cv::PCA pca(desc, cv::noArray(), cv::PCA::DATA_AS_ROW, ncomponents);
+
+  cv::Mat mean, eigenvalues;
+  pca.eigenvectors.convertTo(projection, CV_32F);
+  pca.mean.convertTo(mean, CV_32F);
+  pca.eigenvalues.convertTo(eigenvalues, CV_32F);
+
+  bias = cv::Mat::zeros(1, projection.rows, CV_32F);
+  for (int r = 0; r < projection.rows; r++) {
+    float* p = projection.ptr<float>(r);
+
+    if (whiten == true) {
+      const float s = 1.0f/sqrtf(max(eigenvalues.at<float>(r), 1e-12f));
+      for (int k = 0; k < projection.cols; k++)
+        p[k] *= s;
+    }
+
+    float b = 0.0f;
+    for (int k = 0; k < projection.cols; k++)
+      b -= p[k]*mean.at<float>(k);
+    bias.at<float>(r) = b;
+  }
+}
+
+/* ************************************************************************* */
+bool read_pca_basis(const string& pcaFile, cv::Mat& projection, cv::Mat& bias) {
+
+  cv::FileStorage fs(pcaFile, cv::FileStorage::READ);
+  if (!fs.isOpened())
+    return false;
+
+  cv::FileNode node = fs["PCABasis"];
+  if (node.empty() || node["projection"].empty() || node["bias"].empty())
+    return false;
+
+  cv::Mat p, b;
+  node["projection"] >> p;
+  node["bias"] >> b;
+  p.convertTo(projection, CV_32F);
+  b.reshape(1, 1).convertTo(bias, CV_32F);
+  return true;
+}
+
+/* ************************************************************************* */
+bool write_pca_basis(const string& pcaFile, const cv::Mat& projection, const cv::Mat& bias) {
+
+  cv::FileStorage fs(pcaFile, cv::FileStorage::WRITE);
+  if (!fs.isOpened())
+    return false;
+
+  fs << "PCABasis" << "{";
+  fs << "projection" << projection;
+  fs << "bias" << bias;
+  fs << "}";
+  return true;
+}
+
+/* ************************************************************************* */
+/// Reads the size of a PNM, PNG, BMP or JPEG image from its header
+static bool read_image_header_size(const std::string& img_path, cv::Size& size) {
+
+  ifstream pf(img_path.c_str(), ios::binary);
+  unsigned char h[26];
+  if (!pf.read((char*)h, sizeof(h)))
+    return false;
+
+  // PNM: magic number, then the width and the height as text, with optional comments
+  if (h[0] == 'P' && h[1] >= '1' && h[1] <= '6') {
+    pf.seekg(2);
+    int dims[2] = {0, 0};
+    for (int k = 0; k < 2; k++) {
+      pf >> ws;
+      while (pf.peek() == '#') {
+        string comment;
+        getline(pf, comment);
+        pf >> ws;
+      }
+      if (!(pf >> dims[k]))
+        return false;
+    }
+    size = cv::Size(dims[0], dims[1]);
+    return true;
+  }
+
+  // PNG: big endian width and height of the IHDR chunk
+  if (h[0] == 0x89 && h[1] == 'P' && h[2] == 'N' && h[3] == 'G') {
+    size.width = (h[16] << 24) | (h[17] << 16) | (h[18] << 8) | h[19];
+    size.height = (h[20] << 24) | (h[21] << 16) | (h[22] << 8) | h[23];
+    return true;
+  }
+
+  // BMP: little endian width and height, negative for top-down images
+  if (h[0] == 'B' && h[1] == 'M') {
+    int width = h[18] | (h[19] << 8) | (h[20] << 16) | (h[21] << 24);
+    int height = h[22] | (h[23] << 8) | (h[24] << 16) | (h[25] << 24);
+    size = cv::Size(abs(width), abs(height));
+    return true;
+  }
+
+  // JPEG: the start of frame segment, skipping the other segments
+  if (h[0] == 0xff && h[1] == 0xd8) {
+    pf.seekg(2);
+    unsigned char m[9];
+    while (pf.read((char*)m, 4) && m[0] == 0xff) {
+      const int length = (m[2] << 8) | m[3];
+      const bool sof = (m[1] >= 0xc0 && m[1] <= 0xcf && m[1] != 0xc4 && m[1] != 0xc8 && m[1] != 0xcc);
+      if (sof) {
+        if (!pf.read((char*)m, 5))
+          return false;
+        size = cv::Size((m[3] << 8) | m[4], (m[1] << 8) | m[2]);
+        return true;
+      }
+      pf.seekg(length-2, ios::cur);
+    }
+  }
+
+  return false;
+}
+
+/* ************************************************************************* */
+cv::Mat read_image(const std::string& img_path, int omin, cv::Size* original_size) {
+
+  if (omin < 0 || omin > 2) {
+    cerr << "Error: the images can only be decoded reduced by 2^omin with omin 0, 1 or 2" << endl;
+    return cv::Mat();
+  }
+
+  // The decoder reduces the image (e.g. JPEG DCT scaling), so octave 0 is never built
+  int flags = cv::IMREAD_GRAYSCALE;
+  if (omin == 1)
+    flags = cv::IMREAD_REDUCED_GRAYSCALE_2;
+  else if (omin == 2)
+    flags = cv::IMREAD_REDUCED_GRAYSCALE_4;
+
+  cv::Mat img = cv::imread(img_path, flags);
+
+  // The reduced size is rounded down or up depending on the decoder, so the original
+  // size is read from the header, or from the whole image for other formats
+  if (original_size != NULL && img.data != NULL) {
+    if (omin == 0)
+      *original_size = img.size();
+    else if (read_image_header_size(img_path, *original_size) == false)
+      *original_size = cv::imread(img_path, cv::IMREAD_GRAYSCALE).size();
+  }
+
+  return img;
+}
+
+/* ************************************************************************* */
+int read_image_sequence(const std::string& folder, std::vector<std::string>& images,
+                        std::vector<std::string>& homographies) {
+
+  const char* extensions[] = {".pgm", ".ppm", ".png", ".jpg", ".bmp"};
+  const int nextensions = sizeof(extensions)/sizeof(extensions[0]);
+
+  images.clear();
+  homographies.clear();
+
+  for (int n = 1; ; n++) {
+
+    string img_path;
+    for (int e = 0; e < nextensions && img_path.empty(); e++) {
+      string path = folder + "/img" + to_string(n) + extensions[e];
+      ifstream pf(path.c_str());
+      if (pf.good())
+        img_path = path;
+    }
+
+    if (img_path.empty())
+      break;
+
+    // Every image but the reference one needs its ground truth homography
+    if (n > 1) {
+      string h_path = folder + "/H1to" + to_string(n) + "p";
+      ifstream pf(h_path.c_str());
+      if (!pf.good())
+        break;
+      homographies.push_back(h_path);
+    }
+
+    images.push_back(img_path);
+  }
+
+  return (int)images.size();
+}
+
+/* ************************************************************************* */
+/// Projects a point with the homography H
+static inline cv::Point2f project_point(const cv::Matx33f& H, const cv::Point2f& pt) {
+
+  float s = H(2,0)*pt.x + H(2,1)*pt.y + H(2,2);
+  return cv::Point2f((H(0,0)*pt.x + H(0,1)*pt.y + H(0,2))/s,
+                     (H(1,0)*pt.x + H(1,1)*pt.y + H(1,2))/s);
+}
+
+/* ************************************************************************* */
+/// Computes the linear scale factor of the homography H in the neighbourhood of pt
+static inline float projection_scale(const cv::Matx33f& H, const cv::Point2f& pt) {
+
+  float s = H(2,0)*pt.x + H(2,1)*pt.y + H(2,2);
+  cv::Point2f p = project_point(H, pt);
+  float dudx = (H(0,0) - p.x*H(2,0))/s;
+  float dudy = (H(0,1) - p.x*H(2,1))/s;
+  float dvdx = (H(1,0) - p.y*H(2,0))/s;
+  float dvdy = (H(1,1) - p.y*H(2,1))/s;
+  return sqrt(fabs(dudx*dvdy - dudy*dvdx));
+}
+
+/* ************************************************************************* */
+/// Computes the ratio between the intersection and the union areas of two circles
+static float circle_overlap(float r1, float r2, float d) {
+
+  if (d >= r1 + r2)
+    return 0.0;
+
+  float rmin = std::min(r1, r2), rmax = std::max(r1, r2);
+  if (d <= rmax - rmin)
+    return (rmin*rmin)/(rmax*rmax);
+
+  float a1 = r1*r1*acos((d*d + r1*r1 - r2*r2)/(2.0*d*r1));
+  float a2 = r2*r2*acos((d*d + r2*r2 - r1*r1)/(2.0*d*r2));
+  float a3 = 0.5*sqrt((-d+r1+r2)*(d+r1-r2)*(d-r1+r2)*(d+r1+r2));
+  float inter = a1 + a2 - a3;
+
+  return inter / (CV_PI*(r1*r1 + r2*r2) - inter);
+}
+
+/* ************************************************************************* */
+void compute_correspondences(const std::vector<cv::KeyPoint>& kpts1,
+                             const std::vector<cv::KeyPoint>& kpts2,
+                             const cv::Mat& H, const cv::Size& size1, const cv::Size& size2,
+                             float overlap_error, float pixel_error,
+                             std::vector<cv::DMatch>& corresp, int& nvisible) {
+
+  cv::Mat Hinv = H.inv();
+  cv::Matx33f H12 = H, H21 = Hinv;
+  vector<cv::Point2f> proj1(kpts1.size()), proj2(kpts2.size());
+  vector<float> radius2(kpts2.size());
+  vector<bool> visible1(kpts1.size()), visible2(kpts2.size());
+  int nvisible1 = 0, nvisible2 = 0;
+
+  corresp.clear();
+
+  // Keep only the keypoints that lie in the image area common to both images
+  for (size_t i = 0; i < kpts1.size(); i++) {
+    proj1[i] = project_point(H12, kpts1[i].pt);
+    visible1[i] = (proj1[i].x >= 0 && proj1[i].y >= 0 &&
+                   proj1[i].x < size2.width && proj1[i].y < size2.height);
+    nvisible1 += visible1[i];
+  }
+
+  // The regions of the second image are projected into the first one
+  for (size_t j = 0; j < kpts2.size(); j++) {
+    proj2[j] = project_point(H21, kpts2[j].pt);
+    radius2[j] = 0.5*kpts2[j].size*projection_scale(H21, kpts2[j].pt);
+    visible2[j] = (proj2[j].x >= 0 && proj2[j].y >= 0 &&
+                   proj2[j].x < size1.width && proj2[j].y < size1.height);
+    nvisible2 += visible2[j];
+  }
+
+  nvisible = std::min(nvisible1, nvisible2);
+
+  // Candidate correspondences weighted by their overlap
+  vector<pair<float, pair<int,int> > > candidates;
+  for (size_t i = 0; i < kpts1.size(); i++) {
+
+    if (visible1[i] == false)
+      continue;
+
+    float r1 = 0.5*kpts1[i].size;
+
+    for (size_t j = 0; j < kpts2.size(); j++) {
+
+      if (visible2[j] == false)
+        continue;
+
+      // Check the location error in the second image
+      float ex = proj1[i].x - kpts2[j].pt.x;
+      float ey = proj1[i].y - kpts2[j].pt.y;
+      if (ex*ex + ey*ey > pixel_error*pixel_error)
+        continue;
+
+      float dx = kpts1[i].pt.x - proj2[j].x;
+      float dy = kpts1[i].pt.y - proj2[j].y;
+      float overlap = circle_overlap(r1, radius2[j], sqrt(dx*dx + dy*dy));
+
+      if (overlap > 1.0 - overlap_error)
+        candidates.push_back(make_pair(overlap, make_pair((int)i, (int)j)));
+    }
+  }
+
+  // Greedy bipartite matching by decreasing overlap
+  std::sort(candidates.begin(), candidates.end());
+  vector<bool> used1(kpts1.size(), false), used2(kpts2.size(), false);
+
+  for (int k = (int)candidates.size()-1; k >= 0; k--) {
+    int i = candidates[k].second.first;
+    int j = candidates[k].second.second;
+    if (used1[i] == false && used2[j] == false) {
+      used1[i] = used2[j] = true;
+      corresp.push_back(cv::DMatch(i, j, 1.0 - candidates[k].first));
+    }
+  }
+}
+
+/* ************************************************************************* */
+int compute_correct_matches(const std::vector<cv::DMatch>& corresp,
+                            const std::vector<cv::DMatch>& dmatches) {
+
+  int ncorrect = 0;
+  std::map<int, int> geometric;
+
+  for (size_t i = 0; i < corresp.size(); i++)
+    geometric[corresp[i].queryIdx] = corresp[i].trainIdx;
+
+  for (size_t i = 0; i < dmatches.size(); i++) {
+    std::map<int, int>::const_iterator it = geometric.find(dmatches[i].queryIdx);
+    if (it != geometric.end() && it->second == dmatches[i].trainIdx)
+      ncorrect++;
+  }
+
+  return ncorrect;
+}
+
 /* ************************************************************************* */
 const size_t length = string("--descriptor_channels").size() + 2;
 static inline std::ostream& cout_help() {
@@ -409,9 +983,57 @@ void show_input_options_help(int example) {
   else if (example == 2) {
     cout << "./akaze_compare img1.jpg img2.pgm [homography.txt] [options]" << endl;
   }
+  else if (example == 3) {
+    cout << "./akaze_benchmark dataset_folder [options]" << endl;
+  }
+  else if (example == 4) {
+    cout << "./akaze_tune dataset_folder [options]" << endl;
+    cout << endl;
+    cout << left;
+    cout_help() << "dataset_folder contains the images img1, img2, ... and the ground truth homographies H1to2p, H1to3p, ..." << endl;
+    cout_help() << "omax, nsublevels, dthreshold, descriptor_size and descriptor_channels are searched with successive halving" << endl;
+    cout << endl;
+    cout_help() << "--help" << "Show the command line options" << endl;
+    cout_help() << "--verbose " << "Verbosity is required" << endl;
+    cout_help() << "--budget_ms" << "Maximum computation time per frame in ms (0 means no limit)" << endl;
+    cout_help() << "--budget_mb" << "Maximum memory of the nonlinear scale space in MB (0 means no limit)" << endl;
+    cout_help() << "--eta" << "Reduction factor of the successive halving (3 by default)" << endl;
+    cout_help() << "--nruns" << "Number of times each image is processed for timing" << endl;
+    cout_help() << "--output" << "Output options file (./akaze_options.yml by default)" << endl;
+    cout_help() << "--diffusivity" << "Diffusivity function (fixed during the search)" << endl;
+    cout_help() << "--descriptor" << "Descriptor Type (fixed during the search)" << endl;
+    cout_help() << endl;
+    return;
+  }
+  else if (example == 5) {
+    cout << "./akaze_train img1.jpg img2.jpg ... [options]" << endl;
+    cout << endl;
+    cout << left;
+    cout_help() << "The bits of the full length M-LDB descriptors of the images are selected by decreasing variance and low correlation" << endl;
+    cout_help() << "or the PCA basis of the SURF and M-SURF descriptors is computed" << endl;
+    cout << endl;
+    cout_help() << "--help" << "Show the command line options" << endl;
+    cout_help() << "--verbose " << "Verbosity is required" << endl;
+    cout_help() << "--options" << "Load the options from a YAML/XML file" << endl;
+    cout_help() << "--nbits" << "Number of bits of the table (256 by default)" << endl;
+    cout_help() << "--pca" << "Number of components of the PCA basis of the SURF and M-SURF descriptors (32 by default)" << endl;
+    cout_help() << "--whiten" << "Whiten the components of the PCA basis" << endl;
+    cout_help() << "--output" << "Output file (./akaze_bits.yml or ./akaze_pca.yml by default)" << endl;
+    cout_help() << "--dthreshold" << "Detector response threshold to accept point" << endl;
+    cout_help() << "--descriptor" << "Descriptor Type, 0..3 -> PCA basis of the SURF and M-SURF types, 4 -> MLDB_UPRIGHT or 5 -> MLDB (default)" << endl;
+    cout_help() << "--descriptor_channels" << "Descriptor Channels of the table" << endl;
+    cout_help() << "--descriptor_pattern_size" << "Descriptor Pattern Size of the table" << endl;
+    cout_help() << endl;
+    return;
+  }
   
   cout << endl;
-  cout_help() << "homography.txt is optional. If the txt file is not provided a planar homography will be estimated using RANSAC" << endl;
+  if (example == 3) {
+    cout_help() << "dataset_folder contains the images img1, img2, ... and the ground truth homographies H1to2p, H1to3p, ..." << endl;
+  }
+  else {
+    cout_help() << "homography.txt is optional. If the txt file is not provided a planar homography will be estimated using RANSAC" << endl;
+  }
 
   cout << endl;
   cout_help() << "Options below are not mandatory. Unless specified, default arguments are used." << endl << endl;  
@@ -422,10 +1044,15 @@ void show_input_options_help(int example) {
   // Generalities
   cout_help() << "--help" << "Show the command line options" << endl;
   cout_help() << "--verbose " << "Verbosity is required" << endl;
+  cout_help() << "--options" << "Load the options from a YAML/XML file (e.g. generated by akaze_tune)" << endl;
+  cout_help() << " " << "Options given after this one override the values of the file" << endl;
   cout_help() << endl;
 
   // Scale-space parameters
   cout_help() << "--soffset" << "Base scale offset (sigma units)" << endl;
+  cout_help() << "--omin" << "Initial octave of image evolution. Possible values:" << endl;
+  cout_help() << " " << "0 -> full resolution" << endl;
+  cout_help() << " " << "1, 2 -> decode the images at 1/2, 1/4 and skip the finest octaves" << endl;
   cout_help() << "--omax" << "Maximum octave of image evolution" << endl;
   cout_help() << "--nsublevels" << "Number of sublevels per octave" << endl;
   cout_help() << "--diffusivity" << "Diffusivity function. Possible values:" << endl;
@@ -461,6 +1088,44 @@ void show_input_options_help(int example) {
   cout_help() << " " << "0: means the full length descriptor (486)!!" << endl;
   cout_help() << endl;
 
+  // Threading parameters
+  cout_help() << "--pin_threads" << "1 -> pin the OpenMP threads to the CPUs (Linux only)" << endl;
+  cout_help() << "--first_touch" << "1 -> allocate the scale space in the NUMA nodes of the threads that process it" << endl;
+  cout_help() << "--huge_pages" << "1 -> allocate the scale space on transparent huge pages (Linux only)" << endl;
+  cout_help() << "--pipeline" << "1 -> compute the detector response of every level while the next ones are diffused" << endl;
+  cout_help() << "--wavefront" << "1 -> diffuse the levels of every octave by bands of rows, overlapping consecutive levels" << endl;
+  cout_help() << "--sparse_derivatives" << "1 -> compute the data only read by the descriptors on the tiles around the keypoints" << endl;
+  cout_help() << "--sparse_detector" << "1 -> compute the detector response only on the tiles that can be over the threshold" << endl;
+  cout_help() << "--descriptor_plane" << "1 -> sample the descriptors from an interleaved plane of the evolution and the derivatives" << endl;
+  cout_help() << "--mldb_angle_bins" << "number of angle bins of the precomputed rotated M-LDB sampling offsets, 0 -> exact angle" << endl;
+  cout_help() << "--extra_descriptors" << "bit mask (1 << type) of the descriptors computed together with --descriptor in one pass, 0 -> none" << endl;
+  cout_help() << "--descriptor_bits" << "bit selection table trained by akaze_train for --descriptor_size > 0, random selection if empty" << endl;
+  cout_help() << "--descriptor_padding" << "1 -> binary descriptor rows padded with zeros to a multiple of 64 bytes, 64 byte aligned" << endl;
+  cout_help() << "--descriptor_int8" << "1 -> SURF and M-SURF descriptors quantized to int8 with a scale per descriptor" << endl;
+  cout_help() << "--pca_basis" << "PCA basis trained by akaze_train for the SURF and M-SURF descriptors, 64 values if empty" << endl;
+  cout_help() << "--orientation_ratio" << "keypoints duplicated with the secondary orientations above this ratio of the main one, 0 -> main orientation only" << endl;
+  cout_help() << endl;
+
+  // Storage of the scale space
+  cout_help() << "--storage" << "Storage of the scale space for the detector and the descriptors. Possible values:" << endl;
+  cout_help() << " " << "0 -> float" << endl;
+  cout_help() << " " << "1 -> half precision" << endl;
+  cout_help() << endl;
+
+  cout_help() << "--engine" << "Arithmetic of the scale space, the derivatives and the detector. Possible values:" << endl;
+  cout_help() << " " << "0 -> float" << endl;
+  cout_help() << " " << "1 -> fixed point (int16 images, int32 accumulators)" << endl;
+  cout_help() << endl;
+
+  if (example == 3) {
+    // Benchmark parameters
+    cout_help() << "--nruns" << "Number of times each image is processed for timing" << endl;
+    cout_help() << "--min_repeatability" << "Minimum mean repeatability (%) to pass the benchmark" << endl;
+    cout_help() << "--min_matching_score" << "Minimum mean matching score (%) to pass the benchmark" << endl;
+    cout_help() << endl;
+    return;
+  }
+
   // Save results?
   cout_help() << "--show_results" << "Possible values below:" << endl;
   cout_help() << " " << "1 -> show detection results." << endl;
@@ -8,6 +8,8 @@
 #pragma once
 
 /* ************************************************************************* */
+#include "AKAZEConfig.h"
+
 // OpenCV
 #include <opencv2/features2d/features2d.hpp>
 
@@ -74,6 +76,24 @@ void matches2points_nndr(const std::vector<cv::KeyPoint>& train,
                          const std::vector<std::vector<cv::DMatch> >& matches,
                          std::vector<cv::Point2f>& pmatches, float nndr);
 
+/// This function finds the two nearest neighbors in Hamming distance of every binary
+/// descriptor of query among the descriptors of train, with the active kernels. It is
+/// faster with the rows padded to 64 bytes of the descriptor_padding option
+/// @param query Matrix of binary descriptors, one per row
+/// @param train Matrix of binary descriptors with the same number of columns
+/// @param matches Vector of nearest neighbors for each descriptor of query, as knnMatch
+void match_binary_descriptors(const cv::Mat& query, const cv::Mat& train,
+                              std::vector<std::vector<cv::DMatch> >& matches);
+
+/// This function finds the two nearest neighbors in Euclidean distance of every int8
+/// SURF or M-SURF descriptor of query (descriptor_int8 option) among the descriptors of
+/// train, with the integer dot products of the active kernels
+/// @param query Matrix of int8 descriptors, one per row
+/// @param train Matrix of int8 descriptors
+/// @param matches Vector of nearest neighbors for each descriptor of query, as knnMatch
+void match_int8_descriptors(const cv::Mat& query, const cv::Mat& train,
+                            std::vector<std::vector<cv::DMatch> >& matches);
+
 /// This function computes the set of inliers estimating the fundamental matrix
 /// or a planar homography in a RANSAC procedure
 /// @param matches Vector of putative matches
@@ -112,6 +132,108 @@ void draw_inliers(const cv::Mat& img1, const cv::Mat& img2, cv::Mat& img_com,
 /// Function for reading the ground truth homography from a txt file
 bool read_homography(const std::string& hFile, cv::Mat& H1toN);
 
+/// Function for reading the AKAZE options from a YAML/XML file
+/// @param optFile Name of the options file
+/// @param options AKAZE options. Only the options present in the file are modified
+/// @return true if the file could be opened, false otherwise
+bool read_akaze_options(const std::string& optFile, AKAZEOptions& options);
+
+/// Function for reading the AKAZE options from a file storage node
+/// @param node File storage node with the options
+/// @param options AKAZE options. Only the options present in the node are modified
+void read_akaze_options(const cv::FileNode& node, AKAZEOptions& options);
+
+/// Function for writing the AKAZE options into a YAML/XML file
+/// @param optFile Name of the options file
+/// @param options AKAZE options
+/// @return true if the file could be opened, false otherwise
+bool write_akaze_options(const std::string& optFile, const AKAZEOptions& options);
+
+/// Function for writing the AKAZE options as an "AKAZEOptions" map into an open file storage
+/// @param fs Opened file storage
+/// @param options AKAZE options
+void write_akaze_options(cv::FileStorage& fs, const AKAZEOptions& options);
+
+/// Function for reading a bit selection table of the M-LDB descriptor from a YAML/XML file
+/// @param bitsFile Name of the table file written by write_descriptor_bits
+/// @param bits Indices of the selected bits in the full length descriptor, in order of selection
+/// @param nchannels Number of channels of the descriptor used for the training
+/// @param pattern_size Pattern size of the descriptor used for the training
+/// @return true if the file could be opened and has a table, false otherwise
+bool read_descriptor_bits(const std::string& bitsFile, std::vector<int>& bits,
+                          int& nchannels, int& pattern_size);
+
+/// Function for writing a bit selection table of the M-LDB descriptor into a YAML/XML file
+/// @return true if the file could be opened, false otherwise
+bool write_descriptor_bits(const std::string& bitsFile, const std::vector<int>& bits,
+                           int nchannels, int pattern_size);
+
+/// This function computes the PCA basis of a set of float descriptors
+/// @param desc Matrix of descriptors, one per row (CV_32F)
+/// @param ncomponents Number of components of the basis
+/// @param whiten Set to true for scaling the components to unit variance
+/// @param projection Matrix with one component per row
+/// @param bias Projection of the mean with negative sign, a descriptor x is projected as projection*x + bias
+void compute_pca_basis(const cv::Mat& desc, int ncomponents, bool whiten,
+                       cv::Mat& projection, cv::Mat& bias);
+
+/// This function reads a PCA basis written by write_pca_basis
+/// @param pcaFile Name of the file
+/// @param projection Matrix with one component per row (CV_32F)
+/// @param bias Row vector of the bias of the components (CV_32F)
+/// @return true if the basis was read
+bool read_pca_basis(const std::string& pcaFile, cv::Mat& projection, cv::Mat& bias);
+
+/// This function writes a PCA basis of compute_pca_basis
+/// @param pcaFile Name of the file
+/// @param projection Matrix with one component per row
+/// @param bias Row vector of the bias of the components
+/// @return true if the basis was written
+bool write_pca_basis(const std::string& pcaFile, const cv::Mat& projection, const cv::Mat& bias);
+
+/// Function for reading an image in grayscale at the resolution of the initial octave
+/// @param img_path Path of the image
+/// @param omin Initial octave level (0, 1 or 2). The image is decoded at 1/2^omin of its size
+/// @param original_size Size of the image at full resolution, if not NULL
+/// @return The 8 bit image, empty if it could not be read or omin is not valid
+cv::Mat read_image(const std::string& img_path, int omin, cv::Size* original_size = NULL);
+
+/// This function lists the images and ground truth homographies of an image sequence
+/// @param folder Folder with the images img1, img2, ... and the homographies H1to2p, H1to3p, ...
+/// @param images Vector of image paths. The first one is the reference image
+/// @param homographies Vector of homography paths. homographies[i] relates images[0] with images[i+1]
+/// @return The number of images found in the sequence
+/// @note The format is the one used in the Mikolajczyk and Schmid evaluation datasets
+int read_image_sequence(const std::string& folder, std::vector<std::string>& images,
+                        std::vector<std::string>& homographies);
+
+/// This function computes the geometric correspondences between two sets of keypoints
+/// given the ground truth homography, as done in the detector repeatability benchmark
+/// @param kpts1 Vector of keypoints from the first image
+/// @param kpts2 Vector of keypoints from the second image
+/// @param H Ground truth homography matrix 3x3 that maps the first image into the second one
+/// @param size1 Size of the first image
+/// @param size2 Size of the second image
+/// @param overlap_error Maximum overlap error between two regions to accept a correspondence
+/// @param pixel_error Maximum location error in pixels to accept a correspondence
+/// @param corresp Vector of one-to-one correspondences (queryIdx -> kpts1, trainIdx -> kpts2)
+/// @param nvisible Minimum number of keypoints of both images in the common image area
+/// @note Keypoints are circular regions of diameter kpt.size. The regions of the second
+/// image are projected into the first one, where the overlap error is 1 - intersection/union.
+/// Correspondences are selected with a greedy bipartite matching by decreasing overlap
+void compute_correspondences(const std::vector<cv::KeyPoint>& kpts1,
+                             const std::vector<cv::KeyPoint>& kpts2,
+                             const cv::Mat& H, const cv::Size& size1, const cv::Size& size2,
+                             float overlap_error, float pixel_error,
+                             std::vector<cv::DMatch>& corresp, int& nvisible);
+
+/// This function computes the number of descriptor matches that are also geometric correspondences
+/// @param corresp Vector of geometric correspondences from compute_correspondences
+/// @param dmatches Vector of one-to-one descriptor matches
+/// @return The number of correct descriptor matches
+int compute_correct_matches(const std::vector<cv::DMatch>& corresp,
+                            const std::vector<cv::DMatch>& dmatches);
+
 /// This function shows the possible command line configuration options
 void show_input_options_help(int example);
 